@@ -17,7 +17,12 @@
 #include <Library/ShellLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BaseLib.h>
 #include <Library/BaseLib/BaseLibInternals.h>
+#include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
+#include <Library/PerformanceLib.h>
 #include "CmdLine.h"
 #include "CmdLineInternal.h"
 
@@ -31,16 +36,99 @@
 
 
 // locals functions
-STATIC BOOLEAN ReturnValue(IN CONST CHAR16 *String, IN VALUE_TYPE ValueType, IN DATA *Data, OUT VALUE_RET_PTR ValueRetPtr);
-STATIC BOOLEAN GetEnumVal(IN ENUM_STR_ARRAY *EnumStrArray, IN CONST CHAR16 *Str, OUT UINTN *Value);
+STATIC VALUE_STATUS ReturnValue(IN CONST CHAR16 *String, IN VALUE_TYPE ValueType, IN DATA *Data, IN ENUM_INDEX *EnumIndex, OUT VALUE_RET_PTR ValueRetPtr);
+STATIC VOID ResetValueCount(IN VALUE_TYPE ValueType, OUT VALUE_RET_PTR ValueRetPtr);
+STATIC BOOLEAN GetEnumVal(IN ENUM_STR_ARRAY *EnumStrArray, IN ENUM_INDEX *EnumIndex, IN CONST CHAR16 *Str, OUT UINTN *Value);
+STATIC UINTN CountEnum(IN ENUM_STR_ARRAY *EnumStrArray);
+STATIC ENUM_STR_ARRAY *RecordEnumArray(IN CMDLINE_PARSER *Parser, IN UINTN Record);
+STATIC UINTN EnumIndexSize(IN CMDLINE_PARSER *Parser);
+STATIC VOID BuildEnumIndex(IN CMDLINE_PARSER *Parser, OUT ENUM_INDEX *EnumIndex);
+STATIC VOID SiftEnumKey(IN OUT ENUM_KEY *Keys, IN UINTN Root, IN UINTN Count);
+STATIC INTN CompareEnumKeys(IN CONST ENUM_KEY *Key1, IN CONST ENUM_KEY *Key2);
+STATIC UINTN FindEnumKey(IN ENUM_INDEX *EnumIndex, IN CONST CHAR16 *Str, IN UINTN Flags);
+STATIC INTN FoldedCmp(IN CONST CHAR16 *Folded, IN CONST CHAR16 *String);
+STATIC BOOLEAN FoldedPrefix(IN CONST CHAR16 *Prefix, IN CONST CHAR16 *Folded);
 STATIC INTN EFIAPI StriCmp(IN CONST CHAR16 *FirstString, IN CONST CHAR16 *SecondString);
-STATIC BOOLEAN HasHexPrefix(IN CONST CHAR16 *String);
-STATIC BOOLEAN IsHexString(IN CONST CHAR16 *String);
-STATIC BOOLEAN IsDecimalString(IN CONST CHAR16 *String);
-STATIC VOID TableError(IN UINTN i, IN CHAR16 *errStr);
+STATIC BOOLEAN StriPrefix(IN CONST CHAR16 *Prefix, IN CONST CHAR16 *String);
+STATIC UINTN FindSortedEnum(IN ENUM_STR_ARRAY *EnumStrArray, IN UINTN Count, IN CONST CHAR16 *Str, IN UINTN Flags);
+STATIC UINTN FindUnsortedEnum(IN ENUM_STR_ARRAY *EnumStrArray, IN UINTN Count, IN CONST CHAR16 *Str, IN UINTN Flags);
+STATIC VALUE_STATUS StrToNumber(IN CONST CHAR16 *String, IN UINTN Length, IN UINTN Radix, IN UINT64 Limit, OUT UINT64 *Value, OUT BOOLEAN *Negative OPTIONAL, OUT CONST CHAR16 **End OPTIONAL);
+STATIC VALUE_STATUS AppendValueList(IN CONST CHAR16 *String, IN UINTN Radix, IN OUT VALUE_LIST *List);
+STATIC UINTN DigitValue(IN CHAR16 Char);
+STATIC VALUE_STATUS DecodeHexBlob(IN CONST CHAR16 *String, IN OUT VALUE_BLOB *Blob);
+STATIC UINTN DigitRun(IN CONST CHAR16 *String, IN UINTN Length, IN UINTN Radix);
+STATIC UINTN HexBlobSize(IN CONST CHAR16 *String);
+STATIC UINTN LoadChars(IN CONST CHAR16 *String);
+STATIC UINTN DigitLanes(IN UINTN Word, IN UINTN Radix);
+STATIC UINTN WordValue(IN UINTN Word, IN UINTN Radix);
+STATIC VOID TableError(IN UINTN i, IN CONST CHAR16 *errStr);
+STATIC VOID ParamValueError(IN CONST CHAR16 *ProgName, IN UINTN i, IN VALUE_TYPE ValueType, IN CONST CHAR16 *ValueStr, IN VALUE_STATUS ValueStatus);
+STATIC VOID SwitchValueError(IN CONST CHAR16 *ProgName, IN UINTN i, IN VALUE_TYPE ValueType, IN CONST CHAR16 *SwStr, IN CONST CHAR16 *SwString, IN VALUE_STATUS ValueStatus);
+STATIC SHELL_STATUS ShellParse(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error);
+STATIC SHELL_STATUS NativeParse(IN UINTN Argc, IN CHAR16 **Argv, IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, IN BOOLEAN UseArena, IN VOID *Arena, IN UINTN ArenaSize, OUT UINTN *ArenaRequired, OUT CMDLINE_ERROR *Error);
+STATIC UINTN NativeStorageSize(IN CMDLINE_PARSER *Parser);
+STATIC SHELL_STATUS InitParser(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT CMDLINE_PARSER *Parser, OUT CMDLINE_ERROR *Error);
+STATIC SHELL_STATUS NativeParseArgs(IN CMDLINE_PARSER *Parser, IN UINTN Argc, IN CHAR16 **Argv, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error);
+STATIC SHELL_STATUS GetValue(IN CMDLINE_PARSER *Parser, IN VOID *ValueRetPtr, IN UINT32 TypeMask, OUT CMDLINE_ERROR *Error);
+STATIC UINTN FindValueRecord(IN CMDLINE_PARSER *Parser, IN VOID *ValueRetPtr);
+STATIC VOID ValueRecordError(IN CMDLINE_PARSER *Parser, IN UINT16 FuncOpt, IN CHAR16 **Argv, IN UINTN Record, IN UINTN ArgIdx, IN VALUE_STATUS ValueStatus, OUT CMDLINE_ERROR *Error);
+STATIC VALUE_STATUS CollectValues(IN CMDLINE_PARSER *Parser, IN UINTN Argc, IN CHAR16 **Argv, IN UINTN Record, IN OUT UINTN *ArgIdx, IN VALUE_TYPE ValueType, IN DATA *Data, OUT VALUE_RET_PTR ValueRetPtr);
+STATIC UINTN LookupSwitch(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Arg);
+STATIC SUBCMD_TABLE *FindSubCmd(IN SUBCMD_TABLE *SubCmdTable, IN CONST CHAR16 *Name);
+STATIC CHAR16 *SubCmdProgName(IN CONST CHAR16 *ProgName, IN CONST CHAR16 *Name);
+STATIC BOOLEAN IsEscapable(IN CHAR16 Char);
+STATIC SHELL_STATUS MergeSwitchTables(IN SWITCH_TABLE *SwTable, IN SWITCH_TABLE *GlobalSwTable, OUT SWITCH_TABLE **Merged);
+STATIC VOID ClearError(OUT CMDLINE_ERROR *Error);
+STATIC VOID ParseError(IN CONST CHAR16 *ProgName, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error, IN CMDLINE_ERROR_CODE Code, IN UINTN ArgIndex, IN CONST CHAR16 *Arg, IN CONST CHAR16 *Value, IN UINTN Row, IN VALUE_TYPE ValueType);
+STATIC VOID ShellErrorArg(IN OUT CMDLINE_ERROR *Error, IN UINTN ArgIndex, IN BOOLEAN TableArg);
+STATIC CMDLINE_ERROR_CODE ValueErrorCode(IN VALUE_STATUS ValueStatus, IN BOOLEAN Switch);
+STATIC UINTN FindShellSwitch(IN CONST CHAR16 *Name, IN BOOLEAN IgnoreCase, IN UINTN Skip);
+STATIC UINTN FindShellParam(IN SHELL_PARAM_ITEM *ParamList, IN BOOLEAN AllowNumbers, IN UINTN Position);
+STATIC BOOLEAN IsSwitchToken(IN CONST CHAR16 *Arg, IN BOOLEAN AllowNumbers);
+STATIC BOOLEAN HasSignedRow(IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable);
+STATIC UINTN FindSwitch(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN CONST CHAR16 *Arg, IN UINT16 FuncOpt, IN SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount);
+STATIC UINT32 HashSwitchName(IN CONST CHAR16 *Name);
+STATIC UINTN SwitchIndexSlotCount(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt);
+STATIC VOID BuildSwitchIndex(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, OUT SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount);
+STATIC VOID AddSwitchIndex(IN CONST CHAR16 *Name, IN UINT16 Row, IN OUT SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount);
+STATIC UINTN SwitchPoolSize(IN SWITCH_TABLE *SwTable, IN UINTN SwCount);
+STATIC VOID BuildSwitchRecords(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, OUT SWITCH_RECORD *Records, OUT CHAR16 *NamePool);
+STATIC UINT8 SwitchRecordFlags(IN SWITCH_TABLE *Sw);
+STATIC UINTN FindSwitchRecord(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Arg);
+STATIC UINTN BuildPrefixIndex(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, OUT UINT16 *Rows);
+STATIC VOID SiftPrefixRow(IN SWITCH_TABLE *SwTable, IN OUT UINT16 *Rows, IN UINTN Root, IN UINTN Count);
+STATIC CONST CHAR16 *PrefixName(IN SWITCH_TABLE *SwTable, IN UINT16 Row);
+STATIC UINTN FindSwitchPrefix(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Arg);
+STATIC UINTN ScanSwitchPrefix(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, IN CONST CHAR16 *Arg);
+STATIC VOID AmbiguousSwitchError(IN CONST CHAR16 *ProgName, IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, IN UINTN ArgIndex, IN CONST CHAR16 *Arg, OUT CMDLINE_ERROR *Error);
+STATIC VOID BuildMandatoryBits(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, OUT UINTN *MandatoryBits);
+STATIC UINTN FindMissingSwitch(IN CONST UINTN *PresentBits, IN CONST UINTN *MandatoryBits, IN UINTN Words);
+STATIC CONST CHAR16 *CheckConstraint(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraint, OUT CONST CHAR16 **Name);
+STATIC VOID BuildConstraintRecords(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraints, IN UINTN Words, OUT UINTN *Records);
+STATIC UINTN FindFailedConstraint(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraints, IN CONST UINTN *Records, IN CONST UINTN *PresentBits, IN UINTN Words);
+STATIC BOOLEAN ConstraintRecordMet(IN CONSTRAINT_TYPE Type, IN CONST UINTN *Record, IN CONST UINTN *PresentBits, IN UINTN Words);
+STATIC BOOLEAN ConstraintMet(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraint, IN CONST UINTN *PresentBits, OUT CMDLINE_ERROR_CODE *Code, OUT UINTN *Row1, OUT UINTN *Row2);
+STATIC VOID ConstraintError(IN CONST CHAR16 *ProgName, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error, IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraint, IN CONST UINTN *PresentBits);
 STATIC BOOLEAN ArgNameDefined(IN CHAR16 *HelpStr);
 STATIC UINTN GetArgName(IN CHAR16 *HelpStr, OUT CHAR16* ArgName, IN UINTN ArgNameSize, IN BOOLEAN Mandatory, IN CONST CHAR16 *DefaultArgName);
+STATIC UINTN GetParamArgName(IN PARAMETER_TABLE *Param, OUT CHAR16 *ArgName, IN BOOLEAN Mandatory);
 STATIC VOID ShowHelp(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt);
+STATIC VOID ShowParserHelp(IN CMDLINE_PARSER *Parser);
+STATIC CHAR16 *BuildHelpText(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt);
+STATIC VOID WriteHelpText(IN CONST CHAR16 *HelpText);
+STATIC VOID RenderHelp(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt, IN OUT HELP_TEXT *Help);
+STATIC VOID RenderOptions(IN SWITCH_TABLE *SwTable, IN UINTN FuncOpt, IN OUT HELP_TEXT *Help);
+STATIC VOID RenderSwitchHelp(IN OUT HELP_TEXT *Help, IN CONST CHAR16 *SwStr1, IN CONST CHAR16 *SwStr2, IN CONST CHAR16 *ArgName, IN CONST CHAR16 *HelpStr, IN UINTN ShortWidth, IN UINTN LongWidth);
+STATIC VOID HelpAppend(IN OUT HELP_TEXT *Help, IN CONST CHAR16 *Str);
+STATIC VOID ShowCommandHelp(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt);
+STATIC VOID RenderCommandHelp(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt, IN OUT HELP_TEXT *Help);
+STATIC VOID HelpAppendPad(IN OUT HELP_TEXT *Help, IN UINTN Count);
+STATIC VOID PhaseBegin(IN UINT16 FuncOpt);
+STATIC CONST CHAR16 *CheckRow(IN VALUE_TYPE ValueType, IN DATA *Data, IN VALUE_RET_PTR ValueRetPtr, IN BOOLEAN Switch);
+STATIC BOOLEAN EnumSorted(IN ENUM_STR_ARRAY *EnumStrArray);
+STATIC CONST CHAR16 *CheckSwitchName(IN SWITCH_TABLE *SwTable, IN UINTN Row, IN CONST CHAR16 *Name, IN UINT16 FuncOpt, IN BOOLEAN AllowNumbers, IN OUT SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount);
+STATIC VOID PhaseMark(IN UINT16 FuncOpt, IN CMDLINE_PHASE Phase);
+STATIC VOID PhaseFinish(IN UINT16 FuncOpt);
 
 // globals
 STATIC CHAR16 BreakSwStr1[] = L"-b";
@@ -51,13 +139,82 @@ STATIC CHAR16 HelpSwStr1[] = L"-h";
 STATIC CHAR16 HelpSwStr2[] = L"-help";
 STATIC CONST CHAR16 HelpSwStr[] = L"display this help and exit";
 
+// phase timing, see CmdLineGetPhaseTimes()
+STATIC CMDLINE_PHASE_TIMES PhaseTimes;
+STATIC UINT64 PhaseStart;       // counter at start of current phase
+STATIC UINT64 ParseStart;       // counter at start of current parse
+STATIC BOOLEAN CounterDown;     // performance counter counts down
+
+#ifdef CMDLINE_WORK_COUNT
+UINTN gCmdLineWork;             // see CMDLINE_WORK()
+#endif
+
+STATIC CONST CHAR8 *PhaseToken[CMDLINE_PHASE_MAX] = {
+    "CmdLineTables", "CmdLineList", "CmdLineTokenize", "CmdLineParams",
+    "CmdLineSwitches", "CmdLineMandatory", "CmdLineHelp", "CmdLineCleanup"
+};
+
 STATIC CONST CHAR16 DefaultArgName[] = L"arg";
 
+// upper case ASCII letters, same result as CharToUpper() without the call
+#define FOLD_CHAR(c)    ((CHAR16)(((c) >= L'a' && (c) <= L'z') ? ((c) - (L'a' - L'A')) : (c)))
+
+// value types accepted by each typed getter
+#define VALTYPE_BIT(ValueType)  ((UINT32)1 << (ValueType))
+#define GET_UINTN_TYPES     (VALTYPE_BIT(VALTYPE_DECIMAL) | VALTYPE_BIT(VALTYPE_HEXIDECIMAL) | VALTYPE_BIT(VALTYPE_INTEGER) | VALTYPE_BIT(VALTYPE_NONE))
+#define GET_UINT64_TYPES    (VALTYPE_BIT(VALTYPE_DEC64) | VALTYPE_BIT(VALTYPE_HEX64) | VALTYPE_BIT(VALTYPE_INT64))
+#define GET_ANY_TYPE        MAX_UINT32
+
+// enum lookup of a value record, NULL if not built by CmdLineCompile()
+#define RECORD_ENUM(Parser, Record) ((Parser)->EnumIndex ? &(Parser)->EnumIndex[Record] : NULL)
+
+// FindSwitch() return values that are not switch table rows
+#define SW_IDX_NONE     ((UINTN)-1)
+#define SW_IDX_HELP     ((UINTN)-2)
+#define SW_IDX_BREAK    ((UINTN)-3)
+#define SW_IDX_AMBIGUOUS ((UINTN)-4)
+
 /**
  * ParseCmdLine()
  * 
  **/
 SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams)
+{
+    return ParseCmdLineEx(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, NumParams, NULL);
+}
+
+/**
+ * ParseCmdLineEx()
+ * 
+ **/
+SHELL_STATUS ParseCmdLineEx(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus;
+    CMDLINE_ERROR LocalError;
+
+    if (!Error) {
+        Error = &LocalError;
+    }
+    ClearError(Error);
+    PhaseBegin(FuncOpt);
+
+    // use native tokenizer if requested and shell parameters are available
+    if ((FuncOpt & NATIVE_PARSE) && gEfiShellParametersProtocol) {
+        ShellStatus = NativeParse(gEfiShellParametersProtocol->Argc, gEfiShellParametersProtocol->Argv, ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, NumParams, FALSE, NULL, 0, NULL, Error);
+    } else {
+        ShellStatus = ShellParse(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, NumParams, Error);
+    }
+    PhaseFinish(FuncOpt);
+
+    return ShellStatus;
+}
+
+/**
+ * Function: ShellParse
+ * 
+ * Parses the command line using ShellCommandLineParseEx()
+ **/
+STATIC SHELL_STATUS ShellParse(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error)
 {
     SHELL_STATUS ShellStatus = SHELL_INVALID_PARAMETER;
     EFI_STATUS Status = EFI_SUCCESS;
@@ -65,10 +222,17 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
     UINTN i, j;
     CHAR16 *ProblemParam = NULL;
     UINTN Memsize;
-    UINTN ParamCount, TableParamCount;    
+    UINTN ParamCount, TableParamCount, Row;
+    UINTN TableSwCount, Words;
+    UINTN *PresentBits, *MandatoryBits;
+    VALUE_STATUS ValueStatus;
+    BOOLEAN AllowNumbers = FALSE;
 
-    // initialise switch present flags
-    BOOLEAN SwPresent[MAX_SWITCH_ENTRIES] = {0};
+    if (FuncOpt & PREFIX_SWITCHES) {
+        // the shell only matches whole switch names
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, L"Switch: Prefix matching needs native tokenizer", CMDLINE_NO_ROW, VALTYPE_NONE);
+        return SHELL_UNSUPPORTED;
+    }
 
     // determine how many items for options table
     i = 0;
@@ -76,9 +240,34 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
         while (SwTable[i].SwitchNecessity != NO_SW) {
             if (SwTable[i].SwStr1) OptCount++;
             if (SwTable[i].SwStr2) OptCount++;
+            if (SwTable[i].ValueType == VALTYPE_STRVIEW) {
+                // values are copied into the package, which is freed on return
+                ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, L"Switch: String view needs native tokenizer", i, VALTYPE_STRVIEW);
+                return SHELL_UNSUPPORTED;
+            }
+            if (SwTable[i].ValueType == VALTYPE_SIGNED) {
+                AllowNumbers = TRUE;
+            }
             i++;
         }
     }
+    TableSwCount = i;
+    if (TableSwCount > MAX_SWITCH_ENTRIES) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, L"Exceeded maximum switch count", TableSwCount, VALTYPE_NONE);
+        return SHELL_OUT_OF_RESOURCES;
+    }
+    if (ParamTable) {
+        for (i = 0; ParamTable[i].ValueType != VALTYPE_NONE; i++) {
+            if (ParamTable[i].ValueType == VALTYPE_STRVIEW) {
+                ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, L"Parameter: String view needs native tokenizer", i, VALTYPE_STRVIEW);
+                return SHELL_UNSUPPORTED;
+            }
+            if (ParamTable[i].ValueType == VALTYPE_SIGNED) {
+                AllowNumbers = TRUE;
+            }
+        }
+    }
+    Words = SWBITS_WORDS(TableSwCount);
     // break switch    
     if (FuncOpt & FORCE_BREAK) {
         OptCount += 2;
@@ -87,13 +276,17 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
     if ((FuncOpt & NO_HELP) == 0) {
         OptCount += 2;
     }
+    PhaseMark(FuncOpt, CMDLINE_PHASE_TABLES);
     
-    // allocate memory for options table
-    Memsize = (OptCount+1) * sizeof(SHELL_PARAM_ITEM);
-    SHELL_PARAM_ITEM *ParamList = AllocateZeroPool(Memsize);
-    if (!ParamList) {
+    // allocate memory for switch bitsets and options table
+    Memsize = (Words * 2 * sizeof(UINTN)) + ((OptCount+1) * sizeof(SHELL_PARAM_ITEM));
+    PresentBits = AllocateZeroPool(Memsize);
+    if (!PresentBits) {
+        Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
         return SHELL_OUT_OF_RESOURCES;
     }
+    MandatoryBits = PresentBits + Words;
+    SHELL_PARAM_ITEM *ParamList = (SHELL_PARAM_ITEM *)(MandatoryBits + Words);
     
     // construct options table
     i = 0; j = 0;
@@ -133,6 +326,7 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
     // terminate list
     ParamList[j].Name = NULL;
     ParamList[j].Type = TypeMax;
+    PhaseMark(FuncOpt, CMDLINE_PHASE_LIST);
    
 #if DEBUG_MODE
     for (i=0; i<=OptCount; i++) {
@@ -157,13 +351,24 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
     if (ManParamCount > TableParamCount) {
         ManParamCount = TableParamCount;
     }
+    PhaseMark(FuncOpt, CMDLINE_PHASE_TABLES);
 
-    // parse command line
+    // parse command line, negative numbers are only values if a signed row can take them
     LIST_ENTRY *Package = NULL;
-    Status = ShellCommandLineParseEx(ParamList, &Package, &ProblemParam, TRUE, FALSE);
+    Status = ShellCommandLineParseEx(ParamList, &Package, &ProblemParam, TRUE, AllowNumbers);
+    PhaseMark(FuncOpt, CMDLINE_PHASE_TOKENIZE);
     if (EFI_ERROR(Status)) {
-        ShellPrintEx(-1, -1, L"%H%s%N: Unknown option - '%H%s%N'\r\n", ProgName, ProblemParam);
-        FreePool(ProblemParam);
+        if (Status == EFI_OUT_OF_RESOURCES) {
+            Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
+            ShellStatus = SHELL_OUT_OF_RESOURCES;
+        } else {
+            ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_UNKNOWN_SWITCH, 0, ProblemParam, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+        }
+        if (ProblemParam) {
+            // the shell stops at the first unknown switch
+            ShellErrorArg(Error, FindShellSwitch(ProblemParam, FALSE, 0), FALSE);
+            FreePool(ProblemParam);
+        }
         goto Error_exit;
     }
 
@@ -185,9 +390,12 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
 
     if (ShellCommandLineGetFlag(Package, HelpSwStr1) || ShellCommandLineGetFlag(Package, HelpSwStr2)) {
         ShowHelp(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt);
+        PhaseMark(FuncOpt, CMDLINE_PHASE_HELP);
+        Error->Code = CMDLINE_ERR_HELP;
         ShellStatus = SHELL_ABORTED;
         goto Error_exit;
     }
+    PhaseMark(FuncOpt, CMDLINE_PHASE_HELP);
 
     //------------
     // PARAMETERS 
@@ -198,47 +406,33 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
     if (NumParams) {
         *NumParams = ParamCount; // return number of actual parameters 
     }
-    if (ParamCount > TableParamCount) {
-        ShellPrintEx(-1, -1, L"%H%s%N: Too many parameters\r\n", ProgName);
+    if (ParamCount > TableParamCount && (TableParamCount == 0 || !VALTYPE_IS_VARIADIC(ParamTable[TableParamCount-1].ValueType))) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TOO_MANY_PARAMS, 0, ShellCommandLineGetRawValue(Package, TableParamCount+1), NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+        ShellErrorArg(Error, FindShellParam(ParamList, AllowNumbers, TableParamCount+1), FALSE);
         goto Error_exit;
     }
     if (ParamCount < ManParamCount) {
-        ShellPrintEx(-1, -1, L"%H%s%N: Too few parameters\r\n", ProgName);
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TOO_FEW_PARAMS, 0, NULL, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
         goto Error_exit;
     }
     // process parameters
     i = 0;
     for (i=0; i<ParamCount; i++) {
         CONST CHAR16 *ValueStr;
-        if (ParamTable[i].ValueRetPtr.pVoid == NULL) {
-            TableError(i, L"Parameter: Null 'RetValPtr'");
-            goto Error_exit;
-        }
         ValueStr = ShellCommandLineGetRawValue(Package, i+1);
-        if (!ReturnValue(ValueStr, ParamTable[i].ValueType, &ParamTable[i].Data, ParamTable[i].ValueRetPtr)) {
-            switch (ParamTable[i].ValueType) {
-            case VALTYPE_STRING:
-                ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid string - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
-                break;                
-            case VALTYPE_DECIMAL:
-                ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid decimal value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
-                break;                
-            case VALTYPE_HEXIDECIMAL:
-                ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid hex value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
-                break;
-            case VALTYPE_INTEGER:
-                ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid integer value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
-                break;
-            case VALTYPE_ENUM:
-                ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid option - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
-                break;
-            default:
-                TableError(i, L"Parameter: Invalid 'ValueType'");
-                goto Error_exit;
-            }
+        // remaining parameters all go to a variadic last row
+        Row = (i < TableParamCount) ? i : TableParamCount-1;
+        if (Row == i && VALTYPE_IS_VARIADIC(ParamTable[Row].ValueType)) {
+            ResetValueCount(ParamTable[Row].ValueType, ParamTable[Row].ValueRetPtr);
+        }
+        ValueStatus = ReturnValue(ValueStr, ParamTable[Row].ValueType, &ParamTable[Row].Data, NULL, ParamTable[Row].ValueRetPtr);
+        if (ValueStatus != VALUE_OK) {
+            ParseError(ProgName, FuncOpt, Error, ValueErrorCode(ValueStatus, FALSE), 0, ValueStr, NULL, Row, ParamTable[Row].ValueType);
+            ShellErrorArg(Error, FindShellParam(ParamList, AllowNumbers, i+1), FALSE);
             goto Error_exit;
         }
     }
+    PhaseMark(FuncOpt, CMDLINE_PHASE_PARAMS);
 
     //------------
     // SWITCHES 
@@ -247,14 +441,15 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
     // check for duplicate switches
     Status = ShellCommandLineCheckDuplicate(Package, &ProblemParam);    
     if (EFI_ERROR(Status)) {
-        ShellPrintEx(-1, -1, L"%H%s%N: Duplicate switch - '%H%s%N'\r\n", ProgName, ProblemParam);
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_DUPLICATE_SWITCH, 0, ProblemParam, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+        // the shell compares names exactly, the repeat is the offending one
+        ShellErrorArg(Error, FindShellSwitch(ProblemParam, FALSE, 1), FALSE);
         FreePool(ProblemParam);
         goto Error_exit;
     }
 
     // process switches
-    i = 0;
-    while (SwTable[i].SwitchNecessity != NO_SW) {
+    for (i = 0; i < TableSwCount; i++) {
         BOOLEAN found = FALSE;
         CHAR16 *SwStr = NULL;
         if (SwTable[i].SwStr1) {
@@ -269,21 +464,19 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
                     found = TRUE;
                     SwStr = SwTable[i].SwStr2;
                 } else {
-                    ShellPrintEx(-1, -1, L"%H%s%N: Duplicate switch - '%H%s%N'\r\n", ProgName, SwStr);
+                    ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_DUPLICATE_SWITCH, 0, SwTable[i].SwStr2, NULL, i, SwTable[i].ValueType);
+                    ShellErrorArg(Error, FindShellSwitch(SwTable[i].SwStr2, TRUE, 0), TRUE);
                     goto Error_exit;
                 }
             }
         }
         if (found) {
             CONST CHAR16 *SwString;
-            SwPresent[i] = TRUE;
+            SWBIT_SET(PresentBits, i);
             SwString = ShellCommandLineGetValue(Package, SwStr);
             if (!SwString && SwTable[i].ValueNecessity == MAN_VALUE) {
-                ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' requires a value\r\n", ProgName, SwStr);
-                goto Error_exit;
-            }
-            if (SwTable[i].ValueRetPtr.pVoid == NULL) {
-                TableError(i, L"Switch: Null 'RetValPtr'");
+                ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_SWITCH_NO_VALUE, 0, SwStr, NULL, i, SwTable[i].ValueType);
+                ShellErrorArg(Error, FindShellSwitch(SwStr, TRUE, 0), TRUE);
                 goto Error_exit;
             }
             if (SwTable[i].ValueType == VALTYPE_NONE) {
@@ -295,46 +488,35 @@ SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN
                     *(SwTable[i].ValueRetPtr.pBoolean) = TRUE;
                 }
             } else {
-                if (!ReturnValue(SwString, SwTable[i].ValueType, &SwTable[i].Data, SwTable[i].ValueRetPtr)) {
-                    switch (SwTable[i].ValueType) {
-                    case VALTYPE_STRING:
-                        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid string value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
-                        break;                
-                    case VALTYPE_DECIMAL:
-                        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid decimal value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
-                        break;                
-                    case VALTYPE_HEXIDECIMAL:
-                        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid hex value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
-                        break;
-                    case VALTYPE_INTEGER:
-                        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid integer value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
-                        break;
-                    case VALTYPE_ENUM:
-                            ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid option - '%H%s%N'\r\n", ProgName, SwStr, SwString);
-                        break;
-                    default:
-                        TableError(i, L"Switch: Invalid 'ValueType'");
-                        goto Error_exit;
-                    }
+                if (VALTYPE_IS_LIST(SwTable[i].ValueType)) {
+                    SwTable[i].ValueRetPtr.pList->Count = 0;
+                }
+                ValueStatus = ReturnValue(SwString, SwTable[i].ValueType, &SwTable[i].Data, NULL, SwTable[i].ValueRetPtr);
+                if (ValueStatus != VALUE_OK) {
+                    ParseError(ProgName, FuncOpt, Error, ValueErrorCode(ValueStatus, TRUE), 0, SwStr, SwString, i, SwTable[i].ValueType);
+                    ShellErrorArg(Error, FindShellSwitch(SwStr, TRUE, 0), TRUE);
                     goto Error_exit;
                 }
             }
         }
-        i++;
-        if (i >= MAX_SWITCH_ENTRIES) {
-            TableError(i, L"Exceeded maximum switch count");
-            return SHELL_OUT_OF_RESOURCES;
-        }
     }
-    
+    PhaseMark(FuncOpt, CMDLINE_PHASE_SWITCHES);
+
     // check mandatory switches
-    i = 0;
-    while (SwTable[i].SwitchNecessity != NO_SW) {
-        if (SwTable[i].SwitchNecessity == MAN_SW && !SwPresent[i]) {
-            ShellPrintEx(-1, -1, L"%H%s%N: Missing switch - '%H%s%N'\r\n", ProgName, SwTable[i].SwStr1);
-            goto Error_exit;
-        }
-        i++;
+    BuildMandatoryBits(SwTable, TableSwCount, MandatoryBits);
+    i = FindMissingSwitch(PresentBits, MandatoryBits, Words);
+    PhaseMark(FuncOpt, CMDLINE_PHASE_MANDATORY);
+    if (i != SW_IDX_NONE) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_MISSING_SWITCH, 0, SwTable[i].SwStr1 ? SwTable[i].SwStr1 : SwTable[i].SwStr2, NULL, i, SwTable[i].ValueType);
+        goto Error_exit;
+    }
+
+    // check constraints
+    i = SwTable ? FindFailedConstraint(SwTable, TableSwCount, SwTable[TableSwCount].Data.Constraints, NULL, PresentBits, Words) : CMDLINE_NO_ROW;
+    PhaseMark(FuncOpt, CMDLINE_PHASE_MANDATORY);
+    if (i != CMDLINE_NO_ROW) {
+        ConstraintError(ProgName, FuncOpt, Error, SwTable, TableSwCount, &SwTable[TableSwCount].Data.Constraints[i], PresentBits);
+        goto Error_exit;
     }
     ShellStatus = SHELL_SUCCESS;
     
@@ -343,341 +525,3625 @@ Error_exit:
         ShellCommandLineFreeVarList(Package);
         Package = NULL;
     }
-    if (ParamList) {
-        FreePool(ParamList);
-        ParamList = NULL;
+    if (PresentBits) {
+        FreePool(PresentBits);     // also frees ParamList
+        PresentBits = NULL;
     }
 
     return ShellStatus;
 }
 
 /**
- * Function: ReturnValue
+ * ParseCmdLineArena()
  * 
  **/
-STATIC BOOLEAN ReturnValue(IN CONST CHAR16 *String, IN VALUE_TYPE ValueType, IN DATA *Data, OUT VALUE_RET_PTR ValueRetPtr)
+SHELL_STATUS ParseCmdLineArena(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, IN VOID *Arena, IN UINTN ArenaSize, OUT UINTN *ArenaRequired)
 {
-    UINTN Value;
-    
-    if (!ValueRetPtr.pVoid) {
-        return FALSE;
-    }
+    SHELL_STATUS ShellStatus;
+    CMDLINE_ERROR Error;
+    CMDLINE_PARSER Parser;
 
-    switch (ValueType) {
-    case VALTYPE_STRING:
-        StrnCpyS(ValueRetPtr.pChar16, Data->MaxStrSize, String, Data->MaxStrSize-1);
-        break;
-    case VALTYPE_DECIMAL:
-        if (!IsDecimalString(String)) {
-            return FALSE;
-        }
-        Value = StrDecimalToUintn(String);
-        *ValueRetPtr.pUintn = Value;
-        break;                
-    case VALTYPE_HEXIDECIMAL:
-        if (!IsHexString(String)) {
-            return FALSE;
-        }
-        Value = StrHexToUintn(String);
-        *ValueRetPtr.pUintn = Value;
-        break;
-    case VALTYPE_INTEGER:
-        if (IsDecimalString(String)) {
-            Value = StrDecimalToUintn(String);
-            *ValueRetPtr.pUintn = Value;
-        } else if (HasHexPrefix(String)) {
-            if (!IsHexString(String)) {
-                return FALSE;
-            }
-            Value = StrHexToUintn(String);
-            *ValueRetPtr.pUintn = Value;
-        } else {
-            return FALSE;
+    ClearError(&Error);
+    // no shell parameters protocol (EFI shell 1.0), so no argument vector
+    // to parse, the size required is still returned
+    if (!gEfiShellParametersProtocol) {
+        ShellStatus = InitParser(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, &Parser, &Error);
+        if (ShellStatus != SHELL_SUCCESS) {
+            return ShellStatus;
         }
-        break;
-    case VALTYPE_ENUM:
-        if(GetEnumVal(Data->EnumStrArray, String, &Value)) {
-            *ValueRetPtr.pEnum = (unsigned int)Value;
-        } else {
-            return FALSE;
+        if (ArenaRequired) {
+            *ArenaRequired = NativeStorageSize(&Parser);
         }
-        break;
-    default:
-        return FALSE;
+        return SHELL_UNSUPPORTED;
     }
-    
-    return TRUE;
+    PhaseBegin(FuncOpt);
+    ShellStatus = NativeParse(gEfiShellParametersProtocol->Argc, gEfiShellParametersProtocol->Argv, ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, NumParams, TRUE, Arena, ArenaSize, ArenaRequired, &Error);
+    PhaseFinish(FuncOpt);
+
+    return ShellStatus;
 }
 
 /**
- * Function: GetEnumVal
+ * CmdLineCompile()
  * 
  **/
-STATIC BOOLEAN GetEnumVal(IN ENUM_STR_ARRAY *EnumStrArray, IN CONST CHAR16 *Str, OUT UINTN *Value)
+SHELL_STATUS CmdLineCompile(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT CMDLINE_PARSER **Parser)
 {
-    BOOLEAN found = FALSE;
-    UINTN i = 0;
-    while (EnumStrArray[i].Str) {
-        if (StriCmp(Str, EnumStrArray[i].Str) == 0) {
-            if (Value) {
-                *Value = EnumStrArray[i].Value;
-            }
-            found = TRUE;
-            break;
+    SHELL_STATUS ShellStatus;
+    CMDLINE_PARSER Template;
+    CMDLINE_PARSER *NewParser;
+    CMDLINE_ERROR Error;
+    UINTN LazySize;
+    UINTN EnumSize;
+    UINTN PrefixSize;
+    UINTN PoolSize;
+    UINTN ConstraintCount = 0;
+    UINT8 *Next;
+
+    if (!Parser) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    *Parser = NULL;
+    ClearError(&Error);
+    // check tables once here rather than on every parse
+    ShellStatus = CmdLineValidateTables(ProgName, ParamTable, SwTable, FuncOpt, &Error);
+    if (ShellStatus != SHELL_SUCCESS) {
+        return ShellStatus;
+    }
+    ShellStatus = InitParser(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, &Template, &Error);
+    if (ShellStatus != SHELL_SUCCESS) {
+        return ShellStatus;
+    }
+
+    // parser followed by switch bitsets, constraint records, value records, enum
+    // counts, long name order, name index, switch records then name pool, in one block
+    while (Template.Constraints && Template.Constraints[ConstraintCount].Type != NO_CONSTRAINT) {
+        ConstraintCount++;
+    }
+    LazySize = (FuncOpt & LAZY_VALUES) ? LAZY_RECORD_SIZE(Template.TableSwCount + Template.TableParamCount) : 0;
+    EnumSize = EnumIndexSize(&Template);
+    PrefixSize = (FuncOpt & PREFIX_SWITCHES) ? SW_PREFIX_SIZE(Template.TableSwCount) : 0;
+    PoolSize = SwitchPoolSize(SwTable, Template.TableSwCount);
+    if (PoolSize >= SW_NO_NAME) {
+        // names too long for 16 bit offsets, read from the table instead
+        PoolSize = 0;
+    }
+    NewParser = AllocatePool(sizeof(CMDLINE_PARSER) + (Template.Words * 2 * sizeof(UINTN)) + (ConstraintCount * CONSTRAINT_RECORD_WORDS(Template.Words) * sizeof(UINTN)) + LazySize + EnumSize + PrefixSize + (Template.SlotCount * sizeof(SWITCH_INDEX_SLOT)) +
+                             (PoolSize ? (Template.TableSwCount * sizeof(SWITCH_RECORD)) + (PoolSize * sizeof(CHAR16)) : 0));
+    if (!NewParser) {
+        return SHELL_OUT_OF_RESOURCES;
+    }
+    CopyMem(NewParser, &Template, sizeof(CMDLINE_PARSER));
+    NewParser->CacheHelp = TRUE;
+    NewParser->PresentBits = (UINTN *)(NewParser + 1);
+    NewParser->MandatoryBits = NewParser->PresentBits + NewParser->Words;
+    BuildMandatoryBits(SwTable, NewParser->TableSwCount, NewParser->MandatoryBits);
+    Next = (UINT8 *)(NewParser->MandatoryBits + NewParser->Words);
+    if (ConstraintCount) {
+        NewParser->ConstraintRecords = (UINTN *)Next;
+        BuildConstraintRecords(SwTable, NewParser->TableSwCount, NewParser->Constraints, NewParser->Words, NewParser->ConstraintRecords);
+        Next += ConstraintCount * CONSTRAINT_RECORD_WORDS(NewParser->Words) * sizeof(UINTN);
+    }
+    if (LazySize) {
+        NewParser->ValueArgs = (UINTN *)Next;
+        NewParser->ConvertedBits = NewParser->ValueArgs + NewParser->TableSwCount + NewParser->TableParamCount;
+        Next += LazySize;
+    }
+    if (EnumSize) {
+        NewParser->EnumIndex = (ENUM_INDEX *)Next;
+        BuildEnumIndex(NewParser, NewParser->EnumIndex);
+        Next += EnumSize;
+    }
+    if (PrefixSize) {
+        // built here so parsing never writes to the parser
+        NewParser->PrefixRows = (UINT16 *)Next;
+        NewParser->PrefixCount = BuildPrefixIndex(SwTable, NewParser->TableSwCount, FuncOpt, NewParser->PrefixRows);
+        if (!NewParser->PrefixCount) {
+            NewParser->PrefixRows = NULL;
         }
-        i++;
+        Next += PrefixSize;
     }
-    return found;
+    if (NewParser->SlotCount) {
+        NewParser->Slots = (SWITCH_INDEX_SLOT *)Next;
+        BuildSwitchIndex(SwTable, NewParser->TableSwCount, FuncOpt, NewParser->Slots, NewParser->SlotCount);
+        Next += NewParser->SlotCount * sizeof(SWITCH_INDEX_SLOT);
+    }
+    if (PoolSize) {
+        NewParser->Records = (SWITCH_RECORD *)Next;
+        NewParser->NamePool = (CHAR16 *)(NewParser->Records + NewParser->TableSwCount);
+        BuildSwitchRecords(SwTable, NewParser->TableSwCount, NewParser->Records, NewParser->NamePool);
+    }
+
+    *Parser = NewParser;
+    return SHELL_SUCCESS;
 }
 
 /**
- * Function: StriCmp
+ * CmdLineParseArgs()
  * 
  **/
-STATIC INTN EFIAPI StriCmp(IN CONST CHAR16 *FirstString, IN CONST CHAR16 *SecondString)
+SHELL_STATUS CmdLineParseArgs(IN CMDLINE_PARSER *Parser, IN UINTN Argc, IN CHAR16 **Argv, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error)
 {
-  CHAR16  UpperFirstString;
-  CHAR16  UpperSecondString;
+    SHELL_STATUS ShellStatus;
+    CMDLINE_ERROR LocalError;
 
-  UpperFirstString  = CharToUpper(*FirstString);
-  UpperSecondString = CharToUpper(*SecondString);
-  while ((*FirstString != L'\0') && (*SecondString != L'\0') && (UpperFirstString == UpperSecondString)) {
-    FirstString++;
-    SecondString++;
-    UpperFirstString  = CharToUpper(*FirstString);
-    UpperSecondString = CharToUpper(*SecondString);
-  }
+    if (!Error) {
+        Error = &LocalError;
+    }
+    ClearError(Error);
+    if (!Parser || (Argc && !Argv)) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    PhaseBegin(Parser->FuncOpt);
+    ShellStatus = NativeParseArgs(Parser, Argc, Argv, NumParams, Error);
+    PhaseFinish(Parser->FuncOpt);
 
-  return UpperFirstString - UpperSecondString;
+    return ShellStatus;
 }
 
 /**
- * Function: HasHexPrefix
+ * CmdLineGetValue()
  * 
  **/
-STATIC BOOLEAN HasHexPrefix(IN CONST CHAR16 *String)
+SHELL_STATUS CmdLineGetValue(IN CMDLINE_PARSER *Parser, IN VOID *ValueRetPtr, OUT CMDLINE_ERROR *Error)
 {
-    BOOLEAN LeadingZero = FALSE;
-    
-    while ((*String == L' ') || (*String == L'\t')) {
-        String++;
-    }
-    while (*String == L'0') {
-        LeadingZero = TRUE;
-        String++;
-    }
-    if (CharToUpper(*String) == L'X') {
-        if (!LeadingZero) {
-            return FALSE;
-        }    
-    } else {
-        return FALSE;
-    }
-    return TRUE; 
+    return GetValue(Parser, ValueRetPtr, GET_ANY_TYPE, Error);
 }
 
 /**
- * Function: IsHexString
+ * CmdLineGetUintn()
  * 
  **/
-STATIC BOOLEAN IsHexString(IN CONST CHAR16 *String)
+SHELL_STATUS CmdLineGetUintn(IN CMDLINE_PARSER *Parser, IN OUT UINTN *Value)
 {
-    BOOLEAN LeadingZero = FALSE;
-    
-    while ((*String == L' ') || (*String == L'\t')) {
-        String++;
-    }
-    while (*String == L'0') {
-        LeadingZero = TRUE;
-        String++;
-    }
-    if (CharToUpper(*String) == L'X') {
-        if (!LeadingZero) {
-            return FALSE;
-        }    
-        String++; // Skip the 'X'
-    }
-    while (InternalIsHexaDecimalDigitCharacter(*String)) {    
-        String++;
-    }
-    return *String == L'\0' ? TRUE : FALSE;
+    return GetValue(Parser, Value, GET_UINTN_TYPES, NULL);
 }
 
 /**
- * Function: IsDecimalString
+ * CmdLineGetIntn()
  * 
  **/
-STATIC BOOLEAN IsDecimalString(IN CONST CHAR16 *String)
+SHELL_STATUS CmdLineGetIntn(IN CMDLINE_PARSER *Parser, IN OUT INTN *Value)
 {
-    while ((*String == L' ') || (*String == L'\t')) {
-        String++;
-    }
-    while (InternalIsDecimalDigitCharacter(*String)) {
-        String++;
-    }
-    return *String == L'\0' ? TRUE : FALSE;
+    return GetValue(Parser, Value, VALTYPE_BIT(VALTYPE_SIGNED), NULL);
 }
 
 /**
- * TableError()
+ * CmdLineGetUint64()
  * 
  **/
-STATIC VOID TableError(IN UINTN i, IN CHAR16 *errStr)
+SHELL_STATUS CmdLineGetUint64(IN CMDLINE_PARSER *Parser, IN OUT UINT64 *Value)
 {
-    ShellPrintEx(-1, -1, L"TBLERR(%d): %s\n", i, errStr);
+    return GetValue(Parser, Value, GET_UINT64_TYPES, NULL);
 }
 
 /**
- * ArgNameDefined()
+ * CmdLineGetString()
  * 
  **/
-STATIC BOOLEAN ArgNameDefined(IN CHAR16 *HelpStr)
+SHELL_STATUS CmdLineGetString(IN CMDLINE_PARSER *Parser, IN OUT CHAR16 *Value)
 {
-    return HelpStr[0] == L'[' ? TRUE:FALSE;
+    return GetValue(Parser, Value, VALTYPE_BIT(VALTYPE_STRING), NULL);
 }
 
 /**
- * GetArgName()
+ * CmdLineGetStrView()
  * 
  **/
-STATIC UINTN GetArgName(IN CHAR16 *HelpStr, OUT CHAR16* ArgName, IN UINTN ArgNameSize, IN BOOLEAN Mandatory, IN CONST CHAR16 *DefaultArgName)
+SHELL_STATUS CmdLineGetStrView(IN CMDLINE_PARSER *Parser, IN OUT VALUE_STRVIEW *Value)
 {
-    UINTN HelpStartIdx = 0;             // start of help text
-    CONST CHAR16 *ArgPtr = NULL;
-    UINTN ArgLen = 0;
+    return GetValue(Parser, Value, VALTYPE_BIT(VALTYPE_STRVIEW), NULL);
+}
 
-    if (ArgNameDefined(HelpStr)) {
-        UINTN i = 1;  // skip start brace
-        while (TRUE) {
-            CHAR16 c = HelpStr[i];
-            if (c == L']') {
-                // valid argument name found
-                ArgPtr = &HelpStr[1];   // char after '['
-                ArgLen = i-1;
-                break;
-            }
-            if (c == L'\0') {
-                // no end brace for arg name
-                break;
-            }
-            i++;
-        }
-        HelpStartIdx = i+1;
+/**
+ * CmdLineGetEnum()
+ * 
+ **/
+SHELL_STATUS CmdLineGetEnum(IN CMDLINE_PARSER *Parser, IN OUT unsigned int *Value)
+{
+    return GetValue(Parser, Value, VALTYPE_BIT(VALTYPE_ENUM), NULL);
+}
+
+/**
+ * Function: GetValue
+ * 
+ * Finds the table entry by its return variable and converts the value
+ * recorded by the last parse, once. Bits of ConvertedBits and entries
+ * of ValueArgs are switch rows then parameters.
+ **/
+STATIC SHELL_STATUS GetValue(IN CMDLINE_PARSER *Parser, IN VOID *ValueRetPtr, IN UINT32 TypeMask, OUT CMDLINE_ERROR *Error)
+{
+    CMDLINE_ERROR LocalError;
+    VALUE_STATUS ValueStatus;
+    VALUE_TYPE ValueType;
+    DATA *Data;
+    VALUE_RET_PTR RetPtr;
+    UINTN Record;
+    UINTN ArgIdx;
+    UINTN i;
+    BOOLEAN Given;
+
+    if (!Error) {
+        Error = &LocalError;
     }
-    if (!ArgPtr && DefaultArgName) {
-        // no argument name specified so use default
-        ArgPtr = DefaultArgName;
-        ArgLen = StrLen(DefaultArgName);
+    ClearError(Error);
+    if (!Parser || !ValueRetPtr) {
+        return SHELL_INVALID_PARAMETER;
     }
-    if (ArgPtr) {
-        if (Mandatory) {
-            StrnCpyS(ArgName, ArgNameSize, ArgPtr, (ArgLen >= ArgNameSize) ? ArgNameSize-1 : ArgLen);
-        } else {
-            // optional argument
-            ArgName[0] = L'[';
-            ArgName[1] = L'\0';
-            StrnCatS(ArgName, ArgNameSize-1, ArgPtr, (ArgLen >= ArgNameSize-3) ? ArgNameSize-3 : ArgLen);
-            StrCatS(ArgName, ArgNameSize, L"]");
-        }
+    Record = FindValueRecord(Parser, ValueRetPtr);
+    if (Record == CMDLINE_NO_ROW) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    if (Record < Parser->TableSwCount) {
+        Given = SWBIT_TEST(Parser->PresentBits, Record) ? TRUE : FALSE;
+        ValueType = Parser->SwTable[Record].ValueType;
+        Data = &Parser->SwTable[Record].Data;
+        RetPtr = Parser->SwTable[Record].ValueRetPtr;
     } else {
-        // no argument name specified or default given
-        ArgName[0] = L'\0';
+        i = Record - Parser->TableSwCount;
+        Given = (i < Parser->ParamCount);
+        ValueType = Parser->ParamTable[i].ValueType;
+        Data = &Parser->ParamTable[i].Data;
+        RetPtr = Parser->ParamTable[i].ValueRetPtr;
+    }
+    // a getter for another type would write a value of the wrong size
+    if ((TypeMask & VALTYPE_BIT(ValueType)) == 0) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    if (!Given) {
+        return SHELL_NOT_FOUND;
     }
 
-    return HelpStartIdx;
+    // converted by the parse, no value given or already converted
+    if (!Parser->ValueArgs || Parser->ValueArgs[Record] == 0 || SWBIT_TEST(Parser->ConvertedBits, Record)) {
+        return SHELL_SUCCESS;
+    }
+    ArgIdx = Parser->ValueArgs[Record];
+    ValueStatus = ReturnValue(Parser->Argv[ArgIdx], ValueType, Data, RECORD_ENUM(Parser, Record), RetPtr);
+    if (ValueStatus != VALUE_OK) {
+        ValueRecordError(Parser, Parser->FuncOpt, Parser->Argv, Record, ArgIdx, ValueStatus, Error);
+        return SHELL_INVALID_PARAMETER;
+    }
+    SWBIT_SET(Parser->ConvertedBits, Record);
+    return SHELL_SUCCESS;
 }
+
 /**
- * Function: ShowHelp
+ * CmdLineResultCreate()
  * 
  **/
-
-STATIC VOID ShowHelp(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt)
+SHELL_STATUS CmdLineResultCreate(IN CMDLINE_PARSER *Parser, OUT CMDLINE_RESULT **Result)
 {
-    const UINTN ArgNameSize = 24;
-    CHAR16 ArgName[ArgNameSize];
-    UINTN HelpIdx;
+    CMDLINE_RESULT *NewResult;
+    UINTN Count;
 
-    if (FuncOpt & NO_HELP) {
-        return;
+    if (!Parser || !Result) {
+        return SHELL_INVALID_PARAMETER;
     }
+    *Result = NULL;
 
-    // initialise padding string
-    const UINTN PadSize = 20;
-    CHAR16 pad[PadSize];
-    for (UINTN i=0; i<PadSize; i++) {
-        pad[i] = L' ';
+    // result followed by switch bitset then value records, in one block
+    Count = Parser->TableSwCount + Parser->TableParamCount;
+    NewResult = AllocateZeroPool(sizeof(CMDLINE_RESULT) + (Parser->Words * sizeof(UINTN)) + LAZY_RECORD_SIZE(Count));
+    if (!NewResult) {
+        return SHELL_OUT_OF_RESOURCES;
     }
-    pad[PadSize-1] = L'\0';
+    NewResult->Parser = Parser;
+    NewResult->PresentBits = (UINTN *)(NewResult + 1);
+    NewResult->ValueArgs = NewResult->PresentBits + Parser->Words;
+    NewResult->ConvertedBits = NewResult->ValueArgs + Count;
 
-    // program description
-    ShellPrintEx(-1, -1, L"\n");
-    
-    if (ProgHelpStr) {
-        ShellPrintEx(-1, -1, L"%s\n\n", ProgHelpStr);
-    }
+    *Result = NewResult;
+    return SHELL_SUCCESS;
+}
 
-    // usage
-    ShellPrintEx(-1, -1, L"Usage: %s", ProgName);
-    UINTN i = 0;
-    while (ParamTable[i].ValueType != VALTYPE_NONE) {
-        GetArgName(ParamTable[i].HelpStr, ArgName, ArgNameSize, (i+1 <= ManParamCount), DefaultArgName);
-        ShellPrintEx(-1, -1, L" %s", ArgName);
-        i++;
+/**
+ * CmdLineParseResult()
+ * 
+ **/
+SHELL_STATUS CmdLineParseResult(IN CMDLINE_RESULT *Result, IN UINTN Argc, IN CHAR16 **Argv, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus;
+    CMDLINE_PARSER Parser;
+    CMDLINE_ERROR LocalError;
+
+    if (!Error) {
+        Error = &LocalError;
+    }
+    ClearError(Error);
+    if (!Result || (Argc && !Argv)) {
+        return SHELL_INVALID_PARAMETER;
     }
-    ShellPrintEx(-1, -1, L" [options]\n");
 
-    // Parameter help
-    if (ParamTable) {
-        ShellPrintEx(-1, -1, L"\n Parameters:\n");
-        i = 0;
-        while (ParamTable[i].ValueType != VALTYPE_NONE) {
-            HelpIdx = GetArgName(ParamTable[i].HelpStr, ArgName, ArgNameSize, (i+1 <= ManParamCount), DefaultArgName);
-            // get rid of spaces below ###
-            ShellPrintEx(-1, -1, L"  %s%s     %s\n", ArgName, &pad[StrLen(ArgName)], &ParamTable[i].HelpStr[HelpIdx]);
-            i++;
-        }
+    // private copy of the parser whose working storage is the result, so
+    // the shared parser, the tables and the globals are never written
+    CopyMem(&Parser, Result->Parser, sizeof(CMDLINE_PARSER));
+    Parser.FuncOpt = (UINT16)((Parser.FuncOpt | QUIET_ERRORS) & ~PHASE_TIMING);
+    Parser.PresentBits = Result->PresentBits;
+    Parser.ValueArgs = Result->ValueArgs;
+    Parser.ConvertedBits = Result->ConvertedBits;
+    Parser.HelpText = NULL;
+    Parser.CacheHelp = FALSE;
+    Parser.RecordOnly = TRUE;
+    ShellStatus = NativeParseArgs(&Parser, Argc, Argv, NumParams, Error);
+    Result->Argc = Argc;
+    Result->Argv = Argv;
+    Result->ParamCount = Parser.ParamCount;
+
+    return ShellStatus;
+}
+
+/**
+ * CmdLineResultGetValue()
+ * 
+ **/
+SHELL_STATUS CmdLineResultGetValue(IN CMDLINE_RESULT *Result, IN VOID *ValueRetPtr, OUT VOID *Value, OUT CMDLINE_ERROR *Error)
+{
+    CMDLINE_PARSER *Parser;
+    CMDLINE_ERROR LocalError;
+    VALUE_STATUS ValueStatus;
+    VALUE_TYPE ValueType;
+    DATA *Data;
+    VALUE_RET_PTR RetPtr;
+    UINTN Record;
+    UINTN ArgIdx;
+    UINTN i;
+
+    if (!Error) {
+        Error = &LocalError;
     }
-    // Switch help
-    ShellPrintEx(-1, -1, L"\n Options:\n");
-    if (SwTable) {
-        i = 0;
-        while (SwTable[i].SwitchNecessity != NO_SW) {
-            HelpIdx = GetArgName(SwTable[i].HelpStr, ArgName, ArgNameSize, TRUE, (SwTable[i].ValueType == VALTYPE_NONE) ? NULL : DefaultArgName);
-            CHAR16 SeperatorChar = L',';
-            CHAR16 *SwStr1 = SwTable[i].SwStr1;
-            CHAR16 *SwStr2 = SwTable[i].SwStr2;
-            if (!SwStr1) {
-                SwStr1 = &pad[(PadSize-1)-2]; // 2 spaces for short switch
-                SeperatorChar = L' ';
-            }
-            if (!SwStr2) {
-                SwStr2 = &pad[PadSize-1]; // null str
-                SeperatorChar = L' ';
-            }
-            UINTN TotalLen = StrLen(SwStr2) + StrLen(ArgName);
-            CHAR16 *PadStr = (TotalLen > PadSize-1) ? &pad[(PadSize-1)-1] : &pad[TotalLen];
-            ShellPrintEx(-1, -1, L"  %s%c %s %s%s%s", SwStr1, SeperatorChar, SwStr2, ArgName, PadStr, &SwTable[i].HelpStr[HelpIdx]);
-            if (SwTable[i].ValueType == VALTYPE_ENUM) {
-                // print all valid options for enum switches
-                ShellPrintEx(-1, -1, L" (");
-                UINTN j = 0;
-                while (SwTable[i].Data.EnumStrArray[j].Str) {
-                    ShellPrintEx(-1, -1, L"%s", SwTable[i].Data.EnumStrArray[j].Str);
-                    j++;
-                    if (SwTable[i].Data.EnumStrArray[j].Str) {
-                        ShellPrintEx(-1, -1, L"|");
-                    }
-                }
-                ShellPrintEx(-1, -1, L")");
-            }
-            ShellPrintEx(-1, -1, L"\n");
-            i++;
-        }
+    ClearError(Error);
+    if (!Result || !ValueRetPtr || !Value) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    Parser = Result->Parser;
+    Record = FindValueRecord(Parser, ValueRetPtr);
+    if (Record == CMDLINE_NO_ROW) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    RetPtr.pVoid = Value;
+    if (Record < Parser->TableSwCount) {
+        if (!SWBIT_TEST(Result->PresentBits, Record)) {
+            return SHELL_NOT_FOUND;
+        }
+        ValueType = Parser->SwTable[Record].ValueType;
+        Data = &Parser->SwTable[Record].Data;
+        if (ValueType == VALTYPE_NONE) {
+            if (Data->FlagValue) {
+                *RetPtr.pUintn = Data->FlagValue;
+            } else {
+                *RetPtr.pBoolean = TRUE;
+            }
+            return SHELL_SUCCESS;
+        }
+    } else {
+        i = Record - Parser->TableSwCount;
+        if (i >= Result->ParamCount) {
+            return SHELL_NOT_FOUND;
+        }
+        ValueType = Parser->ParamTable[i].ValueType;
+        Data = &Parser->ParamTable[i].Data;
+    }
+
+    ArgIdx = Result->ValueArgs[Record];
+    if (ArgIdx == 0) {
+        // switch given without its optional value
+        return SHELL_SUCCESS;
+    }
+    if (VALTYPE_IS_VARIADIC(ValueType)) {
+        ResetValueCount(ValueType, RetPtr);
+        ValueStatus = CollectValues(Parser, Result->Argc, Result->Argv, Record, &ArgIdx, ValueType, Data, RetPtr);
+    } else {
+        ValueStatus = ReturnValue(Result->Argv[ArgIdx], ValueType, Data, RECORD_ENUM(Parser, Record), RetPtr);
+    }
+    if (ValueStatus != VALUE_OK) {
+        ValueRecordError(Parser, Parser->FuncOpt | QUIET_ERRORS, Result->Argv, Record, ArgIdx, ValueStatus, Error);
+        return SHELL_INVALID_PARAMETER;
+    }
+    return SHELL_SUCCESS;
+}
+
+/**
+ * CmdLineResultFree()
+ * 
+ **/
+VOID CmdLineResultFree(IN CMDLINE_RESULT *Result)
+{
+    if (Result) {
+        FreePool(Result);
+    }
+}
+
+/**
+ * Function: FindValueRecord
+ * 
+ * Returns the value record (switch rows then parameters) of the entry
+ * with return variable ValueRetPtr, or CMDLINE_NO_ROW
+ **/
+STATIC UINTN FindValueRecord(IN CMDLINE_PARSER *Parser, IN VOID *ValueRetPtr)
+{
+    UINTN i;
+
+    for (i = 0; i < Parser->TableSwCount; i++) {
+        if (Parser->SwTable[i].ValueRetPtr.pVoid == ValueRetPtr) {
+            return i;
+        }
+    }
+    for (i = 0; i < Parser->TableParamCount; i++) {
+        if (Parser->ParamTable[i].ValueRetPtr.pVoid == ValueRetPtr) {
+            return Parser->TableSwCount + i;
+        }
+    }
+    return CMDLINE_NO_ROW;
+}
+
+/**
+ * Function: ValueRecordError
+ * 
+ * As ParseError() for the value at Argv[ArgIdx] of a value record
+ **/
+STATIC VOID ValueRecordError(IN CMDLINE_PARSER *Parser, IN UINT16 FuncOpt, IN CHAR16 **Argv, IN UINTN Record, IN UINTN ArgIdx, IN VALUE_STATUS ValueStatus, OUT CMDLINE_ERROR *Error)
+{
+    UINTN i;
+
+    if (Record < Parser->TableSwCount) {
+        ParseError(Parser->ProgName, FuncOpt, Error, ValueErrorCode(ValueStatus, TRUE), ArgIdx-1, Argv[ArgIdx-1], Argv[ArgIdx], Record, Parser->SwTable[Record].ValueType);
+    } else {
+        i = Record - Parser->TableSwCount;
+        ParseError(Parser->ProgName, FuncOpt, Error, ValueErrorCode(ValueStatus, FALSE), ArgIdx, Argv[ArgIdx], NULL, i, Parser->ParamTable[i].ValueType);
+    }
+}
+
+/**
+ * Function: CollectValues
+ * 
+ * Passes each value of list switch or variadic parameter Record to
+ * ReturnValue(). Only the first value is recorded, at ArgIdx, so the
+ * rest are found by repeating the parse from there. ArgIdx returns the
+ * last value passed.
+ **/
+STATIC VALUE_STATUS CollectValues(IN CMDLINE_PARSER *Parser, IN UINTN Argc, IN CHAR16 **Argv, IN UINTN Record, IN OUT UINTN *ArgIdx, IN VALUE_TYPE ValueType, IN DATA *Data, OUT VALUE_RET_PTR ValueRetPtr)
+{
+    SWITCH_TABLE *SwTable = Parser->SwTable;
+    VALUE_STATUS ValueStatus;
+    UINTN Found;
+    UINTN Idx;
+
+    Idx = *ArgIdx;
+    ValueStatus = ReturnValue(Argv[Idx], ValueType, Data, RECORD_ENUM(Parser, Record), ValueRetPtr);
+    for (Idx++; ValueStatus == VALUE_OK && Idx < Argc; Idx++) {
+        if (!IsSwitchToken(Argv[Idx], Parser->AllowNumbers)) {
+            // parameters after the first variadic one are all variadic
+            if (Record >= Parser->TableSwCount) {
+                *ArgIdx = Idx;
+                ValueStatus = ReturnValue(Argv[Idx], ValueType, Data, RECORD_ENUM(Parser, Record), ValueRetPtr);
+            }
+            continue;
+        }
+        Found = LookupSwitch(Parser, Argv[Idx]);
+        if (Found >= Parser->TableSwCount || SwTable[Found].ValueType == VALTYPE_NONE) {
+            continue;
+        }
+        // skip the value of any other switch
+        if (Idx+1 >= Argc || IsSwitchToken(Argv[Idx+1], Parser->AllowNumbers)) {
+            continue;
+        }
+        Idx++;
+        if (Found == Record) {
+            *ArgIdx = Idx;
+            ValueStatus = ReturnValue(Argv[Idx], ValueType, Data, RECORD_ENUM(Parser, Record), ValueRetPtr);
+        }
+    }
+    return ValueStatus;
+}
+
+/**
+ * Function: LookupSwitch
+ * 
+ * Finds Arg as a parse did, by name then by prefix
+ **/
+STATIC UINTN LookupSwitch(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Arg)
+{
+    UINTN Row;
+
+    if (Parser->Records) {
+        Row = FindSwitchRecord(Parser, Arg);
+    } else {
+        Row = FindSwitch(Parser->SwTable, Parser->TableSwCount, Arg, Parser->FuncOpt, Parser->Slots, Parser->SlotCount);
+    }
+    if (Row == SW_IDX_NONE && (Parser->FuncOpt & PREFIX_SWITCHES)) {
+        Row = FindSwitchPrefix(Parser, Arg);
+    }
+    return Row;
+}
+
+/**
+ * CmdLineValidateTables()
+ * 
+ **/
+SHELL_STATUS CmdLineValidateTables(IN CONST CHAR16 *ProgName, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus = SHELL_INVALID_PARAMETER;
+    CMDLINE_ERROR LocalError;
+    SWITCH_INDEX_SLOT *Slots = NULL;
+    UINTN SlotCount = 1;
+    UINTN SwCount = 0;
+    CONST CHAR16 *ErrStr;
+    CONST CHAR16 *Name = NULL;
+    BOOLEAN AllowNumbers = HasSignedRow(ParamTable, SwTable);
+    UINTN i;
+
+    if (!Error) {
+        Error = &LocalError;
+    }
+    ClearError(Error);
+
+    // parameters
+    for (i = 0; ParamTable && ParamTable[i].ValueType != VALTYPE_NONE; i++) {
+        ErrStr = CheckRow(ParamTable[i].ValueType, &ParamTable[i].Data, ParamTable[i].ValueRetPtr, FALSE);
+        if (!ErrStr && VALTYPE_IS_VARIADIC(ParamTable[i].ValueType) && ParamTable[i+1].ValueType != VALTYPE_NONE) {
+            ErrStr = L"Parameter: Variadic parameter not last";
+        }
+        if (ErrStr) {
+            ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, ErrStr, i, ParamTable[i].ValueType);
+            return SHELL_INVALID_PARAMETER;
+        }
+    }
+
+    // switches
+    while (SwTable && SwTable[SwCount].SwitchNecessity != NO_SW) {
+        SwCount++;
+    }
+    if (SwCount > MAX_SWITCH_ENTRIES) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, L"Exceeded maximum switch count", SwCount, VALTYPE_NONE);
+        return SHELL_OUT_OF_RESOURCES;
+    }
+    // names are checked for clashes with a name index of the whole table
+    while (SlotCount < (SwCount + 2) * 4) {
+        SlotCount <<= 1;
+    }
+    Slots = AllocateZeroPool(SlotCount * sizeof(SWITCH_INDEX_SLOT));
+    if (!Slots) {
+        Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
+        return SHELL_OUT_OF_RESOURCES;
+    }
+    if ((FuncOpt & NO_HELP) == 0) {
+        AddSwitchIndex(HelpSwStr1, SW_ROW_HELP, Slots, SlotCount);
+        AddSwitchIndex(HelpSwStr2, SW_ROW_HELP, Slots, SlotCount);
+    }
+    if (FuncOpt & FORCE_BREAK) {
+        AddSwitchIndex(BreakSwStr1, SW_ROW_BREAK, Slots, SlotCount);
+        AddSwitchIndex(BreakSwStr2, SW_ROW_BREAK, Slots, SlotCount);
+    }
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwitchNecessity != OPT_SW && SwTable[i].SwitchNecessity != MAN_SW) {
+            ErrStr = L"Switch: Invalid 'SwitchNecessity'";
+            goto Error_exit;
+        }
+        if (!SwTable[i].SwStr1 && !SwTable[i].SwStr2) {
+            ErrStr = L"Switch: No name";
+            goto Error_exit;
+        }
+        ErrStr = CheckRow(SwTable[i].ValueType, &SwTable[i].Data, SwTable[i].ValueRetPtr, TRUE);
+        if (ErrStr) {
+            goto Error_exit;
+        }
+        Name = SwTable[i].SwStr1;
+        ErrStr = CheckSwitchName(SwTable, i, Name, FuncOpt, AllowNumbers, Slots, SlotCount);
+        if (ErrStr) {
+            goto Error_exit;
+        }
+        Name = SwTable[i].SwStr2;
+        ErrStr = CheckSwitchName(SwTable, i, Name, FuncOpt, AllowNumbers, Slots, SlotCount);
+        if (ErrStr) {
+            goto Error_exit;
+        }
+        Name = NULL;
+    }
+    ShellStatus = SHELL_SUCCESS;
+
+Error_exit:
+    if (ShellStatus != SHELL_SUCCESS) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, Name, ErrStr, i, SwTable[i].ValueType);
+    }
+    FreePool(Slots);
+    Slots = NULL;
+
+    // constraints, Row is the constraint
+    for (i = 0; ShellStatus == SHELL_SUCCESS && SwTable && SwTable[SwCount].Data.Constraints && SwTable[SwCount].Data.Constraints[i].Type != NO_CONSTRAINT; i++) {
+        ErrStr = CheckConstraint(SwTable, SwCount, &SwTable[SwCount].Data.Constraints[i], &Name);
+        if (ErrStr) {
+            ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, Name, ErrStr, i, VALTYPE_NONE);
+            ShellStatus = SHELL_INVALID_PARAMETER;
+        }
+    }
+
+    return ShellStatus;
+}
+
+/**
+ * CmdLineFree()
+ * 
+ **/
+VOID CmdLineFree(IN CMDLINE_PARSER *Parser)
+{
+    if (Parser) {
+        if (Parser->HelpText) {
+            FreePool(Parser->HelpText);
+        }
+        FreePool(Parser);
+    }
+}
+
+/**
+ * CmdLineDispatch()
+ * 
+ **/
+SHELL_STATUS CmdLineDispatch(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, IN UINTN Argc, IN CHAR16 **Argv, IN VOID *Context, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus;
+    CMDLINE_ERROR LocalError;
+    CHAR16 *SubProgName;
+    CHAR16 **SubArgv;
+    SUBCMD_TABLE *SubCmd;
+    SWITCH_TABLE *SwTable;
+    UINTN NumParams = 0;
+    UINTN GlobalCount = 0;
+    UINTN CmdIdx;
+    UINTN Row;
+    BOOLEAN AllowNumbers;
+
+    if (!Error) {
+        Error = &LocalError;
+    }
+    ClearError(Error);
+    if (!SubCmdTable || (Argc && !Argv)) {
+        return SHELL_INVALID_PARAMETER;
+    }
+
+    // global switches may come before the name, they are only checked here
+    while (GlobalSwTable && GlobalSwTable[GlobalCount].SwitchNecessity != NO_SW) {
+        GlobalCount++;
+    }
+    AllowNumbers = HasSignedRow(NULL, GlobalSwTable);
+    for (CmdIdx = 1; CmdIdx < Argc && IsSwitchToken(Argv[CmdIdx], AllowNumbers); CmdIdx++) {
+        Row = FindSwitch(GlobalSwTable, GlobalCount, Argv[CmdIdx], FuncOpt, NULL, 0);
+        if (Row == SW_IDX_NONE && (FuncOpt & PREFIX_SWITCHES)) {
+            Row = ScanSwitchPrefix(GlobalSwTable, GlobalCount, FuncOpt, Argv[CmdIdx]);
+            if (Row == SW_IDX_AMBIGUOUS) {
+                AmbiguousSwitchError(ProgName, GlobalSwTable, GlobalCount, FuncOpt, CmdIdx, Argv[CmdIdx], Error);
+                // rows are numbered after the subcommand's, not known yet
+                Error->Row = CMDLINE_NO_ROW;
+                Error->ValueType = VALTYPE_NONE;
+                return SHELL_INVALID_PARAMETER;
+            }
+        }
+        if (Row == SW_IDX_HELP) {
+            ShowCommandHelp(ProgName, SubCmdTable, GlobalSwTable, ProgHelpStr, FuncOpt);
+            Error->Code = CMDLINE_ERR_HELP;
+            Error->ArgIndex = CmdIdx;
+            Error->Arg = Argv[CmdIdx];
+            return SHELL_ABORTED;
+        }
+        if (Row == SW_IDX_NONE) {
+            ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_UNKNOWN_SWITCH, CmdIdx, Argv[CmdIdx], NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+            return SHELL_INVALID_PARAMETER;
+        }
+        // value is the next token unless that is a switch, as NativeParseArgs()
+        if (Row < GlobalCount && GlobalSwTable[Row].ValueType != VALTYPE_NONE && CmdIdx+1 < Argc && !IsSwitchToken(Argv[CmdIdx+1], AllowNumbers)) {
+            CmdIdx++;
+        }
+    }
+    if (CmdIdx >= Argc) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_MISSING_COMMAND, 0, NULL, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+        return SHELL_INVALID_PARAMETER;
+    }
+    SubCmd = FindSubCmd(SubCmdTable, Argv[CmdIdx]);
+    if (!SubCmd) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_UNKNOWN_COMMAND, CmdIdx, Argv[CmdIdx], NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+        return SHELL_INVALID_PARAMETER;
+    }
+
+    // the name is Argv[0] of the subcommand, any switches before it follow
+    SubArgv = &Argv[1];
+    if (CmdIdx > 1) {
+        SubArgv = AllocatePool((Argc-1) * sizeof(CHAR16 *));
+        if (SubArgv) {
+            SubArgv[0] = Argv[CmdIdx];
+            CopyMem(&SubArgv[1], &Argv[1], (CmdIdx-1) * sizeof(CHAR16 *));
+            CopyMem(&SubArgv[CmdIdx], &Argv[CmdIdx+1], (Argc-CmdIdx-1) * sizeof(CHAR16 *));
+        }
+    }
+    // messages and help name the subcommand
+    SubProgName = SubCmdProgName(ProgName, SubCmd->Name);
+    SwTable = NULL;
+    ShellStatus = SHELL_OUT_OF_RESOURCES;
+    if (SubArgv && SubProgName) {
+        ShellStatus = MergeSwitchTables(SubCmd->SwTable, GlobalSwTable, &SwTable);
+    }
+    if (ShellStatus != SHELL_SUCCESS) {
+        Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
+    } else {
+        PhaseBegin(FuncOpt);
+        ShellStatus = NativeParse(Argc-1, SubArgv, SubProgName, SubCmd->ManParamCount, SubCmd->ParamTable, SwTable, SubCmd->HelpStr, FuncOpt, &NumParams, FALSE, NULL, 0, NULL, Error);
+        PhaseFinish(FuncOpt);
+    }
+    if (SwTable && SwTable != SubCmd->SwTable && SwTable != GlobalSwTable) {
+        FreePool(SwTable);
+    }
+    if (SubArgv && SubArgv != &Argv[1]) {
+        FreePool(SubArgv);
+    }
+    if (SubProgName) {
+        FreePool(SubProgName);
+    }
+    // back to an index of Argv, which has the name at CmdIdx
+    if (Error->ArgIndex >= CmdIdx) {
+        Error->ArgIndex++;
+    }
+
+    if (ShellStatus == SHELL_SUCCESS && SubCmd->Handler) {
+        ShellStatus = SubCmd->Handler(Context, NumParams);
+    }
+    return ShellStatus;
+}
+
+/**
+ * CmdLineValidateSubCmds()
+ * 
+ **/
+SHELL_STATUS CmdLineValidateSubCmds(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus = SHELL_SUCCESS;
+    CMDLINE_ERROR LocalError;
+    CHAR16 *SubProgName;
+    SWITCH_TABLE *SwTable;
+    UINTN Count = 0;
+    UINTN i;
+
+    if (!Error) {
+        Error = &LocalError;
+    }
+    ClearError(Error);
+    if (!SubCmdTable) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    while (SubCmdTable[Count].Name) {
+        Count++;
+    }
+    if (SubCmdTable[Count].ManParamCount & SUBCMD_SORTED) {
+        // binary search needs ascending names
+        for (i = 1; i < Count; i++) {
+            if (StriCmp(SubCmdTable[i-1].Name, SubCmdTable[i].Name) >= 0) {
+                ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, SubCmdTable[i].Name, L"Subcommand: Table not sorted", i, VALTYPE_NONE);
+                return SHELL_INVALID_PARAMETER;
+            }
+        }
+    }
+    // each subcommand is checked with the global switches it is parsed with
+    for (i = 0; i < Count; i++) {
+        ShellStatus = MergeSwitchTables(SubCmdTable[i].SwTable, GlobalSwTable, &SwTable);
+        if (ShellStatus != SHELL_SUCCESS) {
+            Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
+            return ShellStatus;
+        }
+        SubProgName = SubCmdProgName(ProgName, SubCmdTable[i].Name);
+        if (SubProgName) {
+            ShellStatus = CmdLineValidateTables(SubProgName, SubCmdTable[i].ParamTable, SwTable, FuncOpt, Error);
+            FreePool(SubProgName);
+        } else {
+            Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
+            ShellStatus = SHELL_OUT_OF_RESOURCES;
+        }
+        if (SwTable != SubCmdTable[i].SwTable && SwTable != GlobalSwTable) {
+            FreePool(SwTable);
+        }
+        if (ShellStatus != SHELL_SUCCESS) {
+            break;
+        }
+    }
+    return ShellStatus;
+}
+
+/**
+ * CmdLineSplitLine()
+ *
+ * Arguments are separated by spaces or tabs, double quotes group text
+ * containing spaces and are removed, '^' makes the following special
+ * character literal and '#' at the start of an argument begins a
+ * comment. Arguments are unescaped in place.
+ **/
+SHELL_STATUS CmdLineSplitLine(IN OUT CHAR16 *Line, OUT CHAR16 **Argv, IN UINTN MaxArgs, OUT UINTN *Argc)
+{
+    CHAR16 *Src = Line;
+    CHAR16 *Dst = Line;
+    BOOLEAN InQuotes;
+
+    *Argc = 0;
+    while (TRUE) {
+        while ((*Src == L' ') || (*Src == L'\t')) {
+            Src++;
+        }
+        if ((*Src == L'\0') || (*Src == L'#')) {
+            break;
+        }
+        if (*Argc >= MaxArgs) {
+            return SHELL_BUFFER_TOO_SMALL;
+        }
+        Argv[(*Argc)++] = Dst;
+
+        InQuotes = FALSE;
+        while ((*Src != L'\0') && (InQuotes || ((*Src != L' ') && (*Src != L'\t')))) {
+            if ((*Src == L'^') && IsEscapable(Src[1])) {
+                *Dst++ = Src[1];
+                Src += 2;
+            } else if (*Src == L'"') {
+                InQuotes = !InQuotes;
+                Src++;
+            } else {
+                *Dst++ = *Src++;
+            }
+        }
+        if (InQuotes) {
+            return SHELL_INVALID_PARAMETER;
+        }
+        // step over separator before terminating, Dst never passes Src
+        if (*Src != L'\0') {
+            Src++;
+        }
+        *Dst++ = L'\0';
+    }
+
+    return SHELL_SUCCESS;
+}
+
+/**
+ * Function: FindSubCmd
+ * 
+ * Lookup options are held in the terminating entry, returns NULL if
+ * not found
+ **/
+STATIC SUBCMD_TABLE *FindSubCmd(IN SUBCMD_TABLE *SubCmdTable, IN CONST CHAR16 *Name)
+{
+    UINTN Count = 0;
+    UINTN Low, High, Mid;
+    INTN Cmp;
+    UINTN i;
+
+    while (SubCmdTable[Count].Name) {
+        Count++;
+    }
+    if ((SubCmdTable[Count].ManParamCount & SUBCMD_SORTED) == 0) {
+        for (i = 0; i < Count; i++) {
+            if (StriCmp(Name, SubCmdTable[i].Name) == 0) {
+                return &SubCmdTable[i];
+            }
+        }
+        return NULL;
+    }
+
+    Low = 0;
+    High = Count;
+    while (Low < High) {
+        Mid = Low + (High - Low) / 2;
+        Cmp = StriCmp(Name, SubCmdTable[Mid].Name);
+        if (Cmp == 0) {
+            return &SubCmdTable[Mid];
+        }
+        if (Cmp < 0) {
+            High = Mid;
+        } else {
+            Low = Mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Function: IsEscapable
+ *
+ * Characters that have a special meaning to the shell
+ **/
+STATIC BOOLEAN IsEscapable(IN CHAR16 Char)
+{
+    switch (Char) {
+    case L'^':
+    case L'"':
+    case L'#':
+    case L'%':
+    case L'|':
+    case L'<':
+    case L'>':
+    case L' ':
+    case L'\t':
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/**
+ * Function: SubCmdProgName
+ * 
+ * Returns "ProgName Name" in pool memory, NULL if out of resources
+ **/
+STATIC CHAR16 *SubCmdProgName(IN CONST CHAR16 *ProgName, IN CONST CHAR16 *Name)
+{
+    UINTN Size = (StrLen(ProgName) + StrLen(Name) + 2) * sizeof(CHAR16);
+    CHAR16 *SubProgName;
+
+    SubProgName = AllocatePool(Size);
+    if (SubProgName) {
+        UnicodeSPrint(SubProgName, Size, L"%s %s", ProgName, Name);
+    }
+    return SubProgName;
+}
+
+/**
+ * Function: MergeSwitchTables
+ * 
+ * Global switch rows follow those of SwTable. Either table is returned
+ * as is if the other is empty, otherwise the merged table is allocated.
+ **/
+STATIC SHELL_STATUS MergeSwitchTables(IN SWITCH_TABLE *SwTable, IN SWITCH_TABLE *GlobalSwTable, OUT SWITCH_TABLE **Merged)
+{
+    UINTN SwCount = 0;
+    UINTN GlobalCount = 0;
+
+    while (SwTable && SwTable[SwCount].SwitchNecessity != NO_SW) {
+        SwCount++;
+    }
+    while (GlobalSwTable && GlobalSwTable[GlobalCount].SwitchNecessity != NO_SW) {
+        GlobalCount++;
+    }
+    if (GlobalCount == 0) {
+        *Merged = SwTable;
+        return SHELL_SUCCESS;
+    }
+    if (SwCount == 0 && !(SwTable && SwTable[0].Data.Constraints)) {
+        *Merged = GlobalSwTable;
+        return SHELL_SUCCESS;
+    }
+    *Merged = AllocatePool((SwCount + GlobalCount + 1) * sizeof(SWITCH_TABLE));
+    if (!*Merged) {
+        return SHELL_OUT_OF_RESOURCES;
+    }
+    CopyMem(*Merged, SwTable, SwCount * sizeof(SWITCH_TABLE));
+    CopyMem(&(*Merged)[SwCount], GlobalSwTable, (GlobalCount + 1) * sizeof(SWITCH_TABLE));
+    if (SwTable[SwCount].Data.Constraints) {
+        // constraints of the subcommand replace the global ones
+        (*Merged)[SwCount + GlobalCount].Data = SwTable[SwCount].Data;
+    }
+    return SHELL_SUCCESS;
+}
+
+/**
+ * Function: NativeStorageSize
+ * 
+ * Working storage of a native parse (switch bitsets then name index),
+ * depends only on the tables
+ **/
+STATIC UINTN NativeStorageSize(IN CMDLINE_PARSER *Parser)
+{
+    return (Parser->Words * 2 * sizeof(UINTN)) + (Parser->SlotCount * sizeof(SWITCH_INDEX_SLOT));
+}
+
+/**
+ * Function: NativeParse
+ * 
+ * Single pass over Argv, each token is resolved directly to its
+ * parameter or switch table row and its value written immediately.
+ * Tokens are classified the same way as ShellCommandLineParseEx(),
+ * with AlwaysAllowNumbers only if a SINT row takes negative numbers,
+ * so results match the shell parser.
+ * Errors are reported in command line order.
+ * If UseArena is set working storage is taken from Arena and no pool
+ * memory is allocated, otherwise it is allocated as required.
+ **/
+STATIC SHELL_STATUS NativeParse(IN UINTN Argc, IN CHAR16 **Argv, IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, IN BOOLEAN UseArena, IN VOID *Arena, IN UINTN ArenaSize, OUT UINTN *ArenaRequired, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus;
+    UINTN StackWords[NATIVE_STACK_WORDS];
+    UINTN *Storage = NULL;
+    CMDLINE_PARSER Parser;
+    UINTN Required;
+
+    ShellStatus = InitParser(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, &Parser, Error);
+    PhaseMark(FuncOpt, CMDLINE_PHASE_TABLES);
+    if (ShellStatus != SHELL_SUCCESS) {
+        return ShellStatus;
+    }
+
+    Required = NativeStorageSize(&Parser);
+    if (UseArena) {
+        if (ArenaRequired) {
+            *ArenaRequired = Required;
+        }
+        if (ArenaSize < Required) {
+            return SHELL_BUFFER_TOO_SMALL;
+        }
+        ASSERT(((UINTN)Arena & (sizeof(UINTN)-1)) == 0);
+        Storage = Arena;
+    } else {
+        // index only built for longer command lines
+        if (Argc <= SW_INDEX_MIN_ARGS) {
+            Required = Parser.Words * 2 * sizeof(UINTN);
+        }
+        if (Required <= sizeof(StackWords)) {
+            Storage = StackWords;
+        } else {
+            Storage = AllocatePool(Required);
+            if (!Storage) {
+                Error->Code = CMDLINE_ERR_OUT_OF_RESOURCES;
+                return SHELL_OUT_OF_RESOURCES;
+            }
+        }
+    }
+    Parser.PresentBits = Storage;
+    Parser.MandatoryBits = Parser.PresentBits + Parser.Words;
+    BuildMandatoryBits(SwTable, Parser.TableSwCount, Parser.MandatoryBits);
+
+    // index switch names of larger tables
+    if (Parser.SlotCount && Argc > SW_INDEX_MIN_ARGS) {
+        Parser.Slots = (SWITCH_INDEX_SLOT *)(Parser.MandatoryBits + Parser.Words);
+        BuildSwitchIndex(SwTable, Parser.TableSwCount, FuncOpt, Parser.Slots, Parser.SlotCount);
+    }
+    PhaseMark(FuncOpt, CMDLINE_PHASE_LIST);
+
+    ShellStatus = NativeParseArgs(&Parser, Argc, Argv, NumParams, Error);
+
+    if (Storage != StackWords && !UseArena) {
+        FreePool(Storage);
+        Storage = NULL;
+    }
+
+    return ShellStatus;
+}
+
+/**
+ * Function: InitParser
+ * 
+ * Counts the tables, no storage is assigned
+ **/
+STATIC SHELL_STATUS InitParser(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT CMDLINE_PARSER *Parser, OUT CMDLINE_ERROR *Error)
+{
+    ZeroMem(Parser, sizeof(CMDLINE_PARSER));
+    Parser->ProgName = ProgName;
+    Parser->ParamTable = ParamTable;
+    Parser->SwTable = SwTable;
+    Parser->ProgHelpStr = ProgHelpStr;
+    Parser->FuncOpt = FuncOpt;
+
+    if (ParamTable) {
+        while (ParamTable[Parser->TableParamCount].ValueType != VALTYPE_NONE) {
+            Parser->TableParamCount++;
+        }
+    }
+    if (SwTable) {
+        while (SwTable[Parser->TableSwCount].SwitchNecessity != NO_SW) {
+            Parser->TableSwCount++;
+        }
+    }
+    if (Parser->TableSwCount > MAX_SWITCH_ENTRIES) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TABLE, 0, NULL, L"Exceeded maximum switch count", Parser->TableSwCount, VALTYPE_NONE);
+        return SHELL_OUT_OF_RESOURCES;
+    }
+    Parser->ManParamCount = ManParamCount > Parser->TableParamCount ? Parser->TableParamCount : ManParamCount;
+    Parser->Variadic = Parser->TableParamCount && VALTYPE_IS_VARIADIC(ParamTable[Parser->TableParamCount-1].ValueType);
+    Parser->AllowNumbers = HasSignedRow(ParamTable, SwTable);
+    if (SwTable && SwTable[Parser->TableSwCount].Data.Constraints && SwTable[Parser->TableSwCount].Data.Constraints[0].Type != NO_CONSTRAINT) {
+        Parser->Constraints = SwTable[Parser->TableSwCount].Data.Constraints;
+    }
+    Parser->Words = SWBITS_WORDS(Parser->TableSwCount);
+    Parser->SlotCount = SwitchIndexSlotCount(SwTable, Parser->TableSwCount, FuncOpt);
+    return SHELL_SUCCESS;
+}
+
+/**
+ * Function: NativeParseArgs
+ * 
+ * Parses Argv (Argv[0] is the program name) using prepared parser
+ **/
+STATIC SHELL_STATUS NativeParseArgs(IN CMDLINE_PARSER *Parser, IN UINTN Argc, IN CHAR16 **Argv, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error)
+{
+    SHELL_STATUS ShellStatus = SHELL_INVALID_PARAMETER;
+    CONST CHAR16 *ProgName = Parser->ProgName;
+    PARAMETER_TABLE *ParamTable = Parser->ParamTable;
+    SWITCH_TABLE *SwTable = Parser->SwTable;
+    UINT16 FuncOpt = Parser->FuncOpt;
+    UINTN *PresentBits = Parser->PresentBits;
+    BOOLEAN BreakPresent = FALSE;
+    UINTN ParamCount = 0;
+    UINTN ArgIdx, Row;
+    SWITCH_RECORD Rec;
+    VALUE_STATUS ValueStatus;
+
+    ZeroMem(PresentBits, Parser->Words * sizeof(UINTN));
+    if (Parser->ValueArgs) {
+        ZeroMem(Parser->ConvertedBits, SWBITS_WORDS(Parser->TableSwCount + Parser->TableParamCount) * sizeof(UINTN));
+    }
+    Parser->Argv = Argv;
+
+    // process command line (ignore program name)
+    for (ArgIdx = 1; ArgIdx < Argc; ArgIdx++) {
+        CONST CHAR16 *Arg = Argv[ArgIdx];
+        CONST CHAR16 *SwString = NULL;
+
+        CMDLINE_WORK(1);
+        if (!IsSwitchToken(Arg, Parser->AllowNumbers)) {
+            // parameter, remaining parameters all go to a variadic last row
+            Row = ParamCount;
+            if (Row >= Parser->TableParamCount) {
+                if (!Parser->Variadic) {
+                    ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TOO_MANY_PARAMS, ArgIdx, Arg, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+                    goto Error_exit;
+                }
+                Row = Parser->TableParamCount - 1;
+            }
+            if (Parser->ValueArgs && (Parser->RecordOnly || !VALTYPE_IS_VARIADIC(ParamTable[Row].ValueType))) {
+                // converted by CmdLineGetValue(), variadic rows record their first value
+                if (Row == ParamCount) {
+                    Parser->ValueArgs[Parser->TableSwCount + Row] = ArgIdx;
+                }
+                ParamCount++;
+                continue;
+            }
+            if (Row == ParamCount && VALTYPE_IS_VARIADIC(ParamTable[Row].ValueType)) {
+                ResetValueCount(ParamTable[Row].ValueType, ParamTable[Row].ValueRetPtr);
+                if (Parser->ValueArgs) {
+                    // converted as each is given
+                    Parser->ValueArgs[Parser->TableSwCount + Row] = 0;
+                }
+            }
+            ValueStatus = ReturnValue(Arg, ParamTable[Row].ValueType, &ParamTable[Row].Data, RECORD_ENUM(Parser, Parser->TableSwCount + Row), ParamTable[Row].ValueRetPtr);
+            if (ValueStatus != VALUE_OK) {
+                ParseError(ProgName, FuncOpt, Error, ValueErrorCode(ValueStatus, FALSE), ArgIdx, Arg, NULL, Row, ParamTable[Row].ValueType);
+                goto Error_exit;
+            }
+            ParamCount++;
+            continue;
+        }
+
+        // switch
+        if (Parser->Records) {
+            Row = FindSwitchRecord(Parser, Arg);
+        } else {
+            Row = FindSwitch(SwTable, Parser->TableSwCount, Arg, FuncOpt, Parser->Slots, Parser->SlotCount);
+        }
+        if (Row == SW_IDX_NONE && (FuncOpt & PREFIX_SWITCHES)) {
+            Row = FindSwitchPrefix(Parser, Arg);
+            if (Row == SW_IDX_AMBIGUOUS) {
+                AmbiguousSwitchError(ProgName, SwTable, Parser->TableSwCount, FuncOpt, ArgIdx, Arg, Error);
+                goto Error_exit;
+            }
+        }
+        if (Row == SW_IDX_NONE) {
+            ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_UNKNOWN_SWITCH, ArgIdx, Arg, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+            goto Error_exit;
+        }
+        if (Row == SW_IDX_HELP) {
+            PhaseMark(FuncOpt, CMDLINE_PHASE_TOKENIZE);
+            if (!Parser->RecordOnly) {
+                ShowParserHelp(Parser);
+            }
+            PhaseMark(FuncOpt, CMDLINE_PHASE_HELP);
+            Error->Code = CMDLINE_ERR_HELP;
+            Error->ArgIndex = ArgIdx;
+            Error->Arg = Arg;
+            ShellStatus = SHELL_ABORTED;
+            goto Error_exit;
+        }
+        if (Row == SW_IDX_BREAK) {
+            BreakPresent = TRUE;
+            continue;
+        }
+        if (Parser->Records) {
+            Rec = Parser->Records[Row];
+        } else {
+            Rec.ValueType = (UINT8)SwTable[Row].ValueType;
+            Rec.Flags = SwitchRecordFlags(&SwTable[Row]);
+        }
+        if (SWBIT_TEST(PresentBits, Row)) {
+            // list switches may be repeated
+            if ((Rec.Flags & SW_REC_LIST) == 0) {
+                ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_DUPLICATE_SWITCH, ArgIdx, Arg, NULL, Row, Rec.ValueType);
+                goto Error_exit;
+            }
+        } else {
+            SWBIT_SET(PresentBits, Row);
+            if ((Rec.Flags & SW_REC_LIST) && !Parser->RecordOnly) {
+                SwTable[Row].ValueRetPtr.pList->Count = 0;
+            }
+            if (Parser->ValueArgs) {
+                Parser->ValueArgs[Row] = 0;
+            }
+        }
+        if (Rec.ValueType == VALTYPE_NONE) {
+            if (Parser->RecordOnly) {
+                // presence is the value, see CmdLineResultGetValue()
+                continue;
+            }
+            if (Rec.Flags & SW_REC_FLAG_VALUE) {
+                // flag with value
+                *(SwTable[Row].ValueRetPtr.pUintn) = SwTable[Row].Data.FlagValue;
+            } else {
+                // true/false flag 
+                *(SwTable[Row].ValueRetPtr.pBoolean) = TRUE;
+            }
+            continue;
+        }
+        // value is the next token unless that is a switch
+        if (ArgIdx+1 < Argc && !IsSwitchToken(Argv[ArgIdx+1], Parser->AllowNumbers)) {
+            SwString = Argv[++ArgIdx];
+        }
+        if (!SwString) {
+            if (Rec.Flags & SW_REC_MAN_VALUE) {
+                ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_SWITCH_NO_VALUE, ArgIdx, Arg, NULL, Row, Rec.ValueType);
+                goto Error_exit;
+            }
+            continue;
+        }
+        if (Parser->RecordOnly) {
+            // lists record their first value, the rest are found again
+            if (Parser->ValueArgs[Row] == 0) {
+                Parser->ValueArgs[Row] = ArgIdx;
+            }
+            continue;
+        }
+        if (Parser->ValueArgs && (Rec.Flags & SW_REC_LIST) == 0) {
+            // converted by CmdLineGetValue(), lists are converted as each is given
+            Parser->ValueArgs[Row] = ArgIdx;
+            continue;
+        }
+        ValueStatus = ReturnValue(SwString, SwTable[Row].ValueType, &SwTable[Row].Data, RECORD_ENUM(Parser, Row), SwTable[Row].ValueRetPtr);
+        if (ValueStatus != VALUE_OK) {
+            ParseError(ProgName, FuncOpt, Error, ValueErrorCode(ValueStatus, TRUE), ArgIdx-1, Arg, SwString, Row, SwTable[Row].ValueType);
+            goto Error_exit;
+        }
+    }
+
+    PhaseMark(FuncOpt, CMDLINE_PHASE_TOKENIZE);
+
+    // check parameter count
+    if (ParamCount < Parser->ManParamCount) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_TOO_FEW_PARAMS, 0, NULL, NULL, CMDLINE_NO_ROW, VALTYPE_NONE);
+        goto Error_exit;
+    }
+
+    // check mandatory switches
+    Row = FindMissingSwitch(PresentBits, Parser->MandatoryBits, Parser->Words);
+    PhaseMark(FuncOpt, CMDLINE_PHASE_MANDATORY);
+    if (Row != SW_IDX_NONE) {
+        ParseError(ProgName, FuncOpt, Error, CMDLINE_ERR_MISSING_SWITCH, 0, SwTable[Row].SwStr1 ? SwTable[Row].SwStr1 : SwTable[Row].SwStr2, NULL, Row, SwTable[Row].ValueType);
+        goto Error_exit;
+    }
+
+    // check constraints, a few word operations each if compiled
+    if (Parser->Constraints) {
+        Row = FindFailedConstraint(SwTable, Parser->TableSwCount, Parser->Constraints, Parser->ConstraintRecords, PresentBits, Parser->Words);
+        PhaseMark(FuncOpt, CMDLINE_PHASE_MANDATORY);
+        if (Row != CMDLINE_NO_ROW) {
+            ConstraintError(ProgName, FuncOpt, Error, SwTable, Parser->TableSwCount, &Parser->Constraints[Row], PresentBits);
+            goto Error_exit;
+        }
+    }
+    ShellStatus = SHELL_SUCCESS;
+
+Error_exit:
+    if ((FuncOpt & FORCE_BREAK) && !Parser->RecordOnly) {
+        ShellSetPageBreakMode(BreakPresent);
+    }
+    if (NumParams) {
+        *NumParams = ParamCount;
+    }
+    Parser->ParamCount = ParamCount;
+
+    return ShellStatus;
+}
+
+/**
+ * Function: IsSwitchToken
+ * 
+ * Same rule as ShellLib, with AllowNumbers (AlwaysAllowNumbers)
+ * negative numbers are not switches
+ **/
+STATIC BOOLEAN IsSwitchToken(IN CONST CHAR16 *Arg, IN BOOLEAN AllowNumbers)
+{
+    if (Arg[0] != L'-' && Arg[0] != L'/' && Arg[0] != L'+') {
+        return FALSE;
+    }
+    return (AllowNumbers && InternalIsDecimalDigitCharacter(Arg[1])) ? FALSE : TRUE;
+}
+
+/**
+ * Function: HasSignedRow
+ * 
+ * Either table (may be NULL) has a SINT row, ShellParse() then sets
+ * AlwaysAllowNumbers so every parser does the same
+ **/
+STATIC BOOLEAN HasSignedRow(IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable)
+{
+    UINTN i;
+
+    for (i = 0; ParamTable && ParamTable[i].ValueType != VALTYPE_NONE; i++) {
+        if (ParamTable[i].ValueType == VALTYPE_SIGNED) {
+            return TRUE;
+        }
+    }
+    for (i = 0; SwTable && SwTable[i].SwitchNecessity != NO_SW; i++) {
+        if (SwTable[i].ValueType == VALTYPE_SIGNED) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Function: FindSwitch
+ * 
+ * Uses the name index if one was built, otherwise a linear search
+ **/
+STATIC UINTN FindSwitch(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN CONST CHAR16 *Arg, IN UINT16 FuncOpt, IN SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount)
+{
+    UINTN i;
+
+    if (Slots) {
+        UINT32 Hash = HashSwitchName(Arg);
+        for (i = Hash & (SlotCount-1); Slots[i].Hash; i = (i+1) & (SlotCount-1)) {
+            CMDLINE_WORK(1);
+            if (Slots[i].Hash != Hash) {
+                continue;
+            }
+            switch (Slots[i].Row) {
+            case SW_ROW_HELP:
+                if (StriCmp(Arg, HelpSwStr1) == 0 || StriCmp(Arg, HelpSwStr2) == 0) {
+                    return SW_IDX_HELP;
+                }
+                break;
+            case SW_ROW_BREAK:
+                if (StriCmp(Arg, BreakSwStr1) == 0 || StriCmp(Arg, BreakSwStr2) == 0) {
+                    return SW_IDX_BREAK;
+                }
+                break;
+            default:
+                if ((SwTable[Slots[i].Row].SwStr1 && StriCmp(Arg, SwTable[Slots[i].Row].SwStr1) == 0) ||
+                    (SwTable[Slots[i].Row].SwStr2 && StriCmp(Arg, SwTable[Slots[i].Row].SwStr2) == 0)) {
+                    return Slots[i].Row;
+                }
+                break;
+            }
+        }
+        return SW_IDX_NONE;
+    }
+
+    for (i = 0; i < SwCount; i++) {
+        CMDLINE_WORK(1);
+        if ((SwTable[i].SwStr1 && StriCmp(Arg, SwTable[i].SwStr1) == 0) ||
+            (SwTable[i].SwStr2 && StriCmp(Arg, SwTable[i].SwStr2) == 0)) {
+            return i;
+        }
+    }
+    if ((FuncOpt & NO_HELP) == 0) {
+        if (StriCmp(Arg, HelpSwStr1) == 0 || StriCmp(Arg, HelpSwStr2) == 0) {
+            return SW_IDX_HELP;
+        }
+    }
+    if (FuncOpt & FORCE_BREAK) {
+        if (StriCmp(Arg, BreakSwStr1) == 0 || StriCmp(Arg, BreakSwStr2) == 0) {
+            return SW_IDX_BREAK;
+        }
+    }
+    return SW_IDX_NONE;
+}
+
+/**
+ * Function: HashSwitchName
+ * 
+ * FNV-1a of the upper cased name, never returns 0 (empty slot)
+ **/
+STATIC UINT32 HashSwitchName(IN CONST CHAR16 *Name)
+{
+    UINT32 Hash = 2166136261u;
+
+    while (*Name != L'\0') {
+        Hash = (Hash ^ FOLD_CHAR(*Name)) * 16777619u;
+        Name++;
+    }
+    return Hash ? Hash : 1;
+}
+
+/**
+ * Function: SwitchIndexSlotCount
+ * 
+ * Returns the number of index slots required for the table (at least
+ * twice the number of names), or 0 if the table is too small to
+ * benefit from an index
+ **/
+STATIC UINTN SwitchIndexSlotCount(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt)
+{
+    UINTN NameCount = 0;
+    UINTN SlotCount = 1;
+    UINTN i;
+
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwStr1) NameCount++;
+        if (SwTable[i].SwStr2) NameCount++;
+    }
+    if (FuncOpt & FORCE_BREAK) {
+        NameCount += 2;
+    }
+    if ((FuncOpt & NO_HELP) == 0) {
+        NameCount += 2;
+    }
+    if (NameCount < SW_INDEX_MIN_NAMES || SwCount >= SW_ROW_BREAK) {
+        return 0;
+    }
+    while (SlotCount < NameCount*2) {
+        SlotCount <<= 1;
+    }
+    return SlotCount;
+}
+
+/**
+ * Function: BuildSwitchIndex
+ * 
+ **/
+STATIC VOID BuildSwitchIndex(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, OUT SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount)
+{
+    UINTN i;
+
+    ZeroMem(Slots, SlotCount * sizeof(SWITCH_INDEX_SLOT));
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwStr1) {
+            AddSwitchIndex(SwTable[i].SwStr1, (UINT16)i, Slots, SlotCount);
+        }
+        if (SwTable[i].SwStr2) {
+            AddSwitchIndex(SwTable[i].SwStr2, (UINT16)i, Slots, SlotCount);
+        }
+    }
+    if ((FuncOpt & NO_HELP) == 0) {
+        AddSwitchIndex(HelpSwStr1, SW_ROW_HELP, Slots, SlotCount);
+        AddSwitchIndex(HelpSwStr2, SW_ROW_HELP, Slots, SlotCount);
+    }
+    if (FuncOpt & FORCE_BREAK) {
+        AddSwitchIndex(BreakSwStr1, SW_ROW_BREAK, Slots, SlotCount);
+        AddSwitchIndex(BreakSwStr2, SW_ROW_BREAK, Slots, SlotCount);
+    }
+}
+
+/**
+ * Function: AddSwitchIndex
+ * 
+ **/
+STATIC VOID AddSwitchIndex(IN CONST CHAR16 *Name, IN UINT16 Row, IN OUT SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount)
+{
+    UINT32 Hash = HashSwitchName(Name);
+    UINTN i = Hash & (SlotCount-1);
+
+    while (Slots[i].Hash) {
+        i = (i+1) & (SlotCount-1);
+    }
+    Slots[i].Hash = Hash;
+    Slots[i].Row = Row;
+}
+
+/**
+ * Function: SwitchPoolSize
+ * 
+ * Characters needed to pool the switch names, including terminators
+ **/
+STATIC UINTN SwitchPoolSize(IN SWITCH_TABLE *SwTable, IN UINTN SwCount)
+{
+    UINTN Size = 0;
+    UINTN i;
+
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwStr1) {
+            Size += StrLen(SwTable[i].SwStr1) + 1;
+        }
+        if (SwTable[i].SwStr2) {
+            Size += StrLen(SwTable[i].SwStr2) + 1;
+        }
+    }
+    return Size;
+}
+
+/**
+ * Function: BuildSwitchRecords
+ * 
+ * NamePool must hold SwitchPoolSize() characters, which must be less
+ * than SW_NO_NAME
+ **/
+STATIC VOID BuildSwitchRecords(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, OUT SWITCH_RECORD *Records, OUT CHAR16 *NamePool)
+{
+    UINTN Offset = 0;
+    UINTN Len;
+    UINTN i;
+
+    for (i = 0; i < SwCount; i++) {
+        Records[i].Name1 = SW_NO_NAME;
+        Records[i].Name2 = SW_NO_NAME;
+        if (SwTable[i].SwStr1) {
+            Len = StrLen(SwTable[i].SwStr1) + 1;
+            CopyMem(&NamePool[Offset], SwTable[i].SwStr1, Len * sizeof(CHAR16));
+            Records[i].Name1 = (UINT16)Offset;
+            Offset += Len;
+        }
+        if (SwTable[i].SwStr2) {
+            Len = StrLen(SwTable[i].SwStr2) + 1;
+            CopyMem(&NamePool[Offset], SwTable[i].SwStr2, Len * sizeof(CHAR16));
+            Records[i].Name2 = (UINT16)Offset;
+            Offset += Len;
+        }
+        Records[i].ValueType = (UINT8)SwTable[i].ValueType;
+        Records[i].Flags = SwitchRecordFlags(&SwTable[i]);
+        Records[i].Unused = 0;
+    }
+}
+
+/**
+ * Function: SwitchRecordFlags
+ * 
+ **/
+STATIC UINT8 SwitchRecordFlags(IN SWITCH_TABLE *Sw)
+{
+    UINT8 Flags = 0;
+
+    if (Sw->ValueNecessity == MAN_VALUE) {
+        Flags |= SW_REC_MAN_VALUE;
+    }
+    if (Sw->ValueType == VALTYPE_NONE && Sw->Data.FlagValue) {
+        Flags |= SW_REC_FLAG_VALUE;
+    }
+    if (VALTYPE_IS_LIST(Sw->ValueType)) {
+        Flags |= SW_REC_LIST;
+    }
+    return Flags;
+}
+
+/**
+ * Function: FindSwitchRecord
+ * 
+ * As FindSwitch() but compares names from the pool of a compiled parser
+ **/
+STATIC UINTN FindSwitchRecord(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Arg)
+{
+    SWITCH_RECORD *Records = Parser->Records;
+    CONST CHAR16 *Pool = Parser->NamePool;
+    SWITCH_INDEX_SLOT *Slots = Parser->Slots;
+    UINTN Row;
+    UINTN i;
+
+    if (Slots) {
+        UINT32 Hash = HashSwitchName(Arg);
+        for (i = Hash & (Parser->SlotCount-1); Slots[i].Hash; i = (i+1) & (Parser->SlotCount-1)) {
+            if (Slots[i].Hash != Hash) {
+                continue;
+            }
+            Row = Slots[i].Row;
+            if (Row >= SW_ROW_BREAK) {
+                // help or break
+                Row = FindSwitch(NULL, 0, Arg, Parser->FuncOpt, NULL, 0);
+                if (Row != SW_IDX_NONE) {
+                    return Row;
+                }
+                continue;
+            }
+            if ((Records[Row].Name1 != SW_NO_NAME && StriCmp(Arg, &Pool[Records[Row].Name1]) == 0) ||
+                (Records[Row].Name2 != SW_NO_NAME && StriCmp(Arg, &Pool[Records[Row].Name2]) == 0)) {
+                return Row;
+            }
+        }
+        return SW_IDX_NONE;
+    }
+
+    for (Row = 0; Row < Parser->TableSwCount; Row++) {
+        if ((Records[Row].Name1 != SW_NO_NAME && StriCmp(Arg, &Pool[Records[Row].Name1]) == 0) ||
+            (Records[Row].Name2 != SW_NO_NAME && StriCmp(Arg, &Pool[Records[Row].Name2]) == 0)) {
+            return Row;
+        }
+    }
+    return FindSwitch(NULL, 0, Arg, Parser->FuncOpt, NULL, 0);
+}
+
+/**
+ * Function: BuildPrefixIndex
+ * 
+ * Heap sorts the rows that have a long name into Rows (at least
+ * SW_PREFIX_SIZE() bytes), returns the number of rows
+ **/
+STATIC UINTN BuildPrefixIndex(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, OUT UINT16 *Rows)
+{
+    UINTN Count = 0;
+    UINT16 Row;
+    UINTN i;
+
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwStr2) {
+            Rows[Count++] = (UINT16)i;
+        }
+    }
+    if ((FuncOpt & NO_HELP) == 0) {
+        Rows[Count++] = SW_ROW_HELP;
+    }
+    if (FuncOpt & FORCE_BREAK) {
+        Rows[Count++] = SW_ROW_BREAK;
+    }
+
+    for (i = Count / 2; i > 0; i--) {
+        SiftPrefixRow(SwTable, Rows, i-1, Count);
+    }
+    for (i = Count; i > 1; i--) {
+        Row = Rows[0];
+        Rows[0] = Rows[i-1];
+        Rows[i-1] = Row;
+        SiftPrefixRow(SwTable, Rows, 0, i-1);
+    }
+    return Count;
+}
+
+/**
+ * Function: SiftPrefixRow
+ * 
+ **/
+STATIC VOID SiftPrefixRow(IN SWITCH_TABLE *SwTable, IN OUT UINT16 *Rows, IN UINTN Root, IN UINTN Count)
+{
+    UINTN Child;
+    UINT16 Row;
+
+    for (Child = Root*2 + 1; Child < Count; Child = Root*2 + 1) {
+        if (Child+1 < Count && StriCmp(PrefixName(SwTable, Rows[Child]), PrefixName(SwTable, Rows[Child+1])) < 0) {
+            Child++;
+        }
+        if (StriCmp(PrefixName(SwTable, Rows[Root]), PrefixName(SwTable, Rows[Child])) >= 0) {
+            return;
+        }
+        Row = Rows[Root];
+        Rows[Root] = Rows[Child];
+        Rows[Child] = Row;
+        Root = Child;
+    }
+}
+
+/**
+ * Function: PrefixName
+ * 
+ **/
+STATIC CONST CHAR16 *PrefixName(IN SWITCH_TABLE *SwTable, IN UINT16 Row)
+{
+    switch (Row) {
+    case SW_ROW_HELP:
+        return HelpSwStr2;
+    case SW_ROW_BREAK:
+        return BreakSwStr2;
+    default:
+        return SwTable[Row].SwStr2;
+    }
+}
+
+/**
+ * Function: FindSwitchPrefix
+ * 
+ * Returns the row of the only long name starting with Arg,
+ * SW_IDX_AMBIGUOUS if more than one or SW_IDX_NONE. Names starting
+ * with Arg are adjacent in the long name order of a compiled parser,
+ * a single parse scans the table instead as sorting it would cost more
+ * than the one lookup it serves. A bare switch character is not a
+ * prefix.
+ **/
+STATIC UINTN FindSwitchPrefix(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Arg)
+{
+    UINT16 *Rows = Parser->PrefixRows;
+    UINTN Count = Parser->PrefixCount;
+    UINTN Low = 0;
+    UINTN High = Count;
+
+    if (!Rows) {
+        return ScanSwitchPrefix(Parser->SwTable, Parser->TableSwCount, Parser->FuncOpt, Arg);
+    }
+    if (Arg[0] == L'\0' || Arg[1] == L'\0') {
+        return SW_IDX_NONE;
+    }
+
+    // find first name not less than Arg
+    while (Low < High) {
+        UINTN Mid = Low + (High - Low) / 2;
+        CMDLINE_WORK(1);
+        if (StriCmp(PrefixName(Parser->SwTable, Rows[Mid]), Arg) < 0) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
+    }
+    if (Low >= Count || !StriPrefix(Arg, PrefixName(Parser->SwTable, Rows[Low]))) {
+        return SW_IDX_NONE;
+    }
+    if (Low+1 < Count && StriPrefix(Arg, PrefixName(Parser->SwTable, Rows[Low+1]))) {
+        return SW_IDX_AMBIGUOUS;
+    }
+    switch (Rows[Low]) {
+    case SW_ROW_HELP:
+        return SW_IDX_HELP;
+    case SW_ROW_BREAK:
+        return SW_IDX_BREAK;
+    default:
+        return Rows[Low];
+    }
+}
+
+/**
+ * Function: ScanSwitchPrefix
+ * 
+ * As FindSwitchPrefix() with one pass over the long names of the table
+ * then help and break
+ **/
+STATIC UINTN ScanSwitchPrefix(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, IN CONST CHAR16 *Arg)
+{
+    UINTN Row = SW_IDX_NONE;
+    UINTN i;
+
+    if (Arg[0] == L'\0' || Arg[1] == L'\0') {
+        return SW_IDX_NONE;
+    }
+    for (i = 0; i < SwCount; i++) {
+        CMDLINE_WORK(1);
+        if (SwTable[i].SwStr2 && StriPrefix(Arg, SwTable[i].SwStr2)) {
+            if (Row != SW_IDX_NONE) {
+                return SW_IDX_AMBIGUOUS;
+            }
+            Row = i;
+        }
+    }
+    if ((FuncOpt & NO_HELP) == 0 && StriPrefix(Arg, HelpSwStr2)) {
+        if (Row != SW_IDX_NONE) {
+            return SW_IDX_AMBIGUOUS;
+        }
+        Row = SW_IDX_HELP;
+    }
+    if ((FuncOpt & FORCE_BREAK) && StriPrefix(Arg, BreakSwStr2)) {
+        if (Row != SW_IDX_NONE) {
+            return SW_IDX_AMBIGUOUS;
+        }
+        Row = SW_IDX_BREAK;
+    }
+    return Row;
+}
+
+/**
+ * Function: BuildMandatoryBits
+ * 
+ **/
+STATIC VOID BuildMandatoryBits(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, OUT UINTN *MandatoryBits)
+{
+    UINTN i;
+
+    ZeroMem(MandatoryBits, SWBITS_WORDS(SwCount) * sizeof(UINTN));
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwitchNecessity == MAN_SW) {
+            SWBIT_SET(MandatoryBits, i);
+        }
+    }
+}
+
+/**
+ * Function: FindMissingSwitch
+ * 
+ * Returns first mandatory switch row not present, or SW_IDX_NONE
+ **/
+STATIC UINTN FindMissingSwitch(IN CONST UINTN *PresentBits, IN CONST UINTN *MandatoryBits, IN UINTN Words)
+{
+    UINTN w;
+
+    for (w = 0; w < Words; w++) {
+        UINTN Missing = MandatoryBits[w] & ~PresentBits[w];
+        if (Missing) {
+            return (w * SWBITS_PER_WORD) + (UINTN)LowBitSet64(Missing);
+        }
+    }
+    return SW_IDX_NONE;
+}
+
+/**
+ * Function: CheckConstraint
+ * 
+ **/
+STATIC CONST CHAR16 *CheckConstraint(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraint, OUT CONST CHAR16 **Name)
+{
+    UINTN n;
+
+    *Name = NULL;
+    if (Constraint->Type != ONE_OF_SW && Constraint->Type != EXCLUSIVE_SW && Constraint->Type != ANY_OF_SW && Constraint->Type != REQUIRES_SW) {
+        return L"Constraint: Invalid 'Type'";
+    }
+    for (n = 0; n < CONSTRAINT_MAX_NAMES && Constraint->Names[n]; n++) {
+        if (FindSwitch(SwTable, SwCount, Constraint->Names[n], NO_HELP, NULL, 0) >= SwCount) {
+            *Name = Constraint->Names[n];
+            return L"Constraint: Unknown switch";
+        }
+    }
+    if (n < 2) {
+        return L"Constraint: Too few switches";
+    }
+    if (Constraint->Names[n]) {
+        return L"Constraint: Too many switches";
+    }
+    return NULL;
+}
+
+/**
+ * Function: BuildConstraintRecords
+ * 
+ * Each record is the row of the first switch then a bitset of the
+ * switches tested, see CONSTRAINT_RECORD_WORDS
+ **/
+STATIC VOID BuildConstraintRecords(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraints, IN UINTN Words, OUT UINTN *Records)
+{
+    UINTN i, n;
+
+    for (i = 0; Constraints[i].Type != NO_CONSTRAINT; i++) {
+        ZeroMem(Records, CONSTRAINT_RECORD_WORDS(Words) * sizeof(UINTN));
+        Records[0] = FindSwitch(SwTable, SwCount, Constraints[i].Names[0], NO_HELP, NULL, 0);
+        for (n = (Constraints[i].Type == REQUIRES_SW) ? 1 : 0; n < CONSTRAINT_MAX_NAMES && Constraints[i].Names[n]; n++) {
+            SWBIT_SET(Records + 1, FindSwitch(SwTable, SwCount, Constraints[i].Names[n], NO_HELP, NULL, 0));
+        }
+        Records += CONSTRAINT_RECORD_WORDS(Words);
+    }
+}
+
+/**
+ * Function: FindFailedConstraint
+ * 
+ * Returns index of the first constraint not met, CMDLINE_NO_ROW if all
+ * are. Uses the compiled records if given, otherwise the switch names.
+ **/
+STATIC UINTN FindFailedConstraint(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraints, IN CONST UINTN *Records, IN CONST UINTN *PresentBits, IN UINTN Words)
+{
+    CMDLINE_ERROR_CODE Code;
+    UINTN Row1, Row2;
+    UINTN i;
+
+    for (i = 0; Constraints && Constraints[i].Type != NO_CONSTRAINT; i++) {
+        if (Records) {
+            if (!ConstraintRecordMet(Constraints[i].Type, Records + (i * CONSTRAINT_RECORD_WORDS(Words)), PresentBits, Words)) {
+                return i;
+            }
+        } else if (!ConstraintMet(SwTable, SwCount, &Constraints[i], PresentBits, &Code, &Row1, &Row2)) {
+            return i;
+        }
+    }
+    return CMDLINE_NO_ROW;
+}
+
+/**
+ * Function: ConstraintRecordMet
+ * 
+ **/
+STATIC BOOLEAN ConstraintRecordMet(IN CONSTRAINT_TYPE Type, IN CONST UINTN *Record, IN CONST UINTN *PresentBits, IN UINTN Words)
+{
+    CONST UINTN *Mask = Record + 1;
+    UINTN Hits = 0;
+    UINTN w;
+
+    if (Type == REQUIRES_SW) {
+        if (!SWBIT_TEST(PresentBits, Record[0])) {
+            return TRUE;
+        }
+        for (w = 0; w < Words; w++) {
+            if ((PresentBits[w] & Mask[w]) != Mask[w]) {
+                return FALSE;
+            }
+        }
+        return TRUE;
+    }
+    // count present switches of the group, only 0, 1 or more matters
+    for (w = 0; w < Words; w++) {
+        UINTN Bits = PresentBits[w] & Mask[w];
+        if (Bits) {
+            Hits += (Bits & (Bits - 1)) ? 2 : 1;
+        }
+    }
+    switch (Type) {
+    case ONE_OF_SW:
+        return Hits == 1;
+    case EXCLUSIVE_SW:
+        return Hits <= 1;
+    default:
+        return Hits != 0;
+    }
+}
+
+/**
+ * Function: ConstraintMet
+ * 
+ * Evaluates constraint by switch name. If not met returns the error
+ * code and the two switch rows it is reported with.
+ **/
+STATIC BOOLEAN ConstraintMet(IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraint, IN CONST UINTN *PresentBits, OUT CMDLINE_ERROR_CODE *Code, OUT UINTN *Row1, OUT UINTN *Row2)
+{
+    UINTN Lead = SW_IDX_NONE;
+    UINTN First = SW_IDX_NONE;
+    UINTN Second = SW_IDX_NONE;
+    UINTN Missing = SW_IDX_NONE;
+    UINTN Row = SW_IDX_NONE;
+    UINTN n;
+
+    for (n = 0; n < CONSTRAINT_MAX_NAMES && Constraint->Names[n]; n++) {
+        Row = FindSwitch(SwTable, SwCount, Constraint->Names[n], NO_HELP, NULL, 0);
+        if (n == 0) {
+            Lead = Row;
+        }
+        if (SWBIT_TEST(PresentBits, Row)) {
+            // both names of a row count once, as in the compiled bitset
+            if (First == SW_IDX_NONE) {
+                First = Row;
+            } else if (Second == SW_IDX_NONE && Row != First) {
+                Second = Row;
+            }
+        } else if (Missing == SW_IDX_NONE) {
+            Missing = Row;
+        }
+    }
+    switch (Constraint->Type) {
+    case REQUIRES_SW:
+        *Code = CMDLINE_ERR_SWITCH_REQUIRES;
+        *Row1 = Lead;
+        *Row2 = Missing;
+        return !SWBIT_TEST(PresentBits, Lead) || Missing == SW_IDX_NONE;
+    case ONE_OF_SW:
+    case EXCLUSIVE_SW:
+        if (Second != SW_IDX_NONE) {
+            *Code = CMDLINE_ERR_SWITCH_CONFLICT;
+            *Row1 = First;
+            *Row2 = Second;
+            return FALSE;
+        }
+        break;
+    default:
+        break;
+    }
+    if (First == SW_IDX_NONE && Constraint->Type != EXCLUSIVE_SW) {
+        *Code = CMDLINE_ERR_MISSING_GROUP;
+        *Row1 = Lead;
+        *Row2 = Row;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Function: ConstraintError
+ * 
+ * Switches are reported by their table names, as missing switches are
+ **/
+STATIC VOID ConstraintError(IN CONST CHAR16 *ProgName, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error, IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN SWITCH_CONSTRAINT *Constraint, IN CONST UINTN *PresentBits)
+{
+    CMDLINE_ERROR_CODE Code = CMDLINE_ERR_NONE;
+    UINTN Row1 = 0;
+    UINTN Row2 = 0;
+
+    ConstraintMet(SwTable, SwCount, Constraint, PresentBits, &Code, &Row1, &Row2);
+    ParseError(ProgName, FuncOpt, Error, Code, 0, SwTable[Row1].SwStr1 ? SwTable[Row1].SwStr1 : SwTable[Row1].SwStr2,
+               SwTable[Row2].SwStr1 ? SwTable[Row2].SwStr1 : SwTable[Row2].SwStr2, Row1, SwTable[Row1].ValueType);
+}
+
+/**
+ * Function: ReturnValue
+ * 
+ * EnumIndex is the compiled lookup of an enum row, NULL if not compiled
+ **/
+STATIC VALUE_STATUS ReturnValue(IN CONST CHAR16 *String, IN VALUE_TYPE ValueType, IN DATA *Data, IN ENUM_INDEX *EnumIndex, OUT VALUE_RET_PTR ValueRetPtr)
+{
+    VALUE_STATUS Status;
+    UINT64 Value;
+    UINTN EnumValue;
+    BOOLEAN Negative;
+    
+    if (!ValueRetPtr.pVoid) {
+        return VALUE_INVALID;
+    }
+
+    CMDLINE_WORK(1);
+    switch (ValueType) {
+    case VALTYPE_STRING:
+        CMDLINE_WORK(StrnLenS(String, Data->MaxStrSize));
+        StrnCpyS(ValueRetPtr.pChar16, Data->MaxStrSize, String, Data->MaxStrSize-1);
+        break;
+    case VALTYPE_DECIMAL:
+    case VALTYPE_HEXIDECIMAL:
+    case VALTYPE_INTEGER:
+        Status = StrToNumber(String, StrLen(String), ValueType == VALTYPE_DECIMAL ? 10 : ValueType == VALTYPE_HEXIDECIMAL ? 16 : 0, MAX_UINTN, &Value, NULL, NULL);
+        if (Status != VALUE_OK) {
+            return Status;
+        }
+        *ValueRetPtr.pUintn = (UINTN)Value;
+        break;
+    case VALTYPE_DEC64:
+    case VALTYPE_HEX64:
+    case VALTYPE_INT64:
+        Status = StrToNumber(String, StrLen(String), ValueType == VALTYPE_DEC64 ? 10 : ValueType == VALTYPE_HEX64 ? 16 : 0, MAX_UINT64, &Value, NULL, NULL);
+        if (Status != VALUE_OK) {
+            return Status;
+        }
+        *ValueRetPtr.pUint64 = Value;
+        break;
+    case VALTYPE_SIGNED:
+        Status = StrToNumber(String, StrLen(String), 0, MAX_INTN, &Value, &Negative, NULL);
+        if (Status != VALUE_OK) {
+            return Status;
+        }
+        *ValueRetPtr.pIntn = Negative ? (INTN)(0 - (UINTN)Value) : (INTN)Value;
+        break;
+    case VALTYPE_ENUM:
+        if(GetEnumVal(Data->EnumStrArray, EnumIndex, String, &EnumValue)) {
+            *ValueRetPtr.pEnum = (unsigned int)EnumValue;
+        } else {
+            return VALUE_INVALID;
+        }
+        break;
+    case VALTYPE_DECLIST:
+    case VALTYPE_HEXLIST:
+    case VALTYPE_INTLIST:
+        return AppendValueList(String, ValueType == VALTYPE_DECLIST ? 10 : ValueType == VALTYPE_HEXLIST ? 16 : 0, ValueRetPtr.pList);
+    case VALTYPE_HEXBLOB:
+        return DecodeHexBlob(String, ValueRetPtr.pBlob);
+    case VALTYPE_STRVIEW:
+        ValueRetPtr.pView->Str = String;
+        ValueRetPtr.pView->Length = StrLen(String);
+        break;
+    case VALTYPE_CALLBACK:
+        if (ValueRetPtr.pCallback->Handler(ValueRetPtr.pCallback->Context, ValueRetPtr.pCallback->Count, String) != SHELL_SUCCESS) {
+            return VALUE_INVALID;
+        }
+        ValueRetPtr.pCallback->Count++;
+        break;
+    default:
+        return VALUE_INVALID;
+    }
+    
+    return VALUE_OK;
+}
+
+/**
+ * Function: ResetValueCount
+ * 
+ * Empties a list or callback before its first value
+ **/
+STATIC VOID ResetValueCount(IN VALUE_TYPE ValueType, OUT VALUE_RET_PTR ValueRetPtr)
+{
+    if (VALTYPE_IS_LIST(ValueType)) {
+        ValueRetPtr.pList->Count = 0;
+    } else if (ValueType == VALTYPE_CALLBACK) {
+        ValueRetPtr.pCallback->Count = 0;
+    }
+}
+
+/**
+ * Function: StrToNumber
+ * 
+ * Validates and converts String, Length is the number of characters
+ * before the terminating null. Radix is 10, 16 or 0 for decimal unless a
+ * '0x' prefix is present. Leading whitespace and a '0x' prefix (hex only)
+ * are accepted as before, but at least one digit is now required. Values
+ * above Limit report VALUE_OVERFLOW rather than wrapping. If Negative is
+ * supplied a leading '+' or '-' is accepted and a negative value may
+ * reach Limit+1. If End is supplied the number may also be ended by a ','
+ * and End is set to the character that ended it.
+ * The digits are validated first, then converted a word at a time.
+ **/
+STATIC VALUE_STATUS StrToNumber(IN CONST CHAR16 *String, IN UINTN Length, IN UINTN Radix, IN UINT64 Limit, OUT UINT64 *Value, OUT BOOLEAN *Negative OPTIONAL, OUT CONST CHAR16 **End OPTIONAL)
+{
+    CONST CHAR16 *StrEnd = String + Length;
+    UINT64 Result = 0;
+    UINT64 Cutoff;
+    UINTN WordRadix;
+    UINTN Digits;
+    UINTN Head;
+    BOOLEAN HaveDigit = FALSE;
+    
+    while ((*String == L' ') || (*String == L'\t')) {
+        String++;
+    }
+    if (Negative) {
+        *Negative = FALSE;
+        if (*String == L'-') {
+            *Negative = TRUE;
+            Limit++;
+            String++;
+        } else if (*String == L'+') {
+            String++;
+        }
+    }
+    if (Radix != 10) {
+        // leading zeros count as digits unless they turn out to be a hex prefix
+        while (*String == L'0') {
+            HaveDigit = TRUE;
+            String++;
+        }
+        if ((*String == L'x') || (*String == L'X')) {
+            if (!HaveDigit) {
+                return VALUE_INVALID;
+            }
+            HaveDigit = FALSE;
+            Radix = 16;
+            String++;
+        } else if (Radix == 0) {
+            Radix = 10;
+        }
+    }
+
+    Digits = DigitRun(String, StrEnd - String, Radix);
+    CMDLINE_WORK(Digits + 1);
+    if (Digits) {
+        HaveDigit = TRUE;
+    }
+    if (((String[Digits] != L'\0') && !(End && (String[Digits] == L','))) || !HaveDigit) {
+        return VALUE_INVALID;
+    }
+    if (End) {
+        *End = &String[Digits];
+    }
+
+    // leading digits that do not fill a word, too few to exceed any Limit
+    Head = 0;
+    for (; (Digits % SWAR_LANES) != 0; Digits--, String++) {
+        Head = (Head * Radix) + DigitValue(*String);
+    }
+    Result = Head;
+
+    // whole words, Result can take another word if not above Cutoff
+    if (Digits) {
+        WordRadix = (Radix == 16) ? SWAR_HEX_RADIX : SWAR_DEC_RADIX;
+        Cutoff = (Radix == 16) ? RShiftU64(Limit, SWAR_LANES * 4) : DivU64x32(Limit, (UINT32)WordRadix);
+        for (; Digits > 0; Digits -= SWAR_LANES, String += SWAR_LANES) {
+            Head = WordValue(LoadChars(String), Radix);
+            if (Result > Cutoff) {
+                return VALUE_OVERFLOW;
+            }
+            Result = MultU64x32(Result, (UINT32)WordRadix);
+            if (Result > Limit - Head) {
+                return VALUE_OVERFLOW;
+            }
+            Result += Head;
+        }
+    }
+    *Value = Result;
+    return VALUE_OK;
+}
+
+/**
+ * Function: AppendValueList
+ * 
+ * Converts comma separated values straight into the list, in a single
+ * pass with no copy of the string
+ **/
+STATIC VALUE_STATUS AppendValueList(IN CONST CHAR16 *String, IN UINTN Radix, IN OUT VALUE_LIST *List)
+{
+    CONST CHAR16 *StrEnd = String + StrLen(String);
+    VALUE_STATUS Status;
+    UINT64 Value;
+
+    for (;;) {
+        Status = StrToNumber(String, StrEnd - String, Radix, MAX_UINTN, &Value, NULL, &String);
+        if (Status != VALUE_OK) {
+            return Status;
+        }
+        if (List->Count >= List->MaxCount) {
+            return VALUE_LIST_FULL;
+        }
+        List->Values[List->Count++] = (UINTN)Value;
+        if (*String == L'\0') {
+            return VALUE_OK;
+        }
+        String++;   // skip ','
+    }
+}
+
+/**
+ * Function: DecodeHexBlob
+ * 
+ * The whole string is checked before anything is written, so the
+ * caller's buffer and Size are unchanged on error. Decodes straight into
+ * the caller's buffer a word of characters at a time.
+ **/
+STATIC VALUE_STATUS DecodeHexBlob(IN CONST CHAR16 *String, IN OUT VALUE_BLOB *Blob)
+{
+    UINT8 *Out = Blob->Buffer;
+    UINTN Length;
+    UINTN Word;
+    UINTN Value;
+    UINTN Hi, Lo;
+    UINTN i, j;
+
+    if ((String[0] == L'0') && ((String[1] == L'x') || (String[1] == L'X'))) {
+        String += 2;
+    }
+    Length = StrLen(String);
+    CMDLINE_WORK(Length);
+    // bad characters are reported before a bad length
+    if ((Length == 0) || (DigitRun(String, Length, 16) != Length)) {
+        return VALUE_INVALID;
+    }
+    if (Length & 1) {
+        return VALUE_ODD_DIGITS;
+    }
+    if ((Length / 2) > Blob->MaxSize) {
+        return VALUE_TOO_LONG;
+    }
+
+    for (i = 0; (Length - i) >= SWAR_LANES; i += SWAR_LANES) {
+        Word = LoadChars(&String[i]);
+        // first digit is most significant
+        Value = WordValue(Word, 16);
+        for (j = SWAR_LANES / 2; j > 0; j--) {
+            *Out++ = (UINT8)(Value >> ((j - 1) * 8));
+        }
+    }
+    for (; i < Length; i += 2) {
+        Hi = DigitValue(String[i]);
+        Lo = DigitValue(String[i+1]);
+        *Out++ = (UINT8)((Hi << 4) | Lo);
+    }
+    Blob->Size = Length / 2;
+    return VALUE_OK;
+}
+
+/**
+ * Function: HexBlobSize
+ * 
+ * Returns the number of bytes hex data String decodes to
+ **/
+STATIC UINTN HexBlobSize(IN CONST CHAR16 *String)
+{
+    if (!String) {
+        return 0;
+    }
+    if ((String[0] == L'0') && ((String[1] == L'x') || (String[1] == L'X'))) {
+        String += 2;
+    }
+    return StrLen(String) / 2;
+}
+
+/**
+ * Function: DigitRun
+ * 
+ * Returns number of leading digits in String (Radix 10 or 16), looking at
+ * no more than Length characters. Whole words of characters are checked
+ * at once while they are all digits, then the rest one at a time.
+ **/
+STATIC UINTN DigitRun(IN CONST CHAR16 *String, IN UINTN Length, IN UINTN Radix)
+{
+    UINTN Run = 0;
+    UINTN Word;
+
+    while (Length - Run >= SWAR_LANES) {
+        Word = LoadChars(&String[Run]);
+        if ((Word & SWAR_NOT_ASCII) || (DigitLanes(Word, Radix) != SWAR_HIGH)) {
+            break;
+        }
+        Run += SWAR_LANES;
+    }
+    while ((Run < Length) && (DigitValue(String[Run]) < Radix)) {
+        Run++;
+    }
+    return Run;
+}
+
+/**
+ * Function: LoadChars
+ * 
+ * Packs SWAR_LANES characters into a word, first character in the low
+ * lane. Built from CHAR16 reads so String need not be word aligned.
+ **/
+STATIC UINTN LoadChars(IN CONST CHAR16 *String)
+{
+    UINTN Word = 0;
+    UINTN i;
+
+    for (i = 0; i < SWAR_LANES; i++) {
+        Word |= (UINTN)String[i] << (i * 16);
+    }
+    return Word;
+}
+
+/**
+ * Function: DigitLanes
+ * 
+ * Sets the top bit of each lane of an ASCII word that holds a digit
+ **/
+STATIC UINTN DigitLanes(IN UINTN Word, IN UINTN Radix)
+{
+    UINTN Lanes = SWAR_IN(Word, L'0', L'9');
+
+    if (Radix == 16) {
+        Lanes |= SWAR_IN(Word | SWAR_LOWER, L'a', L'f');
+    }
+    return Lanes;
+}
+
+/**
+ * Function: WordValue
+ * 
+ * Converts a word of SWAR_LANES valid digits
+ **/
+STATIC UINTN WordValue(IN UINTN Word, IN UINTN Radix)
+{
+    UINTN Nibbles = Word & (SWAR_ONES * 0xF);
+    UINTN Value = 0;
+    UINTN i;
+
+    if (Radix == 16) {
+        // low nibble of 'a'-'f' and 'A'-'F' is 1-6
+        Nibbles += (SWAR_IN(Word | SWAR_LOWER, L'a', L'f') >> 15) * 9;
+    }
+    for (i = 0; i < SWAR_LANES; i++) {
+        Value = (Value * Radix) + ((Nibbles >> (i * 16)) & 0xF);
+    }
+    return Value;
+}
+
+/**
+ * Function: DigitValue
+ * 
+ * Returns value of hex digit, or 16 if Char is not a digit
+ **/
+STATIC UINTN DigitValue(IN CHAR16 Char)
+{
+    if ((Char >= L'0') && (Char <= L'9')) {
+        return Char - L'0';
+    }
+    Char |= 0x20; // fold to lower case
+    if ((Char >= L'a') && (Char <= L'f')) {
+        return Char - L'a' + 10;
+    }
+    return 16;
+}
+
+/**
+ * Function: GetEnumVal
+ * 
+ * Lookup options are held in the Value of the terminating entry.
+ * EnumIndex is the compiled lookup of the array, if NULL the entries
+ * are counted and a sorted array binary searched, others linearly.
+ **/
+STATIC BOOLEAN GetEnumVal(IN ENUM_STR_ARRAY *EnumStrArray, IN ENUM_INDEX *EnumIndex, IN CONST CHAR16 *Str, OUT UINTN *Value)
+{
+    UINTN Count;
+    UINTN Flags;
+    UINTN i;
+
+    if (EnumIndex && EnumIndex->Keys) {
+        Count = EnumIndex->Count;
+    } else {
+        EnumIndex = NULL;
+        Count = CountEnum(EnumStrArray);
+    }
+    Flags = EnumStrArray[Count].Value;
+    if (Str[0] == L'\0') {
+        Flags &= ~ENUMSTR_PREFIX;
+    }
+    if (EnumIndex) {
+        i = FindEnumKey(EnumIndex, Str, Flags);
+    } else if (Flags & ENUMSTR_SORTED) {
+        i = FindSortedEnum(EnumStrArray, Count, Str, Flags);
+    } else {
+        i = FindUnsortedEnum(EnumStrArray, Count, Str, Flags);
+    }
+    if (i >= Count) {
+        return FALSE;
+    }
+    if (Value) {
+        *Value = EnumStrArray[i].Value;
+    }
+    return TRUE;
+}
+
+/**
+ * Function: CountEnum
+ * 
+ * Returns the number of entries before the terminating entry
+ **/
+STATIC UINTN CountEnum(IN ENUM_STR_ARRAY *EnumStrArray)
+{
+    UINTN Count = 0;
+
+    while (EnumStrArray[Count].Str) {
+        Count++;
+    }
+    return Count;
+}
+
+/**
+ * Function: RecordEnumArray
+ * 
+ * Enum array of a value record (switch rows then parameters), NULL if
+ * the record is not an enum
+ **/
+STATIC ENUM_STR_ARRAY *RecordEnumArray(IN CMDLINE_PARSER *Parser, IN UINTN Record)
+{
+    if (Record < Parser->TableSwCount) {
+        return (Parser->SwTable[Record].ValueType == VALTYPE_ENUM) ? Parser->SwTable[Record].Data.EnumStrArray : NULL;
+    }
+    Record -= Parser->TableSwCount;
+    return (Parser->ParamTable[Record].ValueType == VALTYPE_ENUM) ? Parser->ParamTable[Record].Data.EnumStrArray : NULL;
+}
+
+/**
+ * Function: EnumIndexSize
+ * 
+ * Bytes needed by BuildEnumIndex(), 0 if there are no enum entries
+ **/
+STATIC UINTN EnumIndexSize(IN CMDLINE_PARSER *Parser)
+{
+    ENUM_STR_ARRAY *EnumStrArray;
+    UINTN Records = Parser->TableSwCount + Parser->TableParamCount;
+    UINTN Keys = 0;
+    UINTN Chars = 0;
+    UINTN i;
+    UINTN n;
+
+    for (i = 0; i < Records; i++) {
+        EnumStrArray = RecordEnumArray(Parser, i);
+        for (n = 0; EnumStrArray && EnumStrArray[n].Str; n++) {
+            Keys++;
+            Chars += StrLen(EnumStrArray[n].Str) + 1;
+        }
+    }
+    if (!Keys) {
+        return 0;
+    }
+    return (Records * sizeof(ENUM_INDEX)) + (Keys * sizeof(ENUM_KEY)) + ALIGN_VALUE(Chars * sizeof(CHAR16), sizeof(UINTN));
+}
+
+/**
+ * Function: BuildEnumIndex
+ * 
+ * Each enum array is counted, its names upper cased into a pool and
+ * heap sorted once, so lookups only fold the value entered. EnumIndex
+ * is EnumIndexSize() bytes: the index, the keys then the name pool.
+ **/
+STATIC VOID BuildEnumIndex(IN CMDLINE_PARSER *Parser, OUT ENUM_INDEX *EnumIndex)
+{
+    ENUM_STR_ARRAY *EnumStrArray;
+    UINTN Records = Parser->TableSwCount + Parser->TableParamCount;
+    ENUM_KEY *Keys = (ENUM_KEY *)(EnumIndex + Records);
+    CHAR16 *Pool;
+    ENUM_KEY Key;
+    UINTN Count;
+    UINTN i;
+    UINTN n;
+
+    for (i = 0; i < Records; i++) {
+        EnumStrArray = RecordEnumArray(Parser, i);
+        EnumIndex[i].Count = EnumStrArray ? CountEnum(EnumStrArray) : 0;
+        EnumIndex[i].Keys = EnumStrArray ? Keys : NULL;
+        Keys += EnumIndex[i].Count;
+    }
+    Pool = (CHAR16 *)Keys;
+
+    for (i = 0; i < Records; i++) {
+        EnumStrArray = RecordEnumArray(Parser, i);
+        Keys = EnumIndex[i].Keys;
+        Count = EnumIndex[i].Count;
+        for (n = 0; n < Count; n++) {
+            CONST CHAR16 *Str = EnumStrArray[n].Str;
+            Keys[n].Name = Pool;
+            Keys[n].Entry = n;
+            do {
+                *Pool++ = FOLD_CHAR(*Str);
+            } while (*Str++ != L'\0');
+        }
+        for (n = Count / 2; n > 0; n--) {
+            SiftEnumKey(Keys, n-1, Count);
+        }
+        for (n = Count; n > 1; n--) {
+            Key = Keys[0];
+            Keys[0] = Keys[n-1];
+            Keys[n-1] = Key;
+            SiftEnumKey(Keys, 0, n-1);
+        }
+    }
+}
+
+/**
+ * Function: SiftEnumKey
+ * 
+ **/
+STATIC VOID SiftEnumKey(IN OUT ENUM_KEY *Keys, IN UINTN Root, IN UINTN Count)
+{
+    UINTN Child;
+    ENUM_KEY Key;
+
+    for (Child = Root*2 + 1; Child < Count; Child = Root*2 + 1) {
+        if (Child+1 < Count && CompareEnumKeys(&Keys[Child], &Keys[Child+1]) < 0) {
+            Child++;
+        }
+        if (CompareEnumKeys(&Keys[Root], &Keys[Child]) >= 0) {
+            return;
+        }
+        Key = Keys[Root];
+        Keys[Root] = Keys[Child];
+        Keys[Child] = Key;
+        Root = Child;
+    }
+}
+
+/**
+ * Function: CompareEnumKeys
+ * 
+ * Name order, equal names in array order so the first is found
+ **/
+STATIC INTN CompareEnumKeys(IN CONST ENUM_KEY *Key1, IN CONST ENUM_KEY *Key2)
+{
+    INTN Cmp = StrCmp(Key1->Name, Key2->Name);
+
+    if (Cmp != 0) {
+        return Cmp;
+    }
+    return (Key1->Entry < Key2->Entry) ? -1 : (Key1->Entry > Key2->Entry);
+}
+
+/**
+ * Function: FindEnumKey
+ * 
+ * Binary search of the compiled keys, returns index of entry or Count
+ * if not found (or prefix is ambiguous)
+ **/
+STATIC UINTN FindEnumKey(IN ENUM_INDEX *EnumIndex, IN CONST CHAR16 *Str, IN UINTN Flags)
+{
+    ENUM_KEY *Keys = EnumIndex->Keys;
+    UINTN Count = EnumIndex->Count;
+    UINTN Low = 0;
+    UINTN High = Count;
+
+    // find first key not less than Str
+    while (Low < High) {
+        UINTN Mid = Low + (High - Low) / 2;
+        if (FoldedCmp(Keys[Mid].Name, Str) < 0) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
+    }
+    if (Low >= Count) {
+        return Count;
+    }
+    if (FoldedCmp(Keys[Low].Name, Str) == 0) {
+        return Keys[Low].Entry;
+    }
+    // keys starting with Str follow on directly, must be only one
+    if ((Flags & ENUMSTR_PREFIX) && FoldedPrefix(Str, Keys[Low].Name)) {
+        if (Low+1 < Count && FoldedPrefix(Str, Keys[Low+1].Name)) {
+            return Count;
+        }
+        return Keys[Low].Entry;
+    }
+    return Count;
+}
+
+/**
+ * Function: FoldedCmp
+ * 
+ * As StriCmp() where Folded is already upper cased
+ **/
+STATIC INTN FoldedCmp(IN CONST CHAR16 *Folded, IN CONST CHAR16 *String)
+{
+    while ((*Folded != L'\0') && (*Folded == FOLD_CHAR(*String))) {
+        Folded++;
+        String++;
+    }
+    return *Folded - FOLD_CHAR(*String);
+}
+
+/**
+ * Function: FoldedPrefix
+ * 
+ * As StriPrefix() where Folded is already upper cased
+ **/
+STATIC BOOLEAN FoldedPrefix(IN CONST CHAR16 *Prefix, IN CONST CHAR16 *Folded)
+{
+    while (*Prefix != L'\0') {
+        if (FOLD_CHAR(*Prefix) != *Folded) {
+            return FALSE;
+        }
+        Prefix++;
+        Folded++;
+    }
+    return TRUE;
+}
+
+/**
+ * Function: FindSortedEnum
+ * 
+ * Binary search, returns index of entry or Count if not found (or
+ * prefix is ambiguous). Order is checked by CmdLineValidateTables().
+ **/
+STATIC UINTN FindSortedEnum(IN ENUM_STR_ARRAY *EnumStrArray, IN UINTN Count, IN CONST CHAR16 *Str, IN UINTN Flags)
+{
+    UINTN Low = 0;
+    UINTN High = Count;
+
+    // find first entry not less than Str
+    while (Low < High) {
+        UINTN Mid = Low + (High - Low) / 2;
+        if (StriCmp(EnumStrArray[Mid].Str, Str) < 0) {
+            Low = Mid + 1;
+        } else {
+            High = Mid;
+        }
+    }
+    if (Low >= Count) {
+        return Count;
+    }
+    if (StriCmp(EnumStrArray[Low].Str, Str) == 0) {
+        return Low;
+    }
+    // entries starting with Str follow on directly, must be only one
+    if ((Flags & ENUMSTR_PREFIX) && StriPrefix(Str, EnumStrArray[Low].Str)) {
+        if (Low+1 < Count && StriPrefix(Str, EnumStrArray[Low+1].Str)) {
+            return Count;
+        }
+        return Low;
+    }
+    return Count;
+}
+
+/**
+ * Function: FindUnsortedEnum
+ * 
+ * Linear search, returns index of entry or Count if not found (or
+ * prefix is ambiguous)
+ **/
+STATIC UINTN FindUnsortedEnum(IN ENUM_STR_ARRAY *EnumStrArray, IN UINTN Count, IN CONST CHAR16 *Str, IN UINTN Flags)
+{
+    UINTN Match = Count;
+    UINTN Matches = 0;
+    UINTN i;
+
+    for (i = 0; i < Count; i++) {
+        if (StriCmp(Str, EnumStrArray[i].Str) == 0) {
+            return i;
+        }
+        if ((Flags & ENUMSTR_PREFIX) && StriPrefix(Str, EnumStrArray[i].Str)) {
+            Match = i;
+            Matches++;
+        }
+    }
+    return (Matches == 1) ? Match : Count;
+}
+
+/**
+ * Function: StriCmp
+ * 
+ **/
+STATIC INTN EFIAPI StriCmp(IN CONST CHAR16 *FirstString, IN CONST CHAR16 *SecondString)
+{
+  CHAR16  UpperFirstString;
+  CHAR16  UpperSecondString;
+
+  UpperFirstString  = FOLD_CHAR(*FirstString);
+  UpperSecondString = FOLD_CHAR(*SecondString);
+  while ((*FirstString != L'\0') && (UpperFirstString == UpperSecondString)) {
+    FirstString++;
+    SecondString++;
+    UpperFirstString  = FOLD_CHAR(*FirstString);
+    UpperSecondString = FOLD_CHAR(*SecondString);
+  }
+
+  return UpperFirstString - UpperSecondString;
+}
+
+/**
+ * Function: StriPrefix
+ * 
+ * TRUE if String starts with Prefix (case insensitive)
+ **/
+STATIC BOOLEAN StriPrefix(IN CONST CHAR16 *Prefix, IN CONST CHAR16 *String)
+{
+    while (*Prefix != L'\0') {
+        if (FOLD_CHAR(*Prefix) != FOLD_CHAR(*String)) {
+            return FALSE;
+        }
+        Prefix++;
+        String++;
+    }
+    return TRUE;
+}
+
+/**
+ * CmdLinePrintError()
+ * 
+ **/
+VOID CmdLinePrintError(IN CONST CHAR16 *ProgName, IN CONST CMDLINE_ERROR *Error)
+{
+    if (!Error) {
+        return;
+    }
+    switch (Error->Code) {
+    case CMDLINE_ERR_UNKNOWN_SWITCH:
+        ShellPrintEx(-1, -1, L"%H%s%N: Unknown option - '%H%s%N'\r\n", ProgName, Error->Arg);
+        break;
+    case CMDLINE_ERR_AMBIGUOUS_SWITCH:
+        ShellPrintEx(-1, -1, L"%H%s%N: Ambiguous option - '%H%s%N'\r\n", ProgName, Error->Arg);
+        break;
+    case CMDLINE_ERR_DUPLICATE_SWITCH:
+        ShellPrintEx(-1, -1, L"%H%s%N: Duplicate switch - '%H%s%N'\r\n", ProgName, Error->Arg);
+        break;
+    case CMDLINE_ERR_SWITCH_NO_VALUE:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' requires a value\r\n", ProgName, Error->Arg);
+        break;
+    case CMDLINE_ERR_SWITCH_VALUE:
+    case CMDLINE_ERR_SWITCH_RANGE:
+        SwitchValueError(ProgName, Error->Row, Error->ValueType, Error->Arg, Error->Value, Error->Code == CMDLINE_ERR_SWITCH_RANGE ? VALUE_OVERFLOW : VALUE_INVALID);
+        break;
+    case CMDLINE_ERR_SWITCH_LIST_FULL:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has too many values - '%H%s%N'\r\n", ProgName, Error->Arg, Error->Value);
+        break;
+    case CMDLINE_ERR_SWITCH_ODD_DIGITS:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has an odd number of hex digits - '%H%s%N'\r\n", ProgName, Error->Arg, Error->Value);
+        break;
+    case CMDLINE_ERR_SWITCH_TOO_LONG:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has too much data, %d bytes - '%H%s%N'\r\n", ProgName, Error->Arg, Error->Size, Error->Value);
+        break;
+    case CMDLINE_ERR_PARAM_VALUE:
+    case CMDLINE_ERR_PARAM_RANGE:
+        ParamValueError(ProgName, Error->Row, Error->ValueType, Error->Arg, Error->Code == CMDLINE_ERR_PARAM_RANGE ? VALUE_OVERFLOW : VALUE_INVALID);
+        break;
+    case CMDLINE_ERR_PARAM_ODD_DIGITS:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d has an odd number of hex digits - '%H%s%N'\r\n", ProgName, Error->Row+1, Error->Arg);
+        break;
+    case CMDLINE_ERR_PARAM_TOO_LONG:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d has too much data, %d bytes - '%H%s%N'\r\n", ProgName, Error->Row+1, Error->Size, Error->Arg);
+        break;
+    case CMDLINE_ERR_PARAM_LIST_FULL:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d has too many values - '%H%s%N'\r\n", ProgName, Error->Row+1, Error->Arg);
+        break;
+    case CMDLINE_ERR_TOO_MANY_PARAMS:
+        ShellPrintEx(-1, -1, L"%H%s%N: Too many parameters\r\n", ProgName);
+        break;
+    case CMDLINE_ERR_TOO_FEW_PARAMS:
+        ShellPrintEx(-1, -1, L"%H%s%N: Too few parameters\r\n", ProgName);
+        break;
+    case CMDLINE_ERR_MISSING_SWITCH:
+        ShellPrintEx(-1, -1, L"%H%s%N: Missing switch - '%H%s%N'\r\n", ProgName, Error->Arg);
+        break;
+    case CMDLINE_ERR_SWITCH_CONFLICT:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switches '%H%s%N' and '%H%s%N' cannot be used together\r\n", ProgName, Error->Arg, Error->Value);
+        break;
+    case CMDLINE_ERR_SWITCH_REQUIRES:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' requires '%H%s%N'\r\n", ProgName, Error->Arg, Error->Value);
+        break;
+    case CMDLINE_ERR_MISSING_GROUP:
+        ShellPrintEx(-1, -1, L"%H%s%N: Missing switch - one of '%H%s%N' ... '%H%s%N'\r\n", ProgName, Error->Arg, Error->Value);
+        break;
+    case CMDLINE_ERR_UNKNOWN_COMMAND:
+        ShellPrintEx(-1, -1, L"%H%s%N: Unknown command - '%H%s%N'\r\n", ProgName, Error->Arg);
+        break;
+    case CMDLINE_ERR_MISSING_COMMAND:
+        ShellPrintEx(-1, -1, L"%H%s%N: Missing command\r\n", ProgName);
+        break;
+    case CMDLINE_ERR_TABLE:
+        TableError(Error->Row, Error->Value);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Function: ClearError
+ * 
+ **/
+STATIC VOID ClearError(OUT CMDLINE_ERROR *Error)
+{
+    ZeroMem(Error, sizeof(CMDLINE_ERROR));
+    Error->Row = CMDLINE_NO_ROW;
+}
+
+/**
+ * Function: ParseError
+ * 
+ * Records the error and prints it unless QUIET_ERRORS set
+ **/
+STATIC VOID ParseError(IN CONST CHAR16 *ProgName, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error, IN CMDLINE_ERROR_CODE Code, IN UINTN ArgIndex, IN CONST CHAR16 *Arg, IN CONST CHAR16 *Value, IN UINTN Row, IN VALUE_TYPE ValueType)
+{
+    Error->Code = Code;
+    Error->ArgIndex = ArgIndex;
+    Error->Arg = Arg;
+    Error->Value = Value;
+    Error->Row = Row;
+    Error->ValueType = ValueType;
+    Error->Size = 0;
+    if ((Code == CMDLINE_ERR_SWITCH_TOO_LONG) || (Code == CMDLINE_ERR_PARAM_TOO_LONG)) {
+        Error->Size = HexBlobSize((Code == CMDLINE_ERR_SWITCH_TOO_LONG) ? Value : Arg);
+    }
+    if ((FuncOpt & QUIET_ERRORS) == 0) {
+        CmdLinePrintError(ProgName, Error);
+    }
+}
+
+/**
+ * Function: AmbiguousSwitchError
+ * 
+ * As ParseError() but the message lists the switches Arg could be, in
+ * table order then help and break. Row is the first of these.
+ **/
+STATIC VOID AmbiguousSwitchError(IN CONST CHAR16 *ProgName, IN SWITCH_TABLE *SwTable, IN UINTN SwCount, IN UINT16 FuncOpt, IN UINTN ArgIndex, IN CONST CHAR16 *Arg, OUT CMDLINE_ERROR *Error)
+{
+    CONST CHAR16 *Sep = L" ";
+    UINTN Row = CMDLINE_NO_ROW;
+    UINTN i;
+
+    for (i = 0; i < SwCount && Row == CMDLINE_NO_ROW; i++) {
+        if (SwTable[i].SwStr2 && StriPrefix(Arg, SwTable[i].SwStr2)) {
+            Row = i;
+        }
+    }
+    ParseError(ProgName, FuncOpt | QUIET_ERRORS, Error, CMDLINE_ERR_AMBIGUOUS_SWITCH, ArgIndex, Arg, NULL,
+               Row, (Row != CMDLINE_NO_ROW) ? SwTable[Row].ValueType : VALTYPE_NONE);
+    if (FuncOpt & QUIET_ERRORS) {
+        return;
+    }
+    ShellPrintEx(-1, -1, L"%H%s%N: Ambiguous option - '%H%s%N' could be", ProgName, Arg);
+    for (i = 0; i < SwCount; i++) {
+        if (SwTable[i].SwStr2 && StriPrefix(Arg, SwTable[i].SwStr2)) {
+            ShellPrintEx(-1, -1, L"%s'%H%s%N'", Sep, SwTable[i].SwStr2);
+            Sep = L", ";
+        }
+    }
+    if ((FuncOpt & NO_HELP) == 0 && StriPrefix(Arg, HelpSwStr2)) {
+        ShellPrintEx(-1, -1, L"%s'%H%s%N'", Sep, HelpSwStr2);
+        Sep = L", ";
+    }
+    if ((FuncOpt & FORCE_BREAK) && StriPrefix(Arg, BreakSwStr2)) {
+        ShellPrintEx(-1, -1, L"%s'%H%s%N'", Sep, BreakSwStr2);
+    }
+    ShellPrintEx(-1, -1, L"\r\n");
+}
+
+/**
+ * Function: ValueErrorCode
+ * 
+ **/
+STATIC CMDLINE_ERROR_CODE ValueErrorCode(IN VALUE_STATUS ValueStatus, IN BOOLEAN Switch)
+{
+    switch (ValueStatus) {
+    case VALUE_OVERFLOW:
+        return Switch ? CMDLINE_ERR_SWITCH_RANGE : CMDLINE_ERR_PARAM_RANGE;
+    case VALUE_LIST_FULL:
+        return Switch ? CMDLINE_ERR_SWITCH_LIST_FULL : CMDLINE_ERR_PARAM_LIST_FULL;
+    case VALUE_ODD_DIGITS:
+        return Switch ? CMDLINE_ERR_SWITCH_ODD_DIGITS : CMDLINE_ERR_PARAM_ODD_DIGITS;
+    case VALUE_TOO_LONG:
+        return Switch ? CMDLINE_ERR_SWITCH_TOO_LONG : CMDLINE_ERR_PARAM_TOO_LONG;
+    default:
+        return Switch ? CMDLINE_ERR_SWITCH_VALUE : CMDLINE_ERR_PARAM_VALUE;
+    }
+}
+
+/**
+ * Function: ShellErrorArg
+ * 
+ * The shell parser's strings are freed with its package, so the record
+ * is pointed at Argv[ArgIndex] of the shell instead (NULL if ArgIndex
+ * is 0). Switch names from the tables (TableArg) are left as is, a
+ * switch value is the argument after the switch.
+ **/
+STATIC VOID ShellErrorArg(IN OUT CMDLINE_ERROR *Error, IN UINTN ArgIndex, IN BOOLEAN TableArg)
+{
+    CHAR16 **Argv = gEfiShellParametersProtocol ? gEfiShellParametersProtocol->Argv : NULL;
+
+    Error->ArgIndex = ArgIndex;
+    if (!TableArg) {
+        Error->Arg = ArgIndex ? Argv[ArgIndex] : NULL;
+    }
+    if (Error->Value) {
+        Error->Value = (ArgIndex && ArgIndex+1 < gEfiShellParametersProtocol->Argc) ? Argv[ArgIndex+1] : NULL;
+    }
+}
+
+/**
+ * Function: FindShellSwitch
+ * 
+ * Returns the Argv index of switch Name after skipping Skip matches, or
+ * 0 if not found. The shell matches switches case-insensitively, but
+ * compares names exactly when checking for duplicates.
+ **/
+STATIC UINTN FindShellSwitch(IN CONST CHAR16 *Name, IN BOOLEAN IgnoreCase, IN UINTN Skip)
+{
+    UINTN Found = 0;
+    UINTN i;
+
+    if (gEfiShellParametersProtocol) {
+        for (i = 1; i < gEfiShellParametersProtocol->Argc; i++) {
+            if (gEfiShellParametersProtocol->Argv[i] && (IgnoreCase ? StriCmp(gEfiShellParametersProtocol->Argv[i], Name) : StrCmp(gEfiShellParametersProtocol->Argv[i], Name)) == 0) {
+                Found = i;
+                if (Skip-- == 0) {
+                    break;
+                }
+            }
+        }
+    }
+    return Found;
+}
+
+/**
+ * Function: FindShellParam
+ * 
+ * Returns the Argv index of parameter Position (1 for the first), or 0
+ * if not found. Arguments are classified as ShellCommandLineParseEx()
+ * does, so a value equal to a parameter is not mistaken for it.
+ **/
+STATIC UINTN FindShellParam(IN SHELL_PARAM_ITEM *ParamList, IN BOOLEAN AllowNumbers, IN UINTN Position)
+{
+    CONST CHAR16 *Arg;
+    BOOLEAN GetValue = FALSE;
+    UINTN i, j;
+
+    if (!gEfiShellParametersProtocol) {
+        return 0;
+    }
+    for (i = 1; i < gEfiShellParametersProtocol->Argc; i++) {
+        Arg = gEfiShellParametersProtocol->Argv[i];
+        if (Arg == NULL) {
+            continue;
+        }
+        for (j = 0; ParamList[j].Name && StriCmp(Arg, ParamList[j].Name) != 0; j++) {
+        }
+        if (ParamList[j].Name) {
+            GetValue = (ParamList[j].Type == TypeValue);
+            continue;
+        }
+        if ((Arg[0] == L'-' || Arg[0] == L'/' || Arg[0] == L'+') && !(AllowNumbers && Arg[1] >= L'0' && Arg[1] <= L'9')) {
+            // a flag, never a value
+            continue;
+        }
+        if (GetValue) {
+            GetValue = FALSE;
+            continue;
+        }
+        if (--Position == 0) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * TableError()
+ * 
+ **/
+STATIC VOID TableError(IN UINTN i, IN CONST CHAR16 *errStr)
+{
+    if (i == CMDLINE_NO_ROW) {
+        ShellPrintEx(-1, -1, L"TBLERR: %s\n", errStr);
+        return;
+    }
+    ShellPrintEx(-1, -1, L"TBLERR(%d): %s\n", i, errStr);
+}
+
+/**
+ * ParamValueError()
+ * 
+ **/
+STATIC VOID ParamValueError(IN CONST CHAR16 *ProgName, IN UINTN i, IN VALUE_TYPE ValueType, IN CONST CHAR16 *ValueStr, IN VALUE_STATUS ValueStatus)
+{
+    if (ValueStatus == VALUE_OVERFLOW) {
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d value is out of range - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        return;
+    }
+    switch (ValueType) {
+    case VALTYPE_STRING:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid string - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;                
+    case VALTYPE_DECIMAL:
+    case VALTYPE_DEC64:
+    case VALTYPE_DECLIST:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid decimal value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;                
+    case VALTYPE_HEXIDECIMAL:
+    case VALTYPE_HEX64:
+    case VALTYPE_HEXLIST:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid hex value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;
+    case VALTYPE_INTEGER:
+    case VALTYPE_INT64:
+    case VALTYPE_INTLIST:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid integer value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;
+    case VALTYPE_SIGNED:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid signed integer value - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;
+    case VALTYPE_ENUM:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not a valid option - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;
+    case VALTYPE_HEXBLOB:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d is not valid hex data - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;
+    case VALTYPE_CALLBACK:
+        ShellPrintEx(-1, -1, L"%H%s%N: Parameter %d was rejected - '%H%s%N'\r\n", ProgName, i+1, ValueStr);
+        break;
+    default:
+        TableError(i, L"Parameter: Invalid 'ValueType'");
+        break;
+    }
+}
+
+/**
+ * SwitchValueError()
+ * 
+ **/
+STATIC VOID SwitchValueError(IN CONST CHAR16 *ProgName, IN UINTN i, IN VALUE_TYPE ValueType, IN CONST CHAR16 *SwStr, IN CONST CHAR16 *SwString, IN VALUE_STATUS ValueStatus)
+{
+    if (ValueStatus == VALUE_OVERFLOW) {
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' value is out of range - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        return;
+    }
+    switch (ValueType) {
+    case VALTYPE_STRING:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid string value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;                
+    case VALTYPE_DECIMAL:
+    case VALTYPE_DEC64:
+    case VALTYPE_DECLIST:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid decimal value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;                
+    case VALTYPE_HEXIDECIMAL:
+    case VALTYPE_HEX64:
+    case VALTYPE_HEXLIST:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid hex value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;
+    case VALTYPE_INTEGER:
+    case VALTYPE_INT64:
+    case VALTYPE_INTLIST:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid integer value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;
+    case VALTYPE_SIGNED:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid signed integer value - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;
+    case VALTYPE_ENUM:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid option - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;
+    case VALTYPE_HEXBLOB:
+        ShellPrintEx(-1, -1, L"%H%s%N: Switch '%H%s%N' has invalid hex data - '%H%s%N'\r\n", ProgName, SwStr, SwString);
+        break;
+    default:
+        TableError(i, L"Switch: Invalid 'ValueType'");
+        break;
+    }
+}
+
+/**
+ * ArgNameDefined()
+ * 
+ **/
+STATIC BOOLEAN ArgNameDefined(IN CHAR16 *HelpStr)
+{
+    return HelpStr[0] == L'[' ? TRUE:FALSE;
+}
+
+/**
+ * GetArgName()
+ * 
+ **/
+STATIC UINTN GetArgName(IN CHAR16 *HelpStr, OUT CHAR16* ArgName, IN UINTN ArgNameSize, IN BOOLEAN Mandatory, IN CONST CHAR16 *DefaultArgName)
+{
+    UINTN HelpStartIdx = 0;             // start of help text
+    CONST CHAR16 *ArgPtr = NULL;
+    UINTN ArgLen = 0;
+
+    if (ArgNameDefined(HelpStr)) {
+        UINTN i = 1;  // skip start brace
+        while (TRUE) {
+            CHAR16 c = HelpStr[i];
+            if (c == L']') {
+                // valid argument name found
+                ArgPtr = &HelpStr[1];   // char after '['
+                ArgLen = i-1;
+                break;
+            }
+            if (c == L'\0') {
+                // no end brace for arg name
+                break;
+            }
+            i++;
+        }
+        HelpStartIdx = i+1;
+    }
+    if (!ArgPtr && DefaultArgName) {
+        // no argument name specified so use default
+        ArgPtr = DefaultArgName;
+        ArgLen = StrLen(DefaultArgName);
+    }
+    if (ArgPtr) {
+        if (Mandatory) {
+            StrnCpyS(ArgName, ArgNameSize, ArgPtr, (ArgLen >= ArgNameSize) ? ArgNameSize-1 : ArgLen);
+        } else {
+            // optional argument
+            ArgName[0] = L'[';
+            ArgName[1] = L'\0';
+            StrnCatS(ArgName, ArgNameSize-1, ArgPtr, (ArgLen >= ArgNameSize-3) ? ArgNameSize-3 : ArgLen);
+            StrCatS(ArgName, ArgNameSize, L"]");
+        }
+    } else {
+        // no argument name specified or default given
+        ArgName[0] = L'\0';
+    }
+
+    return HelpStartIdx;
+}
+/**
+ * Function: GetParamArgName
+ * 
+ * As GetArgName() for a parameter, variadic parameters end with "..."
+ **/
+STATIC UINTN GetParamArgName(IN PARAMETER_TABLE *Param, OUT CHAR16 *ArgName, IN BOOLEAN Mandatory)
+{
+    UINTN HelpIdx;
+
+    HelpIdx = GetArgName(Param->HelpStr, ArgName, HELP_ARGNAME_SIZE, Mandatory, DefaultArgName);
+    if (VALTYPE_IS_VARIADIC(Param->ValueType) && StrLen(ArgName) + 3 < HELP_ARGNAME_SIZE) {
+        StrCatS(ArgName, HELP_ARGNAME_SIZE, L"...");
+    }
+    return HelpIdx;
+}
+
+/**
+ * Function: ShowHelp
+ * 
+ * Help is rendered into one buffer and written in a single call
+ **/
+STATIC VOID ShowHelp(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt)
+{
+    CHAR16 *HelpText;
+
+    if (FuncOpt & NO_HELP) {
+        return;
+    }
+    HelpText = BuildHelpText(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt);
+    if (HelpText) {
+        WriteHelpText(HelpText);
+        FreePool(HelpText);
+    }
+}
+
+/**
+ * Function: ShowParserHelp
+ * 
+ * Compiled parsers keep the rendered text for later requests
+ **/
+STATIC VOID ShowParserHelp(IN CMDLINE_PARSER *Parser)
+{
+    CHAR16 *HelpText = Parser->HelpText;
+
+    if (Parser->FuncOpt & NO_HELP) {
+        return;
+    }
+    if (!HelpText) {
+        HelpText = BuildHelpText(Parser->ProgName, Parser->ManParamCount, Parser->ParamTable, Parser->SwTable, Parser->ProgHelpStr, Parser->FuncOpt);
+        if (!HelpText) {
+            return;
+        }
+    }
+    WriteHelpText(HelpText);
+    if (Parser->CacheHelp) {
+        Parser->HelpText = HelpText;
+    } else {
+        FreePool(HelpText);
+    }
+}
+
+/**
+ * Function: ShowCommandHelp
+ * 
+ * Lists the subcommands, rendered as ShowHelp()
+ **/
+STATIC VOID ShowCommandHelp(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt)
+{
+    HELP_TEXT Help = {NULL, 0};
+
+    RenderCommandHelp(ProgName, SubCmdTable, GlobalSwTable, ProgHelpStr, FuncOpt, &Help);
+    Help.Buffer = AllocatePool((Help.Len + 1) * sizeof(CHAR16));
+    if (!Help.Buffer) {
+        return;
+    }
+    Help.Len = 0;
+    RenderCommandHelp(ProgName, SubCmdTable, GlobalSwTable, ProgHelpStr, FuncOpt, &Help);
+    Help.Buffer[Help.Len] = L'\0';
+    WriteHelpText(Help.Buffer);
+    FreePool(Help.Buffer);
+}
+
+/**
+ * Function: BuildHelpText
+ * 
+ * Renders once to measure and again into an exactly sized buffer
+ **/
+STATIC CHAR16 *BuildHelpText(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt)
+{
+    HELP_TEXT Help = {NULL, 0};
+
+    RenderHelp(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, &Help);
+    Help.Buffer = AllocatePool((Help.Len + 1) * sizeof(CHAR16));
+    if (!Help.Buffer) {
+        return NULL;
+    }
+    Help.Len = 0;
+    RenderHelp(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt, &Help);
+    Help.Buffer[Help.Len] = L'\0';
+    return Help.Buffer;
+}
+
+/**
+ * Function: WriteHelpText
+ * 
+ * Same destination as ShellPrintEx(), so output redirection still applies
+ **/
+STATIC VOID WriteHelpText(IN CONST CHAR16 *HelpText)
+{
+    UINTN Size = StrLen(HelpText) * sizeof(CHAR16);
+
+    if (gEfiShellParametersProtocol) {
+        ShellWriteFile(gEfiShellParametersProtocol->StdOut, &Size, (VOID *)HelpText);
+    } else {
+        // EFI shell 1.0
+        ShellPrintEx(-1, -1, L"%s", HelpText);
+    }
+}
+
+/**
+ * Function: RenderHelp
+ * 
+ * Column widths are taken from the tables, with a minimum of the
+ * original fixed layout so existing help text is unchanged
+ **/
+STATIC VOID RenderHelp(IN CONST CHAR16 *ProgName, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt, IN OUT HELP_TEXT *Help)
+{
+    CHAR16 ArgName[HELP_ARGNAME_SIZE];
+    UINTN HelpIdx;
+    UINTN ParamWidth = HELP_COLUMN_WIDTH;
+    UINTN i;
+
+    // column width
+    for (i = 0; ParamTable && ParamTable[i].ValueType != VALTYPE_NONE; i++) {
+        GetParamArgName(&ParamTable[i], ArgName, (i+1 <= ManParamCount));
+        ParamWidth = MAX(ParamWidth, StrLen(ArgName));
+    }
+
+    // program description
+    HelpAppend(Help, L"\n");
+    if (ProgHelpStr) {
+        HelpAppend(Help, ProgHelpStr);
+        HelpAppend(Help, L"\n\n");
+    }
+
+    // usage
+    HelpAppend(Help, L"Usage: ");
+    HelpAppend(Help, ProgName);
+    for (i = 0; ParamTable && ParamTable[i].ValueType != VALTYPE_NONE; i++) {
+        GetParamArgName(&ParamTable[i], ArgName, (i+1 <= ManParamCount));
+        HelpAppend(Help, L" ");
+        HelpAppend(Help, ArgName);
+    }
+    HelpAppend(Help, L" [options]\n");
+
+    // Parameter help
+    if (ParamTable) {
+        HelpAppend(Help, L"\n Parameters:\n");
+        for (i = 0; ParamTable[i].ValueType != VALTYPE_NONE; i++) {
+            HelpIdx = GetParamArgName(&ParamTable[i], ArgName, (i+1 <= ManParamCount));
+            HelpAppend(Help, L"  ");
+            HelpAppend(Help, ArgName);
+            HelpAppendPad(Help, ParamWidth - StrLen(ArgName) + 5);
+            HelpAppend(Help, &ParamTable[i].HelpStr[HelpIdx]);
+            HelpAppend(Help, L"\n");
+        }
+    }
+
+    // Switch help
+    RenderOptions(SwTable, FuncOpt, Help);
+    HelpAppend(Help, L"\n");
+}
+
+/**
+ * Function: RenderOptions
+ * 
+ * Switch help, ends with the help switch
+ **/
+STATIC VOID RenderOptions(IN SWITCH_TABLE *SwTable, IN UINTN FuncOpt, IN OUT HELP_TEXT *Help)
+{
+    CHAR16 ArgName[HELP_ARGNAME_SIZE];
+    UINTN HelpIdx;
+    UINTN ShortWidth = 2;
+    UINTN LongWidth = 0;
+    UINTN Len;
+    UINTN i, j;
+
+    // column widths
+    for (i = 0; SwTable && SwTable[i].SwitchNecessity != NO_SW; i++) {
+        GetArgName(SwTable[i].HelpStr, ArgName, HELP_ARGNAME_SIZE, TRUE, (SwTable[i].ValueType == VALTYPE_NONE) ? NULL : DefaultArgName);
+        Len = SwTable[i].SwStr2 ? StrLen(SwTable[i].SwStr2) : 0;
+        LongWidth = MAX(LongWidth, Len + StrLen(ArgName));
+        if (SwTable[i].SwStr1) {
+            ShortWidth = MAX(ShortWidth, StrLen(SwTable[i].SwStr1));
+        }
+    }
+    LongWidth = (LongWidth <= HELP_COLUMN_WIDTH) ? HELP_COLUMN_WIDTH : LongWidth + 1;
+
+    HelpAppend(Help, L"\n Options:\n");
+    for (i = 0; SwTable && SwTable[i].SwitchNecessity != NO_SW; i++) {
+        HelpIdx = GetArgName(SwTable[i].HelpStr, ArgName, HELP_ARGNAME_SIZE, TRUE, (SwTable[i].ValueType == VALTYPE_NONE) ? NULL : DefaultArgName);
+        RenderSwitchHelp(Help, SwTable[i].SwStr1, SwTable[i].SwStr2, ArgName, &SwTable[i].HelpStr[HelpIdx], ShortWidth, LongWidth);
+        if (SwTable[i].ValueType == VALTYPE_ENUM) {
+            // all valid options for enum switches
+            HelpAppend(Help, L" (");
+            for (j = 0; SwTable[i].Data.EnumStrArray[j].Str; j++) {
+                if (j) {
+                    HelpAppend(Help, L"|");
+                }
+                HelpAppend(Help, SwTable[i].Data.EnumStrArray[j].Str);
+            }
+            HelpAppend(Help, L")");
+        }
+        HelpAppend(Help, L"\n");
     }
     // break switch
     if (FuncOpt & FORCE_BREAK) {
-        ShellPrintEx(-1, -1, L"  %s, %s %s%s\n", BreakSwStr1, BreakSwStr2, &pad[StrLen(BreakSwStr2)], BreakSwStr);
+        RenderSwitchHelp(Help, BreakSwStr1, BreakSwStr2, L"", BreakSwStr, ShortWidth, LongWidth);
+        HelpAppend(Help, L"\n");
     }
     // help switch
-    ShellPrintEx(-1, -1, L"  %s, %s %s%s\n\n", HelpSwStr1, HelpSwStr2, &pad[StrLen(HelpSwStr2)], HelpSwStr);
+    RenderSwitchHelp(Help, HelpSwStr1, HelpSwStr2, L"", HelpSwStr, ShortWidth, LongWidth);
+    HelpAppend(Help, L"\n");
+}
+
+/**
+ * Function: RenderCommandHelp
+ * 
+ **/
+STATIC VOID RenderCommandHelp(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN CONST CHAR16 *ProgHelpStr, IN UINTN FuncOpt, IN OUT HELP_TEXT *Help)
+{
+    UINTN NameWidth = HELP_COLUMN_WIDTH;
+    UINTN i;
+
+    for (i = 0; SubCmdTable[i].Name; i++) {
+        NameWidth = MAX(NameWidth, StrLen(SubCmdTable[i].Name));
+    }
+
+    // program description
+    HelpAppend(Help, L"\n");
+    if (ProgHelpStr) {
+        HelpAppend(Help, ProgHelpStr);
+        HelpAppend(Help, L"\n\n");
+    }
+
+    // usage
+    HelpAppend(Help, L"Usage: ");
+    HelpAppend(Help, ProgName);
+    HelpAppend(Help, L" <command> [options]\n");
+
+    // command list
+    HelpAppend(Help, L"\n Commands:\n");
+    for (i = 0; SubCmdTable[i].Name; i++) {
+        HelpAppend(Help, L"  ");
+        HelpAppend(Help, SubCmdTable[i].Name);
+        if (SubCmdTable[i].HelpStr) {
+            HelpAppendPad(Help, NameWidth - StrLen(SubCmdTable[i].Name) + 5);
+            HelpAppend(Help, SubCmdTable[i].HelpStr);
+        }
+        HelpAppend(Help, L"\n");
+    }
+
+    // global switches
+    RenderOptions(GlobalSwTable, FuncOpt, Help);
+    HelpAppend(Help, L"\nRun '");
+    HelpAppend(Help, ProgName);
+    HelpAppend(Help, L" <command> -h' for help on a command\n\n");
+}
+
+/**
+ * Function: RenderSwitchHelp
+ * 
+ **/
+STATIC VOID RenderSwitchHelp(IN OUT HELP_TEXT *Help, IN CONST CHAR16 *SwStr1, IN CONST CHAR16 *SwStr2, IN CONST CHAR16 *ArgName, IN CONST CHAR16 *HelpStr, IN UINTN ShortWidth, IN UINTN LongWidth)
+{
+    UINTN Len = 0;
+
+    HelpAppend(Help, L"  ");
+    if (SwStr1) {
+        HelpAppend(Help, SwStr1);
+        Len = StrLen(SwStr1);
+    }
+    HelpAppend(Help, (SwStr1 && SwStr2) ? L", " : L"  ");
+    HelpAppendPad(Help, ShortWidth - Len);
+    Len = StrLen(ArgName);
+    if (SwStr2) {
+        HelpAppend(Help, SwStr2);
+        Len += StrLen(SwStr2);
+    }
+    HelpAppend(Help, L" ");
+    HelpAppend(Help, ArgName);
+    HelpAppendPad(Help, LongWidth - Len);
+    HelpAppend(Help, HelpStr);
+}
+
+/**
+ * Function: HelpAppend
+ * 
+ * Only measures if no buffer assigned
+ **/
+STATIC VOID HelpAppend(IN OUT HELP_TEXT *Help, IN CONST CHAR16 *Str)
+{
+    while (*Str != L'\0') {
+        if (Help->Buffer) {
+            Help->Buffer[Help->Len] = *Str;
+        }
+        Help->Len++;
+        Str++;
+    }
+}
+
+/**
+ * Function: HelpAppendPad
+ * 
+ **/
+STATIC VOID HelpAppendPad(IN OUT HELP_TEXT *Help, IN UINTN Count)
+{
+    if (Help->Buffer) {
+        SetMem16(&Help->Buffer[Help->Len], Count * sizeof(CHAR16), L' ');
+    }
+    Help->Len += Count;
+}
+
+/**
+ * CmdLineGetPhaseTimes()
+ * 
+ **/
+VOID CmdLineGetPhaseTimes(OUT CMDLINE_PHASE_TIMES *Times, IN BOOLEAN Reset)
+{
+    if (Times) {
+        CopyMem(Times, &PhaseTimes, sizeof(CMDLINE_PHASE_TIMES));
+        Times->Frequency = GetPerformanceCounterProperties(NULL, NULL);
+    }
+    if (Reset) {
+        ZeroMem(&PhaseTimes, sizeof(CMDLINE_PHASE_TIMES));
+    }
+}
+
+/**
+ * Function: PhaseBegin
+ * 
+ **/
+STATIC VOID PhaseBegin(IN UINT16 FuncOpt)
+{
+    UINT64 StartValue, EndValue;
+
+    if ((FuncOpt & PHASE_TIMING) == 0) {
+        return;
+    }
+    GetPerformanceCounterProperties(&StartValue, &EndValue);
+    CounterDown = StartValue > EndValue;
+    PhaseStart = GetPerformanceCounter();
+    ParseStart = PhaseStart;
+}
+
+/**
+ * Function: PhaseMark
+ * 
+ * Ends the phase started by the last PhaseBegin()/PhaseMark() and
+ * starts the next, so a phase boundary costs one counter read
+ **/
+STATIC VOID PhaseMark(IN UINT16 FuncOpt, IN CMDLINE_PHASE Phase)
+{
+    UINT64 Now;
+
+    if ((FuncOpt & PHASE_TIMING) == 0) {
+        return;
+    }
+    Now = GetPerformanceCounter();
+    PhaseTimes.Ticks[Phase] += CounterDown ? PhaseStart - Now : Now - PhaseStart;
+    PERF_START(NULL, PhaseToken[Phase], "CmdLine", PhaseStart);
+    PERF_END(NULL, PhaseToken[Phase], "CmdLine", Now);
+    PhaseStart = Now;
+}
+
+/**
+ * Function: PhaseFinish
+ * 
+ **/
+STATIC VOID PhaseFinish(IN UINT16 FuncOpt)
+{
+    if ((FuncOpt & PHASE_TIMING) == 0) {
+        return;
+    }
+    PhaseMark(FuncOpt, CMDLINE_PHASE_CLEANUP);
+    PhaseTimes.TotalTicks += CounterDown ? ParseStart - PhaseStart : PhaseStart - ParseStart;
+    PhaseTimes.ParseCount++;
+}
+
+/**
+ * Function: CheckRow
+ * 
+ * Returns description of problem with table row, or NULL if valid
+ **/
+STATIC CONST CHAR16 *CheckRow(IN VALUE_TYPE ValueType, IN DATA *Data, IN VALUE_RET_PTR ValueRetPtr, IN BOOLEAN Switch)
+{
+    if (ValueType > VALTYPE_CALLBACK || (ValueType == VALTYPE_NONE && !Switch) || (ValueType == VALTYPE_CALLBACK && Switch)) {
+        return Switch ? L"Switch: Invalid 'ValueType'" : L"Parameter: Invalid 'ValueType'";
+    }
+    if (ValueRetPtr.pVoid == NULL) {
+        return Switch ? L"Switch: Null 'RetValPtr'" : L"Parameter: Null 'RetValPtr'";
+    }
+    if (ValueType == VALTYPE_STRING && Data->MaxStrSize == 0) {
+        return Switch ? L"Switch: Zero 'StrSize'" : L"Parameter: Zero 'StrSize'";
+    }
+    if (ValueType == VALTYPE_ENUM && (Data->EnumStrArray == NULL || Data->EnumStrArray[0].Str == NULL)) {
+        return Switch ? L"Switch: Empty 'EnumArray'" : L"Parameter: Empty 'EnumArray'";
+    }
+    if (ValueType == VALTYPE_ENUM && !EnumSorted(Data->EnumStrArray)) {
+        return Switch ? L"Switch: 'EnumArray' not sorted" : L"Parameter: 'EnumArray' not sorted";
+    }
+    if (VALTYPE_IS_LIST(ValueType) && (ValueRetPtr.pList->Values == NULL || ValueRetPtr.pList->MaxCount == 0)) {
+        return Switch ? L"Switch: Empty 'ValueList'" : L"Parameter: Empty 'ValueList'";
+    }
+    if (ValueType == VALTYPE_CALLBACK && ValueRetPtr.pCallback->Handler == NULL) {
+        return L"Parameter: Null 'Handler'";
+    }
+    if (ValueType == VALTYPE_HEXBLOB && (ValueRetPtr.pBlob->Buffer == NULL || ValueRetPtr.pBlob->MaxSize == 0)) {
+        return Switch ? L"Switch: Empty 'ValueBlob'" : L"Parameter: Empty 'ValueBlob'";
+    }
+    return NULL;
+}
+
+/**
+ * Function: EnumSorted
+ * 
+ * FALSE if an ENUMSTR_SORTED array is out of order, as binary search
+ * then misses entries
+ **/
+STATIC BOOLEAN EnumSorted(IN ENUM_STR_ARRAY *EnumStrArray)
+{
+    UINTN Count;
+    UINTN i;
+
+    Count = CountEnum(EnumStrArray);
+    if ((EnumStrArray[Count].Value & ENUMSTR_SORTED) == 0) {
+        return TRUE;
+    }
+    for (i = 1; i < Count; i++) {
+        if (StriCmp(EnumStrArray[i-1].Str, EnumStrArray[i].Str) >= 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Function: CheckSwitchName
+ * 
+ * Adds name (may be NULL) to the index, returns description of problem
+ * or NULL if the name is valid and not already used
+ **/
+STATIC CONST CHAR16 *CheckSwitchName(IN SWITCH_TABLE *SwTable, IN UINTN Row, IN CONST CHAR16 *Name, IN UINT16 FuncOpt, IN BOOLEAN AllowNumbers, IN OUT SWITCH_INDEX_SLOT *Slots, IN UINTN SlotCount)
+{
+    if (!Name) {
+        return NULL;
+    }
+    if (!IsSwitchToken(Name, FALSE)) {
+        return L"Switch: Name is not a switch";
+    }
+    if (!IsSwitchToken(Name, AllowNumbers)) {
+        // a SINT row takes such arguments as values
+        return L"Switch: Name is a negative number";
+    }
+    switch (FindSwitch(SwTable, Row+1, Name, FuncOpt, Slots, SlotCount)) {
+    case SW_IDX_NONE:
+        AddSwitchIndex(Name, (UINT16)Row, Slots, SlotCount);
+        return NULL;
+    case SW_IDX_HELP:
+        return L"Switch: Name clashes with help switch";
+    case SW_IDX_BREAK:
+        return L"Switch: Name clashes with break switch";
+    default:
+        return L"Switch: Duplicate name";
+    }
 }
@@ -30,11 +30,23 @@
   PARAMTABLE_STR - Adds string parameter to table
 
   ValueRetPtr   Ptr to CHAR16 string to hold value entered
-  StrSize       Size of above string
+  StrSize       Size of above string (constant, not 0)
   HelpStr       Ptr to CHAR16 help string for parameter
 **/
 #define PARAMTABLE_STR(ValueRetPtr, StrSize, HelpStr) \
-    {VALTYPE_STRING, {.MaxStrSize=StrSize}, {.pChar16=ValueRetPtr}, HelpStr},
+    {VALTYPE_STRING, {.MaxStrSize=TABLE_CHECK((StrSize) > 0, StrSize)}, {.pChar16=ValueRetPtr}, HelpStr},
+
+/**
+  PARAMTABLE_STRVIEW - Adds string view parameter to table
+
+  The value is not copied, the view points into the argument string so
+  has no size limit. Needs the native tokenizer, see NATIVE_PARSE.
+
+  ValueViewPtr  Ptr to VALUE_STRVIEW to hold value entered, see VALUE_STRVIEW_INIT
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define PARAMTABLE_STRVIEW(ValueViewPtr, HelpStr) \
+    {VALTYPE_STRVIEW, {0}, {.pView=ValueViewPtr}, HelpStr},
 
 /**
   PARAMTABLE_DEC - Adds decimal parameter to table
@@ -63,6 +75,48 @@
 #define PARAMTABLE_INT(ValueRetPtr, HelpStr) \
     {VALTYPE_INTEGER, {0}, {.pUintn=ValueRetPtr}, HelpStr},
 
+/**
+  PARAMTABLE_SINT - Adds signed integer parameter (decimal or hex) to table
+
+  With a SINT row in either table every parser takes arguments such as
+  "-5" as values rather than switches, so no switch name may then start
+  with a digit. Without one they are switches, as in the shell.
+
+  ValueRetPtr   Ptr to INTN to hold value entered
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define PARAMTABLE_SINT(ValueRetPtr, HelpStr) \
+    {VALTYPE_SIGNED, {0}, {.pIntn=ValueRetPtr}, HelpStr},
+
+/**
+  PARAMTABLE_DEC64 - Adds 64-bit decimal parameter to table
+  PARAMTABLE_HEX64 - Adds 64-bit hexidecimal parameter to table
+  PARAMTABLE_INT64 - Adds 64-bit integer parameter (decimal or hex) to table
+
+  ValueRetPtr   Ptr to UINT64 to hold value entered
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define PARAMTABLE_DEC64(ValueRetPtr, HelpStr) \
+    {VALTYPE_DEC64, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define PARAMTABLE_HEX64(ValueRetPtr, HelpStr) \
+    {VALTYPE_HEX64, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define PARAMTABLE_INT64(ValueRetPtr, HelpStr) \
+    {VALTYPE_INT64, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+
+/**
+  PARAMTABLE_HEXBLOB - Adds hex data parameter to table
+
+  The value is an even number of hex digits, optionally prefixed by "0x",
+  and is decoded straight into the caller's buffer, e.g. "0x0102ff".
+  A bad value leaves the buffer and its Size unchanged, for data that is
+  too long the error record's Size is the number of bytes needed.
+
+  ValueBlobPtr  Ptr to VALUE_BLOB to hold data entered, see VALUE_BLOB_INIT
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define PARAMTABLE_HEXBLOB(ValueBlobPtr, HelpStr) \
+    {VALTYPE_HEXBLOB, {0}, {.pBlob=ValueBlobPtr}, HelpStr},
+
 /**
   PARAMTABLE_ENUM - Adds enum parameter to table (string entry)
 
@@ -73,6 +127,38 @@
 #define PARAMTABLE_ENUM(ValueRetPtr, EnumArray, HelpStr) \
     {VALTYPE_ENUM, EnumArray, {.pEnum=ValueRetPtr}, HelpStr},
 
+/**
+  PARAMTABLE_DECLIST - Adds trailing decimal list parameter to table
+  PARAMTABLE_HEXLIST - Adds trailing hexidecimal list parameter to table
+  PARAMTABLE_INTLIST - Adds trailing integer (decimal or hex) list parameter to table
+
+  Must be the last parameter, it takes all remaining parameters and
+  each may be a comma separated list, e.g. "0x1000 0x2000,0x3000".
+  Values are converted straight into the caller's array.
+
+  ValueListPtr  Ptr to VALUE_LIST to hold values entered, see VALUE_LIST_INIT
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define PARAMTABLE_DECLIST(ValueListPtr, HelpStr) \
+    {VALTYPE_DECLIST, {0}, {.pList=ValueListPtr}, HelpStr},
+#define PARAMTABLE_HEXLIST(ValueListPtr, HelpStr) \
+    {VALTYPE_HEXLIST, {0}, {.pList=ValueListPtr}, HelpStr},
+#define PARAMTABLE_INTLIST(ValueListPtr, HelpStr) \
+    {VALTYPE_INTLIST, {0}, {.pList=ValueListPtr}, HelpStr},
+
+/**
+  PARAMTABLE_CALLBACK - Adds trailing callback parameter to table
+
+  Must be the last parameter, it takes all remaining parameters and
+  passes each to the handler as it is parsed, so there is no limit on
+  their number, e.g. a list of file names. See CMDLINE_VALUE_HANDLER.
+
+  ValueCallbackPtr  Ptr to VALUE_CALLBACK naming the handler, see VALUE_CALLBACK_INIT
+  HelpStr           Ptr to CHAR16 help string for parameter
+**/
+#define PARAMTABLE_CALLBACK(ValueCallbackPtr, HelpStr) \
+    {VALTYPE_CALLBACK, {0}, {.pCallback=ValueCallbackPtr}, HelpStr},
+
 /**
   PARAMTABLE_END - Ends the parameter table
 **/
@@ -110,11 +196,11 @@
   SwStr1        Ptr to CHAR16 defining short switch name
   SwStr2        Ptr to CHAR16 defining long switch name
   ValueRetPtr   Ptr to UINTN, set to 'Value' if switch present
-  Value         Value to set if switch present
+  Value         Value to set if switch present (constant, not 0)
   HelpStr       Ptr to CHAR16 help string for switch
 **/
 #define SWTABLE_OPT_FLGVAL(SwStr1, SwStr2, ValueRetPtr, Value, HelpStr) \
-    {SwStr1, SwStr2, OPT_SW, VALTYPE_NONE, NO_VALUE, {.FlagValue=Value}, {.pUintn=ValueRetPtr}, HelpStr},
+    {SwStr1, SwStr2, OPT_SW, VALTYPE_NONE, NO_VALUE, {.FlagValue=TABLE_CHECK((Value) != 0, Value)}, {.pUintn=ValueRetPtr}, HelpStr},
 
 /**
   SWTABLE_OPT_STR - Adds an optional string switch to table
@@ -123,14 +209,30 @@
   SwStr1        Ptr to CHAR16 defining short switch name
   SwStr2        Ptr to CHAR16 defining long switch name
   ValueRetPtr   Ptr to CHAR16 string to hold value entered
-  StrSize       Size of above string
+  StrSize       Size of above string (constant, not 0)
   HelpStr       Ptr to CHAR16 help string for parameter
 **/
 #define SWTABLE_OPT_STR(SwStr1, SwStr2, ValueRetPtr, StrSize, HelpStr) \
-    { SwStr1, SwStr2, OPT_SW, VALTYPE_STRING, MAN_VALUE, {.MaxStrSize=StrSize}, {.pChar16=ValueRetPtr}, HelpStr},
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_STRING, MAN_VALUE, {.MaxStrSize=TABLE_CHECK((StrSize) > 0, StrSize)}, {.pChar16=ValueRetPtr}, HelpStr},
 #define SWTABLE_MAN_STR(SwStr1, SwStr2, ValueRetPtr, StrSize, HelpStr) \
-    { SwStr1, SwStr2, MAN_SW, VALTYPE_STRING, MAN_VALUE, {.MaxStrSize=StrSize}, {.pChar16=ValueRetPtr}, HelpStr},
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_STRING, MAN_VALUE, {.MaxStrSize=TABLE_CHECK((StrSize) > 0, StrSize)}, {.pChar16=ValueRetPtr}, HelpStr},
+
 
+/**
+  SWTABLE_OPT_STRVIEW - Adds an optional string view switch to table
+  SWTABLE_MAN_STRVIEW - Adds a mandatory string view switch to table
+
+  The value is returned as for PARAMTABLE_STRVIEW.
+
+  SwStr1        Ptr to CHAR16 defining short switch name
+  SwStr2        Ptr to CHAR16 defining long switch name
+  ValueViewPtr  Ptr to VALUE_STRVIEW to hold value entered, see VALUE_STRVIEW_INIT
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define SWTABLE_OPT_STRVIEW(SwStr1, SwStr2, ValueViewPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_STRVIEW, MAN_VALUE, {0}, {.pView=ValueViewPtr}, HelpStr},
+#define SWTABLE_MAN_STRVIEW(SwStr1, SwStr2, ValueViewPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_STRVIEW, MAN_VALUE, {0}, {.pView=ValueViewPtr}, HelpStr},
 
 /**
   SWTABLE_OPT_DEC - Adds an optional decimal switch to table
@@ -174,6 +276,48 @@
 #define SWTABLE_MAN_INT(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
     { SwStr1, SwStr2, MAN_SW, VALTYPE_INTEGER, MAN_VALUE, {0}, {.pUintn=ValueRetPtr}, HelpStr},
 
+/**
+  SWTABLE_OPT_SINT - Adds an optional signed integer (decimal or hex) switch to table
+  SWTABLE_MAN_SINT - Adds a mandatory signed integer (decimal or hex) switch to table
+
+  Negative values are accepted as for PARAMTABLE_SINT.
+
+  SwStr1        Ptr to CHAR16 defining short switch name
+  SwStr2        Ptr to CHAR16 defining long switch name
+  ValueRetPtr   Ptr to INTN to hold value entered
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define SWTABLE_OPT_SINT(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_SIGNED, MAN_VALUE, {0}, {.pIntn=ValueRetPtr}, HelpStr},
+#define SWTABLE_MAN_SINT(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_SIGNED, MAN_VALUE, {0}, {.pIntn=ValueRetPtr}, HelpStr},
+
+/**
+  SWTABLE_OPT_DEC64 - Adds an optional 64-bit decimal switch to table
+  SWTABLE_MAN_DEC64 - Adds a mandatory 64-bit decimal switch to table
+  SWTABLE_OPT_HEX64 - Adds an optional 64-bit hexidecimal switch to table
+  SWTABLE_MAN_HEX64 - Adds a mandatory 64-bit hexidecimal switch to table
+  SWTABLE_OPT_INT64 - Adds an optional 64-bit integer (decimal or hex) switch to table
+  SWTABLE_MAN_INT64 - Adds a mandatory 64-bit integer (decimal or hex) switch to table
+
+  SwStr1        Ptr to CHAR16 defining short switch name
+  SwStr2        Ptr to CHAR16 defining long switch name
+  ValueRetPtr   Ptr to UINT64 to hold value entered
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define SWTABLE_OPT_DEC64(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_DEC64, MAN_VALUE, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define SWTABLE_MAN_DEC64(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_DEC64, MAN_VALUE, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define SWTABLE_OPT_HEX64(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_HEX64, MAN_VALUE, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define SWTABLE_MAN_HEX64(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_HEX64, MAN_VALUE, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define SWTABLE_OPT_INT64(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_INT64, MAN_VALUE, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+#define SWTABLE_MAN_INT64(SwStr1, SwStr2, ValueRetPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_INT64, MAN_VALUE, {0}, {.pUint64=ValueRetPtr}, HelpStr},
+
 /**
   SWTABLE_OPT_ENUM - Adds an optional enum switch to table (string entry)
   SWTABLE_MAN_ENUM - Adds a mandatory enum switch to table (string entry)
@@ -189,12 +333,153 @@
 #define SWTABLE_MAN_ENUM(SwStr1, SwStr2, EnumArray, ValueRetPtr, HelpStr) \
     { SwStr1, SwStr2, MAN_SW, VALTYPE_ENUM, MAN_VALUE, {.EnumStrArray=EnumArray}, {.pEnum=ValueRetPtr}, HelpStr},
 
+/**
+  SWTABLE_OPT_DECLIST - Adds an optional decimal list switch to table
+  SWTABLE_MAN_DECLIST - Adds a mandatory decimal list switch to table
+  SWTABLE_OPT_HEXLIST - Adds an optional hexidecimal list switch to table
+  SWTABLE_MAN_HEXLIST - Adds a mandatory hexidecimal list switch to table
+  SWTABLE_OPT_INTLIST - Adds an optional integer (decimal or hex) list switch to table
+  SWTABLE_MAN_INTLIST - Adds a mandatory integer (decimal or hex) list switch to table
+
+  A list switch may be repeated and each value may be a comma separated
+  list, e.g. "-a 0x1000 -a 0x2000,0x3000". Values are converted straight
+  into the caller's array. The shell parser (ParseCmdLine() without
+  NATIVE_PARSE) accepts a list switch only once.
+
+  SwStr1        Ptr to CHAR16 defining short switch name
+  SwStr2        Ptr to CHAR16 defining long switch name
+  ValueListPtr  Ptr to VALUE_LIST to hold values entered, see VALUE_LIST_INIT
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define SWTABLE_OPT_DECLIST(SwStr1, SwStr2, ValueListPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_DECLIST, MAN_VALUE, {0}, {.pList=ValueListPtr}, HelpStr},
+#define SWTABLE_MAN_DECLIST(SwStr1, SwStr2, ValueListPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_DECLIST, MAN_VALUE, {0}, {.pList=ValueListPtr}, HelpStr},
+#define SWTABLE_OPT_HEXLIST(SwStr1, SwStr2, ValueListPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_HEXLIST, MAN_VALUE, {0}, {.pList=ValueListPtr}, HelpStr},
+#define SWTABLE_MAN_HEXLIST(SwStr1, SwStr2, ValueListPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_HEXLIST, MAN_VALUE, {0}, {.pList=ValueListPtr}, HelpStr},
+#define SWTABLE_OPT_INTLIST(SwStr1, SwStr2, ValueListPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_INTLIST, MAN_VALUE, {0}, {.pList=ValueListPtr}, HelpStr},
+#define SWTABLE_MAN_INTLIST(SwStr1, SwStr2, ValueListPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_INTLIST, MAN_VALUE, {0}, {.pList=ValueListPtr}, HelpStr},
+
+/**
+  SWTABLE_OPT_HEXBLOB - Adds an optional hex data switch to table
+  SWTABLE_MAN_HEXBLOB - Adds a mandatory hex data switch to table
+
+  The value is decoded as for PARAMTABLE_HEXBLOB.
+
+  SwStr1        Ptr to CHAR16 defining short switch name
+  SwStr2        Ptr to CHAR16 defining long switch name
+  ValueBlobPtr  Ptr to VALUE_BLOB to hold data entered, see VALUE_BLOB_INIT
+  HelpStr       Ptr to CHAR16 help string for parameter
+**/
+#define SWTABLE_OPT_HEXBLOB(SwStr1, SwStr2, ValueBlobPtr, HelpStr) \
+    { SwStr1, SwStr2, OPT_SW, VALTYPE_HEXBLOB, MAN_VALUE, {0}, {.pBlob=ValueBlobPtr}, HelpStr},
+#define SWTABLE_MAN_HEXBLOB(SwStr1, SwStr2, ValueBlobPtr, HelpStr) \
+    { SwStr1, SwStr2, MAN_SW, VALTYPE_HEXBLOB, MAN_VALUE, {0}, {.pBlob=ValueBlobPtr}, HelpStr},
+
+/**
+  VALUE_LIST_INIT - Initialises a VALUE_LIST for a list switch
+
+  Array         UINTN array to hold values entered
+**/
+#define VALUE_LIST_INIT(Array) \
+    {Array, ARRAY_SIZE(Array), 0}
+
+/**
+  VALUE_BLOB_INIT - Initialises a VALUE_BLOB for a hex data parameter or switch
+
+  Array         UINT8 array to hold data entered
+**/
+#define VALUE_BLOB_INIT(Array) \
+    {Array, sizeof(Array), 0}
+
+/**
+  VALUE_STRVIEW_INIT - Initialises a VALUE_STRVIEW to an empty view
+**/
+#define VALUE_STRVIEW_INIT \
+    {NULL, 0}
+
+/**
+  VALUE_CALLBACK_INIT - Initialises a VALUE_CALLBACK for a callback parameter
+
+  Handler       CMDLINE_VALUE_HANDLER called with each value
+  Context       Ptr passed to Handler
+**/
+#define VALUE_CALLBACK_INIT(Handler, Context) \
+    {Handler, Context, 0}
+
 /**
   SWTABLE_END -Ends the switch table
 **/
 #define SWTABLE_END \
     {NULL,NULL,NO_SW,VALTYPE_NONE,FALSE,{0},{0},NULL}};
 
+/**
+  SWTABLE_END_EX - Ends the switch table, attaching a constraint table
+
+  ConstraintTable   Name of constraint table, see CONSTRAINTTABLE_START
+**/
+#define SWTABLE_END_EX(ConstraintTable) \
+    {NULL,NULL,NO_SW,VALTYPE_NONE,FALSE,{.Constraints=ConstraintTable},{0},NULL}};
+
+//-------------------------------------
+// Constraint Table Macros
+//-------------------------------------
+
+/**
+  CONSTRAINTTABLE_START - Begins the constraint table
+
+  Constraints name switches of the switch table by either of their names
+  (at most CONSTRAINT_MAX_NAMES each) and are checked once all arguments
+  have been parsed. A subcommand's constraints replace the global ones.
+
+  ArrayName     Defines name of constraint table
+**/
+#define CONSTRAINTTABLE_START(ArrayName) \
+    SWITCH_CONSTRAINT ArrayName[] = {
+
+/**
+  CONSTRAINTTABLE_ONE_OF - Exactly one of the switches must be given
+
+  ...           Ptrs to CHAR16 switch names
+**/
+#define CONSTRAINTTABLE_ONE_OF(...) \
+    {ONE_OF_SW, {__VA_ARGS__, NULL}},
+
+/**
+  CONSTRAINTTABLE_EXCLUSIVE - At most one of the switches may be given
+
+  ...           Ptrs to CHAR16 switch names
+**/
+#define CONSTRAINTTABLE_EXCLUSIVE(...) \
+    {EXCLUSIVE_SW, {__VA_ARGS__, NULL}},
+
+/**
+  CONSTRAINTTABLE_ANY_OF - At least one of the switches must be given
+
+  ...           Ptrs to CHAR16 switch names
+**/
+#define CONSTRAINTTABLE_ANY_OF(...) \
+    {ANY_OF_SW, {__VA_ARGS__, NULL}},
+
+/**
+  CONSTRAINTTABLE_REQUIRES - If the first switch is given all the others must be
+
+  SwStr         Ptr to CHAR16 name of switch
+  ...           Ptrs to CHAR16 names of the switches it requires
+**/
+#define CONSTRAINTTABLE_REQUIRES(SwStr, ...) \
+    {REQUIRES_SW, {SwStr, __VA_ARGS__, NULL}},
+
+/**
+  CONSTRAINTTABLE_END - Ends the constraint table
+**/
+#define CONSTRAINTTABLE_END \
+    {NO_CONSTRAINT, {NULL}}};
+
 //-------------------------------------
 // Enum to String Table Macros
 //-------------------------------------
@@ -222,18 +507,104 @@
 #define ENUMSTR_END \
     {0,NULL}};
 
+/**
+  ENUMSTR_END_EX - Ends the Enum to String array with lookup options
+
+  CmdLineCompile() indexes every enum array by upper cased name, so a
+  compiled parser binary searches any array. The other parsers search
+  an ENUMSTR_SORTED array by binary search and others linearly.
+
+  Flags         Lookup options (bit values to be ORed)
+                    ENUMSTR_SORTED  entries are in ascending case-insensitive
+                                    order so are binary searched (order is
+                                    checked by CmdLineValidateTables())
+                    ENUMSTR_PREFIX  accept a unique prefix of an entry
+**/
+#define ENUMSTR_END_EX(Flags) \
+    {Flags,NULL}};
+
+//-------------------------------------
+// Subcommand Table Macros
+//-------------------------------------
+
+/**
+  SUBCMDTABLE_START - Begins the subcommand table
+
+  ArrayName     Defines name of subcommand table
+**/
+#define SUBCMDTABLE_START(ArrayName) \
+    SUBCMD_TABLE ArrayName[] = {
+
+/**
+  SUBCMDTABLE_ENTRY - Adds a subcommand to the table
+
+  Name          Command name, given as the first argument
+  ManParamCount Number of mandatory parameters required
+  ParamTable    Ptr to PARAMETER_TABLE of the command (may be NULL)
+  SwTable       Ptr to SWITCH_TABLE of the command (may be NULL)
+  Handler       Function called once the command is parsed (optional)
+  HelpStr       Ptr to help string for command
+**/
+#define SUBCMDTABLE_ENTRY(Name, ManParamCount, ParamTable, SwTable, Handler, HelpStr) \
+    {Name, ManParamCount, ParamTable, SwTable, Handler, HelpStr},
+
+/**
+  SUBCMDTABLE_END - Ends the subcommand table
+**/
+#define SUBCMDTABLE_END \
+    {NULL,0,NULL,NULL,NULL,NULL}};
+
+/**
+  SUBCMDTABLE_END_EX - Ends the subcommand table with lookup options
+
+  Flags         Lookup options (bit values to be ORed)
+                    SUBCMD_SORTED   entries are in ascending case-insensitive
+                                    order so are binary searched
+**/
+#define SUBCMDTABLE_END_EX(Flags) \
+    {NULL,Flags,NULL,NULL,NULL,NULL}};
+
 //-------------------------------------
 // Defines
 //-------------------------------------
 
+// Enum to String array lookup options
+#define ENUMSTR_SORTED  0x0001
+#define ENUMSTR_PREFIX  0x0002
+
+// Subcommand table lookup options
+#define SUBCMD_SORTED   0x0001
+
 // Functional options
 #define NO_HELP         0x0001
 #define FORCE_BREAK     0x0002
+#define NATIVE_PARSE    0x0004
+#define QUIET_ERRORS    0x0008
+#define PHASE_TIMING    0x0010
+#define PREFIX_SWITCHES 0x0020
+#define LAZY_VALUES     0x0040
+
+// Upper bound of arena size (bytes) required by ParseCmdLineArena() for
+// a switch table with SwCount entries, so an arena can be sized statically
+#define CMDLINE_ARENA_SIZE(SwCount) \
+    ((SWBITS_WORDS(SwCount) * 2 * sizeof(UINTN)) + \
+     ((((SwCount)*2) + 4) * 4 * sizeof(SWITCH_INDEX_SLOT)))
 
 //-------------------------------------
 // Functions
 //-------------------------------------
 
+/**
+  CMDLINE_REPL_HANDLER - Called by CmdLineRepl() after each command
+                         line is parsed successfully
+
+  Context       Ptr passed to CmdLineRepl()
+  NumParams     Number of parameters entered
+
+  Returns       SHELL_ABORTED to end the loop, any other value continues
+**/
+typedef SHELL_STATUS (EFIAPI *CMDLINE_REPL_HANDLER)(IN VOID *Context, IN UINTN NumParams);
+
 /**
   ParseCmdLine - Parses the command line
   
@@ -247,14 +618,359 @@
   FuncOpt       Functional options (bit values to be ORed)
                     NO_HELP         no command line help
                     FORCE_BREAK     force the line break option
+                    NATIVE_PARSE    single pass tokenizer instead of ShellCommandLineParseEx()
+                    QUIET_ERRORS    do not print errors (help is still shown)
+                    PHASE_TIMING    time each phase, see CmdLineGetPhaseTimes()
+                    PREFIX_SWITCHES accept a unique prefix of a long switch
+                                    (e.g. -col for -colour), native tokenizer only,
+                                    the shell parser fails with a table error
+                    LAZY_VALUES     convert values on request, compiled parsers
+                                    only, see CmdLineGetValue()
   NumParams     Ptr to return the number of parameter entered (optional)
   
   Returns       SHELL_SUCCESS if all parameters/switches are valid
                 SHELL_INVALID_PARAMETER if problem encountered with parameter/switches passed on cmd line
                 SHELL_OUT_OF_RESOURCES if internal memory error
                 SHELL_ABORTED if help displayed
+                SHELL_UNSUPPORTED if the shell parser is given a STRVIEW
+                row or PREFIX_SWITCHES (table error), use NATIVE_PARSE
 **/
 extern SHELL_STATUS ParseCmdLine(IN CONST CHAR16 *ProgName, IN UINTN ManParmCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams);
 
+/**
+  ParseCmdLineEx - Parses the command line and returns error details
+
+  Same as ParseCmdLine() but also fills in an error record describing
+  why the parse failed, so the caller can report or handle it. Combine
+  with QUIET_ERRORS to stop errors being printed. When the shell parser
+  is used, ArgIndex is found from the position of the argument, a switch
+  name is then the one from the table and a value or parameter points
+  into the shell's Argv (NULL if it was not found). An ambiguous switch
+  prefix is printed with the switches it matches, Row is the first of
+  these in the table.
+  
+  ProgName .. NumParams   As ParseCmdLine()
+  Error         Ptr to return error details (optional), Code is
+                CMDLINE_ERR_NONE on success and CMDLINE_ERR_HELP if
+                help was displayed
+  
+  Returns       As ParseCmdLine()
+**/
+extern SHELL_STATUS ParseCmdLineEx(IN CONST CHAR16 *ProgName, IN UINTN ManParmCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error);
+
+/**
+  ParseCmdLineArena - Parses the command line without allocating memory
+
+  Same as ParseCmdLine() using the native tokenizer, all working storage
+  is taken from the caller supplied arena so no pool memory is allocated
+  by the parser. The size required depends only on the tables, call with
+  ArenaSize 0 to query it or use CMDLINE_ARENA_SIZE() to size statically.
+  
+  ProgName .. NumParams   As ParseCmdLine()
+  Arena         Ptr to UINTN aligned scratch buffer (NULL if ArenaSize is 0)
+  ArenaSize     Size of above buffer in bytes
+  ArenaRequired Ptr to return the arena size required in bytes (optional)
+  
+  Returns       As ParseCmdLine() plus
+                SHELL_BUFFER_TOO_SMALL if arena too small (nothing parsed)
+                SHELL_UNSUPPORTED if there is no shell parameters protocol
+                (EFI shell 1.0) to read the command line from, nothing is
+                parsed but ArenaRequired is returned
+**/
+extern SHELL_STATUS ParseCmdLineArena(IN CONST CHAR16 *ProgName, IN UINTN ManParmCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT UINTN *NumParams, IN VOID *Arena, IN UINTN ArenaSize, OUT UINTN *ArenaRequired);
+
+/**
+  CmdLineCompile - Prepares the tables for repeated parsing
+
+  Does the table counting, checking, indexing and allocation that each
+  ParseCmdLine() call would otherwise repeat, so many argument vectors
+  can then be parsed cheaply with CmdLineParseArgs(). The tables must
+  remain valid until CmdLineFree() is called. Compiled parsers always
+  use the native tokenizer.
+  
+  ProgName .. FuncOpt     As ParseCmdLine()
+  Parser        Ptr to return the compiled parser handle
+  
+  Returns       SHELL_SUCCESS if parser compiled
+                SHELL_INVALID_PARAMETER if problem found in the tables
+                SHELL_OUT_OF_RESOURCES if internal memory error
+**/
+extern SHELL_STATUS CmdLineCompile(IN CONST CHAR16 *ProgName, IN UINTN ManParmCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, OUT CMDLINE_PARSER **Parser);
+
+/**
+  CmdLineParseArgs - Parses an argument vector with a compiled parser
+
+  Parser        Handle returned by CmdLineCompile()
+  Argc          Number of entries in Argv
+  Argv          Ptr to array of CHAR16 argument strings, Argv[0] is the
+                program or command name and is ignored
+  NumParams     Ptr to return the number of parameter entered (optional)
+  Error         Ptr to return error details (optional), see ParseCmdLineEx()
+  
+  Returns       As ParseCmdLine()
+**/
+extern SHELL_STATUS CmdLineParseArgs(IN CMDLINE_PARSER *Parser, IN UINTN Argc, IN CHAR16 **Argv, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error);
+
+/**
+  CmdLinePrintError - Prints the message for an error record
+
+  Prints the same message the parser prints when QUIET_ERRORS is not
+  set, nothing is printed for CMDLINE_ERR_NONE or CMDLINE_ERR_HELP.
+  
+  ProgName      Name of shell app
+  Error         Ptr to error record returned by the parser
+**/
+extern VOID CmdLinePrintError(IN CONST CHAR16 *ProgName, IN CONST CMDLINE_ERROR *Error);
+
+/**
+  CmdLineGetPhaseTimes - Returns the time spent in each phase of parsing
+
+  Parses made with the PHASE_TIMING functional option accumulate
+  performance counter ticks for each phase (see CMDLINE_PHASE). The
+  native tokenizer converts values as it goes, so its parameter and
+  switch work is counted in CMDLINE_PHASE_TOKENIZE. Compiled parsers
+  do their table and list work in CmdLineCompile(), which is not timed.
+  When performance measurement is enabled each phase is also logged
+  with PERF_START/PERF_END using tokens "CmdLineTables" etc.
+  
+  Times         Ptr to return the accumulated times (optional)
+  Reset         TRUE to clear the accumulated times
+**/
+extern VOID CmdLineGetPhaseTimes(OUT CMDLINE_PHASE_TIMES *Times, IN BOOLEAN Reset);
+
+/**
+  CmdLineGetValue - Returns a value parsed by a compiled parser
+
+  If the parser was compiled with LAZY_VALUES, CmdLineParseArgs() only
+  checks the command line and records where each value is. Values are
+  converted into their return variables when first requested here, so
+  values that are never requested cost nothing, and later requests
+  return at once. Value errors are reported here rather than by the
+  parse. Flags and list switches are still set by the parse. Argv
+  must remain valid until the values have been requested. Without
+  LAZY_VALUES values are converted by the parse and this only reports
+  whether they were given.
+  
+  Parser        Handle passed to CmdLineParseArgs()
+  ValueRetPtr   Return variable of a parameter or switch, as given in
+                its table entry
+  Error         Ptr to return error details (optional), see ParseCmdLineEx()
+  
+  Returns       SHELL_SUCCESS if value given and valid (variable updated)
+                SHELL_NOT_FOUND if not given (variable unchanged)
+                SHELL_INVALID_PARAMETER if value invalid or ValueRetPtr
+                not in the tables
+**/
+extern SHELL_STATUS CmdLineGetValue(IN CMDLINE_PARSER *Parser, IN VOID *ValueRetPtr, OUT CMDLINE_ERROR *Error);
+
+/**
+  CmdLineGetUintn/Intn/Uint64/String/StrView/Enum - Typed CmdLineGetValue()
+
+  Value         Return variable of a parameter or switch of a matching
+                type, any other is not written:
+                    Uintn   DEC, HEX, INT and flags with a value
+                    Intn    SINT
+                    Uint64  DEC64, HEX64, INT64
+                    String  STR
+                    StrView STRVIEW
+                    Enum    ENUM
+
+  Returns       As CmdLineGetValue(), SHELL_INVALID_PARAMETER if the
+                table type does not match
+**/
+extern SHELL_STATUS CmdLineGetUintn(IN CMDLINE_PARSER *Parser, IN OUT UINTN *Value);
+extern SHELL_STATUS CmdLineGetIntn(IN CMDLINE_PARSER *Parser, IN OUT INTN *Value);
+extern SHELL_STATUS CmdLineGetUint64(IN CMDLINE_PARSER *Parser, IN OUT UINT64 *Value);
+extern SHELL_STATUS CmdLineGetString(IN CMDLINE_PARSER *Parser, IN OUT CHAR16 *Value);
+extern SHELL_STATUS CmdLineGetStrView(IN CMDLINE_PARSER *Parser, IN OUT VALUE_STRVIEW *Value);
+extern SHELL_STATUS CmdLineGetEnum(IN CMDLINE_PARSER *Parser, IN OUT unsigned int *Value);
+
+/**
+  CmdLineResultCreate - Creates a result for CmdLineParseResult()
+
+  Parser        Handle returned by CmdLineCompile()
+  Result        Ptr to return the result handle
+  
+  Returns       SHELL_SUCCESS if result created
+                SHELL_INVALID_PARAMETER if Parser or Result is NULL
+                SHELL_OUT_OF_RESOURCES if internal memory error
+**/
+extern SHELL_STATUS CmdLineResultCreate(IN CMDLINE_PARSER *Parser, OUT CMDLINE_RESULT **Result);
+
+/**
+  CmdLineParseResult - Parses an argument vector into a result
+
+  Reentrant form of CmdLineParseArgs(). Everything the parse writes is
+  kept in Result, the parser and the tables are only read, so parses
+  with different results may share a parser and run at the same time.
+  This and CmdLineResultGetValue() allocate nothing, print nothing and
+  use no shell or global state (a callback row's handler is run by the
+  getter, in the caller's context): errors are only returned (see
+  CmdLinePrintError()), help is not shown (Error Code is
+  CMDLINE_ERR_HELP), the break switch is accepted but page break mode
+  is left alone and PHASE_TIMING is ignored. Compiling the parser and
+  creating and freeing results do allocate, so do those on one
+  processor (e.g. the BSP) before and after the parses. Values,
+  including flags and lists, are fetched with CmdLineResultGetValue().
+  
+  Result        Handle returned by CmdLineResultCreate(), not in use by
+                another parse
+  Argc .. Error As CmdLineParseArgs()
+  
+  Returns       As ParseCmdLine(), value errors are returned by
+                CmdLineResultGetValue()
+**/
+extern SHELL_STATUS CmdLineParseResult(IN CMDLINE_RESULT *Result, IN UINTN Argc, IN CHAR16 **Argv, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error);
+
+/**
+  CmdLineResultGetValue - Converts a value of the last CmdLineParseResult()
+
+  Converts from the argument vector each time it is called, so Argv
+  must remain valid and several threads may read one result.
+  
+  Result        Handle passed to CmdLineParseResult()
+  ValueRetPtr   Return variable of a parameter or switch, as given in
+                its table entry, identifies the entry and is not written
+  Value         Ptr to variable of the same type to hold the value: a
+                BOOLEAN (UINTN for flags with a value), a CHAR16 string
+                of the table's StrSize, a VALUE_LIST/VALUE_BLOB with
+                its own array, or a VALUE_CALLBACK with its own handler
+  Error         Ptr to return error details (optional), see ParseCmdLineEx()
+  
+  Returns       As CmdLineGetValue()
+**/
+extern SHELL_STATUS CmdLineResultGetValue(IN CMDLINE_RESULT *Result, IN VOID *ValueRetPtr, OUT VOID *Value, OUT CMDLINE_ERROR *Error);
+
+/**
+  CmdLineResultFree - Frees a result
+
+  Result        Handle returned by CmdLineResultCreate() (may be NULL)
+**/
+extern VOID CmdLineResultFree(IN CMDLINE_RESULT *Result);
+
+/**
+  CmdLineValidateTables - Checks the parameter and switch tables
+
+  The parsers trust the tables, so this checks every row once: value
+  types, return pointers, string sizes, enum arrays (and the order of
+  sorted ones), switch names and the switch count. Switch names must
+  not be used twice (names match case-insensitively) nor clash with the
+  help (-h, -help) or break (-b, -break) switches that FuncOpt enables,
+  nor start with a digit when there is a SINT row (see PARAMTABLE_SINT).
+  CmdLineCompile() calls this, the other parsers do not check the tables
+  on each call so apps should call this once (e.g. in debug builds).
+  Problems are printed unless QUIET_ERRORS is set.
+  
+  ProgName      Name of shell app
+  ParamTable    Ptr to PARAMETER_TABLE (may be NULL)
+  SwTable       Ptr to SWITCH_TABLE (may be NULL)
+  FuncOpt       Functional options as passed to the parser
+  Error         Ptr to return error details (optional), Code is
+                CMDLINE_ERR_TABLE, Row is the table row and Arg the
+                switch name at fault (if any)
+  
+  Returns       SHELL_SUCCESS if the tables are valid
+                SHELL_INVALID_PARAMETER if problem found in the tables
+                SHELL_OUT_OF_RESOURCES if too many switches or internal memory error
+**/
+extern SHELL_STATUS CmdLineValidateTables(IN CONST CHAR16 *ProgName, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error);
+
+/**
+  CmdLineFree - Frees a compiled parser
+
+  Parser        Handle returned by CmdLineCompile() (may be NULL)
+**/
+extern VOID CmdLineFree(IN CMDLINE_PARSER *Parser);
+
+/**
+  CmdLineRepl - Reads and parses command lines from the console until
+                'exit' or 'quit' (any case) is entered
+
+  Each line is split with CmdLineSplitLine() and parsed with
+  CmdLineParseArgs(), errors and help are reported as usual and the
+  loop continues. Before each line the return variables written by the
+  previous line are restored to the values they held on entry, so flags
+  and values do not carry over between commands.
+  
+  Parser        Handle returned by CmdLineCompile()
+  Prompt        Ptr to prompt string, NULL for "ProgName> "
+  Handler       Function called after each successful parse (optional)
+  Context       Ptr passed to Handler (optional)
+  
+  Returns       SHELL_SUCCESS when the loop ends
+                SHELL_OUT_OF_RESOURCES if internal memory error
+                SHELL_DEVICE_ERROR if the console could not be read
+**/
+extern SHELL_STATUS CmdLineRepl(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Prompt, IN CMDLINE_REPL_HANDLER Handler, IN VOID *Context);
+
+/**
+  CmdLineSplitLine - Splits a line into arguments using shell quoting
+
+  Arguments are separated by spaces or tabs. Double quotes group text
+  containing spaces and are removed, '^' makes a following special
+  character (^ " # % | < > space tab) literal and '#' at the start of
+  an argument begins a comment. Line is modified in place and Argv
+  entries point into it.
+  
+  Line          Ptr to CHAR16 line to split
+  Argv          Ptr to array to return argument pointers
+  MaxArgs       Number of entries in Argv
+  Argc          Ptr to return the number of arguments
+  
+  Returns       SHELL_SUCCESS if line split
+                SHELL_INVALID_PARAMETER if a quote is not closed
+                SHELL_BUFFER_TOO_SMALL if more than MaxArgs arguments
+**/
+extern SHELL_STATUS CmdLineSplitLine(IN OUT CHAR16 *Line, OUT CHAR16 **Argv, IN UINTN MaxArgs, OUT UINTN *Argc);
+
+/**
+  CmdLineDispatch - Parses the command line of an app with subcommands
+
+  The first argument names the subcommand (e.g. "tool add -v file")
+  and only that subcommand's tables are processed, so one app can hold
+  many commands. Global switches are shared by all subcommands and may
+  be given before or after the name (before it only global switches are
+  accepted, with PREFIX_SWITCHES also by a prefix unique among them), in
+  error records their rows follow the subcommand's switch rows. Names match case-insensitively. Messages
+  and help name the subcommand ("tool add"), "tool -h" lists the
+  subcommands and "tool add -h" shows the help of one. Subcommands are
+  always parsed with the native tokenizer.
+  
+  ProgName      Name of shell app
+  SubCmdTable   Ptr to SUBCMD_TABLE defining the subcommands
+  GlobalSwTable Ptr to SWITCH_TABLE of switches shared by all subcommands
+                If no global switches required set this to NULL
+  ProgHelpStr   Ptr to help string for program
+  FuncOpt       Functional options as ParseCmdLine()
+  Argc          Number of entries in Argv
+  Argv          Ptr to array of CHAR16 argument strings as passed to
+                ShellAppMain(), Argv[0] is ignored
+  Context       Ptr passed to the subcommand handler (optional)
+  Error         Ptr to return error details (optional), see ParseCmdLineEx()
+  
+  Returns       Value returned by the subcommand handler, SHELL_SUCCESS
+                if it has none, otherwise as ParseCmdLine()
+**/
+extern SHELL_STATUS CmdLineDispatch(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN CHAR16 *ProgHelpStr, IN UINT16 FuncOpt, IN UINTN Argc, IN CHAR16 **Argv, IN VOID *Context, OUT CMDLINE_ERROR *Error);
+
+/**
+  CmdLineValidateSubCmds - Checks the tables of an app with subcommands
+
+  As CmdLineValidateTables() for each subcommand together with the global
+  switches, also checks the order of a sorted subcommand table.
+  CmdLineDispatch() trusts the tables, so call this once (e.g. in debug
+  builds) rather than before each dispatch.
+  
+  ProgName      Name of shell app
+  SubCmdTable   Ptr to SUBCMD_TABLE defining the subcommands
+  GlobalSwTable Ptr to SWITCH_TABLE of global switches (may be NULL)
+  FuncOpt       Functional options as passed to CmdLineDispatch()
+  Error         Ptr to return error details (optional), as
+                CmdLineValidateTables(), messages name the subcommand
+  
+  Returns       As CmdLineValidateTables()
+**/
+extern SHELL_STATUS CmdLineValidateSubCmds(IN CONST CHAR16 *ProgName, IN SUBCMD_TABLE *SubCmdTable, IN SWITCH_TABLE *GlobalSwTable, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error);
+
 
 #endif // CMD_LINE_H
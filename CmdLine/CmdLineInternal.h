@@ -14,8 +14,18 @@
 
 // Types
 typedef enum { NO_SW, OPT_SW, MAN_SW, HELP_SW } SWITCH_NECESSITY;
-typedef enum { VALTYPE_NONE, VALTYPE_STRING, VALTYPE_DECIMAL, VALTYPE_HEXIDECIMAL, VALTYPE_INTEGER, VALTYPE_ENUM } VALUE_TYPE;
+typedef enum { VALTYPE_NONE, VALTYPE_STRING, VALTYPE_DECIMAL, VALTYPE_HEXIDECIMAL, VALTYPE_INTEGER, VALTYPE_ENUM,
+               VALTYPE_SIGNED, VALTYPE_DEC64, VALTYPE_HEX64, VALTYPE_INT64,
+               VALTYPE_DECLIST, VALTYPE_HEXLIST, VALTYPE_INTLIST, VALTYPE_HEXBLOB, VALTYPE_STRVIEW,
+               VALTYPE_CALLBACK } VALUE_TYPE;
 typedef enum { NO_VALUE, OPT_VALUE, MAN_VALUE } VALUE_NECESSITY;
+typedef enum { VALUE_OK, VALUE_INVALID, VALUE_OVERFLOW, VALUE_LIST_FULL, VALUE_ODD_DIGITS, VALUE_TOO_LONG } VALUE_STATUS;
+
+// List switches may be repeated and take comma separated values
+#define VALTYPE_IS_LIST(ValueType)  ((ValueType) >= VALTYPE_DECLIST && (ValueType) <= VALTYPE_INTLIST)
+
+// A list or callback as the last parameter takes all remaining parameters
+#define VALTYPE_IS_VARIADIC(ValueType)  (VALTYPE_IS_LIST(ValueType) || (ValueType) == VALTYPE_CALLBACK)
 
 // Struct to hold mapping of enum value to string for use with enum parameters and switches
 typedef struct {
@@ -23,19 +33,103 @@ typedef struct {
     UINT16 *Str;
 } ENUM_STR_ARRAY;
 
+// Caller storage for list switches, values are appended to Values in
+// command line order. Count is reset when the switch is first seen so
+// is left as is if the switch is not present.
+typedef struct {
+    UINTN *Values;
+    UINTN MaxCount;     // entries in Values
+    UINTN Count;        // entries used
+} VALUE_LIST;
+
+// Caller storage for hex blobs, each pair of hex digits is decoded to a
+// byte of Buffer. Buffer and Size are left as is unless the whole value
+// is valid.
+typedef struct {
+    UINT8 *Buffer;
+    UINTN MaxSize;      // bytes in Buffer
+    UINTN Size;         // bytes decoded
+} VALUE_BLOB;
+
+// Caller storage for string views, Str points into the argument string
+// itself so is only valid for as long as Argv is. Left as is if the
+// value is not given.
+typedef struct {
+    CONST CHAR16 *Str;
+    UINTN Length;       // characters, excluding terminator
+} VALUE_STRVIEW;
+
+// Called with each value of a callback parameter in command line order,
+// Index counts from 0. Value is only valid for the duration of the call.
+// Any status other than SHELL_SUCCESS rejects the value.
+typedef SHELL_STATUS (EFIAPI *CMDLINE_VALUE_HANDLER)(IN VOID *Context, IN UINTN Index, IN CONST CHAR16 *Value);
+
+// Caller storage for callback parameters, Count is reset when the first
+// value is given so is left as is if there are none.
+typedef struct {
+    CMDLINE_VALUE_HANDLER Handler;
+    VOID *Context;
+    UINTN Count;        // values passed to Handler
+} VALUE_CALLBACK;
+
+// Digit classification a word at a time (SWAR), each UINTN holds
+// SWAR_LANES characters in 16 bit lanes. Lane tests need ASCII lanes,
+// so that adding up to 0x8000 carries into the top bit of the lane only.
+#define SWAR_LANES          (sizeof(UINTN) / sizeof(CHAR16))
+#define SWAR_ONES           (MAX_UINTN / 0xFFFF)    // 1 in each lane
+#define SWAR_HIGH           (SWAR_ONES * 0x8000)    // top bit of each lane
+#define SWAR_NOT_ASCII      (SWAR_ONES * 0xFF80)
+#define SWAR_LOWER          (SWAR_ONES * 0x0020)    // folds letters to lower case
+#define SWAR_GE(Word, Lo)   (((Word) + (SWAR_ONES * (0x8000 - (Lo)))) & SWAR_HIGH)
+#define SWAR_IN(Word, Lo, Hi)   (SWAR_GE(Word, Lo) & ~SWAR_GE(Word, (Hi) + 1))
+#define SWAR_DEC_RADIX      ((sizeof(UINTN) == 8) ? 10000 : 100)    // 10^SWAR_LANES
+#define SWAR_HEX_RADIX      ((UINTN)1 << (SWAR_LANES * 4))          // 16^SWAR_LANES
+
+// Evaluates to Value, fails to compile if the constant Expr is false
+#define TABLE_CHECK(Expr, Value)    ((Value) + 0*sizeof(CHAR8[(Expr) ? 1 : -1]))
+
+//---------------------------
+// Switch constraints
+//---------------------------
+typedef enum {
+    NO_CONSTRAINT,  // ends the constraint table
+    ONE_OF_SW,      // exactly one of the switches
+    EXCLUSIVE_SW,   // at most one of the switches
+    ANY_OF_SW,      // at least one of the switches
+    REQUIRES_SW     // first switch requires all the others
+} CONSTRAINT_TYPE;
+
+#define CONSTRAINT_MAX_NAMES    8
+
+typedef struct {
+    CONSTRAINT_TYPE Type;
+    CHAR16 *Names[CONSTRAINT_MAX_NAMES + 1];    // switch names, NULL terminated
+} SWITCH_CONSTRAINT;
+
+// Compiled constraint: row of the first switch, then a bitset of the
+// switches tested (for REQUIRES_SW all but the first)
+#define CONSTRAINT_RECORD_WORDS(Words)  (1 + (Words))
+
 // Misc data used for both parameters and switches
 typedef union {
     ENUM_STR_ARRAY *EnumStrArray;
     UINTN MaxStrSize;
     UINTN FlagValue;
+    SWITCH_CONSTRAINT *Constraints;     // table terminator only
 } DATA;
 
 // Ptr to return value
 typedef union {
     BOOLEAN *pBoolean;
     UINTN *pUintn;
+    INTN *pIntn;
+    UINT64 *pUint64;
     CHAR16 *pChar16;
     unsigned int *pEnum;
+    VALUE_LIST *pList;
+    VALUE_BLOB *pBlob;
+    VALUE_STRVIEW *pView;
+    VALUE_CALLBACK *pCallback;
     VOID *pVoid;
 } VALUE_RET_PTR;
 
@@ -57,7 +151,7 @@ typedef struct {
 //---------------------------
 // Switch table
 //---------------------------
-#define MAX_SWITCH_ENTRIES  30
+#define MAX_SWITCH_ENTRIES  0xFFF0  // rows are held as UINT16 in the name index
 
 typedef struct {
     CHAR16 *SwStr1; // short switch
@@ -75,4 +169,256 @@ typedef struct {
         { SwStr1, SwStr2, SwitchNeccessity, ValueType, ValueNecessity, EnumArray, {.pVoid=ValueRetPtr}, HelpStr },
 
 
+//---------------------------
+// Switch name index
+//---------------------------
+
+// Open addressed hash table of switch names (both short and long) built
+// from a switch table, slot count is always a power of 2
+typedef struct {
+    UINT32 Hash;    // hash of case folded name, 0 = empty slot
+    UINT16 Row;     // switch table row, or SW_ROW_HELP/SW_ROW_BREAK
+    UINT16 Unused;
+} SWITCH_INDEX_SLOT;
+
+#define SW_ROW_HELP         0xFFFE
+#define SW_ROW_BREAK        0xFFFD
+STATIC_ASSERT(MAX_SWITCH_ENTRIES < SW_ROW_BREAK, "switch rows must fit below the reserved index rows");
+#define SW_INDEX_MIN_NAMES  16      // smaller tables are searched linearly
+#define SW_INDEX_MIN_ARGS   4       // as are short command lines
+
+// Rows (or SW_ROW_HELP/SW_ROW_BREAK) in ascending case-insensitive order
+// of long switch name, binary searched for the unique prefix of a name
+// by compiled parsers (a single parse scans the table)
+#define SW_PREFIX_SIZE(SwCount) ALIGN_VALUE(((SwCount) + 2) * sizeof(UINT16), sizeof(UINTN))
+
+
+//---------------------------
+// Switch records
+//---------------------------
+
+// The fields of a switch table row the parse loop reads, packed by
+// CmdLineCompile() with the names copied to a pool so large tables
+// are scanned a few cache lines at a time. Help text, enum strings and
+// return pointers are only read from the table when needed.
+typedef struct {
+    UINT16 Name1;       // pool offset of short name, SW_NO_NAME if none
+    UINT16 Name2;       // pool offset of long name, SW_NO_NAME if none
+    UINT8 ValueType;    // VALUE_TYPE
+    UINT8 Flags;        // SW_REC_xxx
+    UINT16 Unused;
+} SWITCH_RECORD;
+
+STATIC_ASSERT(sizeof(SWITCH_RECORD) == 8, "switch records must stay packed");
+
+#define SW_NO_NAME          0xFFFF  // also the pool size limit in characters
+#define SW_REC_MAN_VALUE    0x01    // value must be given
+#define SW_REC_FLAG_VALUE   0x02    // flag sets a UINTN value rather than a BOOLEAN
+#define SW_REC_LIST         0x04    // list switch, may be repeated
+
+
+//---------------------------
+// Switch bitsets
+//---------------------------
+
+// One bit per switch table row, used for presence and mandatory flags
+#define SWBITS_PER_WORD         (sizeof(UINTN)*8)
+#define SWBITS_WORDS(Count)     (((Count) + SWBITS_PER_WORD - 1) / SWBITS_PER_WORD)
+#define SWBIT_SET(Bits, i)      ((Bits)[(i) / SWBITS_PER_WORD] |= ((UINTN)1 << ((i) % SWBITS_PER_WORD)))
+#define SWBIT_TEST(Bits, i)     ((((Bits)[(i) / SWBITS_PER_WORD] >> ((i) % SWBITS_PER_WORD)) & 1) != 0)
+
+#define NATIVE_STACK_WORDS      64  // native parse working storage kept on stack if it fits
+
+// Value records of a LAZY_VALUES parser with Count switch rows and parameters,
+// an Argv index and a converted bit for each
+#define LAZY_RECORD_SIZE(Count) (((Count) + SWBITS_WORDS(Count)) * sizeof(UINTN))
+
+
+//---------------------------
+// Compiled parser
+//---------------------------
+
+// Enum entry name upper cased once by CmdLineCompile()
+typedef struct {
+    CONST CHAR16 *Name;         // in the parser's name pool
+    UINTN Entry;                // index in the enum array
+} ENUM_KEY;
+
+// Enum array of a value record, Keys are in name order (equal names in
+// array order) so any array is binary searched
+typedef struct {
+    UINTN Count;                // entries before the terminating entry
+    ENUM_KEY *Keys;             // NULL if the record is not an enum
+} ENUM_INDEX;
+
+// Everything the native parser derives from the tables. Built on the
+// stack for a single parse, or once by CmdLineCompile() and reused.
+typedef struct _CMDLINE_PARSER {
+    CONST CHAR16 *ProgName;
+    UINTN ManParamCount;
+    PARAMETER_TABLE *ParamTable;
+    SWITCH_TABLE *SwTable;
+    CHAR16 *ProgHelpStr;
+    UINT16 FuncOpt;
+    UINTN TableParamCount;
+    UINTN TableSwCount;
+    BOOLEAN Variadic;           // last parameter takes any number
+    BOOLEAN AllowNumbers;       // "-5" is a value, set if there is a SINT row
+    UINTN Words;                // words in each switch bitset
+    UINTN *PresentBits;
+    UINTN *MandatoryBits;
+    SWITCH_CONSTRAINT *Constraints;     // NULL if none
+    UINTN *ConstraintRecords;   // NULL if evaluated by name (single parse)
+    SWITCH_INDEX_SLOT *Slots;   // NULL if switch names searched linearly
+    UINTN SlotCount;
+    UINT16 *PrefixRows;         // long name order, NULL unless compiled with PREFIX_SWITCHES
+    SWITCH_RECORD *Records;     // NULL if read from the table (single parse)
+    CHAR16 *NamePool;           // switch names the records point into
+    UINTN PrefixCount;          // entries in PrefixRows
+    UINTN *ValueArgs;           // Argv index of each value, switch rows then
+                                // parameters, NULL unless LAZY_VALUES set
+    UINTN *ConvertedBits;       // values converted since the last parse
+    ENUM_INDEX *EnumIndex;      // enum lookup of each value record, as
+                                // ValueArgs, NULL unless compiled with enum rows
+    CHAR16 **Argv;              // argument vector of the last parse
+    UINTN ParamCount;           // parameters in the last parse
+    CHAR16 *HelpText;           // rendered help, kept if CacheHelp set
+    BOOLEAN CacheHelp;
+    BOOLEAN RecordOnly;         // only record where values are, see CmdLineParseResult()
+} CMDLINE_PARSER;
+
+// Everything one CmdLineParseResult() call writes, so parses with
+// different results can share a compiled parser
+typedef struct _CMDLINE_RESULT {
+    CMDLINE_PARSER *Parser;
+    UINTN *PresentBits;
+    UINTN *ValueArgs;           // as CMDLINE_PARSER, list switches record the first value
+    UINTN *ConvertedBits;
+    UINTN Argc;                 // argument vector of the last parse
+    CHAR16 **Argv;
+    UINTN ParamCount;
+} CMDLINE_RESULT;
+
+#define REPL_LINE_SIZE      256     // characters per console line
+#define REPL_MAX_ARGS       64      // arguments per console line
+
+
+//---------------------------
+// Subcommand table
+//---------------------------
+
+// Called by CmdLineDispatch() once the chosen subcommand is parsed
+typedef SHELL_STATUS (EFIAPI *CMDLINE_SUBCMD_HANDLER)(IN VOID *Context, IN UINTN NumParams);
+
+typedef struct {
+    CHAR16 *Name;               // first argument, NULL ends the table
+    UINTN ManParamCount;        // lookup options in the terminating entry
+    PARAMETER_TABLE *ParamTable;
+    SWITCH_TABLE *SwTable;
+    CMDLINE_SUBCMD_HANDLER Handler;
+    CHAR16 *HelpStr;
+} SUBCMD_TABLE;
+
+
+//---------------------------
+// Help text
+//---------------------------
+
+// Help is rendered twice, first with no buffer to measure it
+typedef struct {
+    CHAR16 *Buffer;
+    UINTN Len;
+} HELP_TEXT;
+
+#define HELP_ARGNAME_SIZE   24
+#define HELP_COLUMN_WIDTH   19  // minimum width of name columns
+
+
+//---------------------------
+// Parse errors
+//---------------------------
+typedef enum {
+    CMDLINE_ERR_NONE,
+    CMDLINE_ERR_UNKNOWN_SWITCH,
+    CMDLINE_ERR_AMBIGUOUS_SWITCH,
+    CMDLINE_ERR_DUPLICATE_SWITCH,
+    CMDLINE_ERR_SWITCH_NO_VALUE,
+    CMDLINE_ERR_SWITCH_VALUE,
+    CMDLINE_ERR_SWITCH_RANGE,
+    CMDLINE_ERR_SWITCH_LIST_FULL,
+    CMDLINE_ERR_SWITCH_ODD_DIGITS,
+    CMDLINE_ERR_SWITCH_TOO_LONG,
+    CMDLINE_ERR_PARAM_VALUE,
+    CMDLINE_ERR_PARAM_RANGE,
+    CMDLINE_ERR_PARAM_ODD_DIGITS,
+    CMDLINE_ERR_PARAM_TOO_LONG,
+    CMDLINE_ERR_PARAM_LIST_FULL,
+    CMDLINE_ERR_TOO_MANY_PARAMS,
+    CMDLINE_ERR_TOO_FEW_PARAMS,
+    CMDLINE_ERR_MISSING_SWITCH,
+    CMDLINE_ERR_SWITCH_CONFLICT,
+    CMDLINE_ERR_SWITCH_REQUIRES,
+    CMDLINE_ERR_MISSING_GROUP,
+    CMDLINE_ERR_UNKNOWN_COMMAND,
+    CMDLINE_ERR_MISSING_COMMAND,
+    CMDLINE_ERR_TABLE,
+    CMDLINE_ERR_OUT_OF_RESOURCES,
+    CMDLINE_ERR_HELP
+} CMDLINE_ERROR_CODE;
+
+#define CMDLINE_NO_ROW      MAX_UINTN
+
+// Describes why a parse failed, strings point into the argument vector
+// or the tables so are valid for as long as those are
+typedef struct {
+    CMDLINE_ERROR_CODE Code;
+    UINTN ArgIndex;         // Argv index of the offending argument, 0 if none
+    CONST CHAR16 *Arg;      // offending argument or switch name (may be NULL)
+    CONST CHAR16 *Value;    // value given to switch, other switch of a constraint, or table error text
+    UINTN Row;              // table row, CMDLINE_NO_ROW if none
+    VALUE_TYPE ValueType;   // value type of table row
+    UINTN Size;             // bytes hex data needs when it is too long, otherwise 0
+} CMDLINE_ERROR;
+
+
+//---------------------------
+// Phase timing
+//---------------------------
+typedef enum {
+    CMDLINE_PHASE_TABLES,       // counting the tables
+    CMDLINE_PHASE_LIST,         // shell option list or native switch index
+    CMDLINE_PHASE_TOKENIZE,     // ShellCommandLineParseEx() or native tokenizer
+    CMDLINE_PHASE_PARAMS,       // parameter conversion (shell parser only)
+    CMDLINE_PHASE_SWITCHES,     // switch processing (shell parser only)
+    CMDLINE_PHASE_MANDATORY,    // mandatory switch check
+    CMDLINE_PHASE_HELP,         // break/help handling
+    CMDLINE_PHASE_CLEANUP,      // freeing working storage
+    CMDLINE_PHASE_MAX
+} CMDLINE_PHASE;
+
+// Performance counter ticks accumulated per phase
+typedef struct {
+    UINT64 Ticks[CMDLINE_PHASE_MAX];
+    UINT64 TotalTicks;
+    UINTN ParseCount;
+    UINT64 Frequency;           // ticks per second
+} CMDLINE_PHASE_TIMES;
+
+
+//---------------------------
+// Work count
+//---------------------------
+
+// Host builds of CmdLineFuzz define CMDLINE_WORK_COUNT so the work of a
+// parse (arguments, switch names compared, value characters converted
+// or copied) can be checked for growth without timing it, other builds
+// compile the count out
+#ifdef CMDLINE_WORK_COUNT
+extern UINTN gCmdLineWork;
+#define CMDLINE_WORK(Count)     (gCmdLineWork += (Count))
+#else
+#define CMDLINE_WORK(Count)
+#endif
+
+
 #endif // CMD_LINE_INTERNAL_H
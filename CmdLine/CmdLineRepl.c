@@ -0,0 +1,294 @@
+/***********************************************************************
+
+ CmdLineRepl.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Interactive loop that reads command lines from the console and parses
+ them against the tables of a compiled parser, so one loaded app can
+ service many commands.
+
+***********************************************************************/
+
+#include <Uefi.h>
+#include <Library/UefiLib.h>
+#include <Library/ShellLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BaseLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include "CmdLine.h"
+#include "CmdLineInternal.h"
+
+
+// locals functions
+STATIC EFI_STATUS ReadConsoleLine(OUT CHAR16 *Buffer, IN UINTN BufferSize);
+STATIC BOOLEAN IsReplCmd(IN CONST CHAR16 *Arg, IN CONST CHAR16 *CmdStr);
+STATIC UINTN ValueSize(IN VALUE_TYPE ValueType, IN DATA *Data);
+STATIC UINTN DefaultsSize(IN CMDLINE_PARSER *Parser);
+STATIC VOID SaveDefaults(IN CMDLINE_PARSER *Parser, OUT UINT8 *Snapshot);
+STATIC VOID RestoreDefaults(IN CMDLINE_PARSER *Parser, IN CONST UINT8 *Snapshot, IN UINTN NumParams);
+
+// globals
+STATIC CONST CHAR16 ExitCmdStr[] = L"exit";
+STATIC CONST CHAR16 QuitCmdStr[] = L"quit";
+
+
+/**
+ * CmdLineRepl()
+ *
+ **/
+SHELL_STATUS CmdLineRepl(IN CMDLINE_PARSER *Parser, IN CONST CHAR16 *Prompt, IN CMDLINE_REPL_HANDLER Handler, IN VOID *Context)
+{
+    SHELL_STATUS ShellStatus = SHELL_OUT_OF_RESOURCES;
+    EFI_STATUS Status;
+    CHAR16 *Line = NULL;
+    CHAR16 **Argv = NULL;
+    UINT8 *Snapshot = NULL;
+    UINTN SnapshotSize;
+    UINTN Argc;
+    UINTN NumParams = 0;
+    BOOLEAN Dirty = FALSE;
+
+    if (!Parser) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    Line = AllocatePool(REPL_LINE_SIZE * sizeof(CHAR16));
+    Argv = AllocatePool((REPL_MAX_ARGS + 1) * sizeof(CHAR16 *));
+    SnapshotSize = DefaultsSize(Parser);
+    if (SnapshotSize) {
+        Snapshot = AllocatePool(SnapshotSize);
+    }
+    if (!Line || !Argv || (SnapshotSize && !Snapshot)) {
+        goto Error_exit;
+    }
+    // values held before the first command are restored before each command
+    SaveDefaults(Parser, Snapshot);
+    Argv[0] = (CHAR16 *)Parser->ProgName;
+
+    while (!ShellGetExecutionBreakFlag()) {
+        if (Prompt) {
+            ShellPrintEx(-1, -1, L"%s", Prompt);
+        } else {
+            ShellPrintEx(-1, -1, L"%H%s%N> ", Parser->ProgName);
+        }
+        Status = ReadConsoleLine(Line, REPL_LINE_SIZE);
+        if (EFI_ERROR(Status)) {
+            ShellStatus = SHELL_DEVICE_ERROR;
+            goto Error_exit;
+        }
+        ShellStatus = CmdLineSplitLine(Line, &Argv[1], REPL_MAX_ARGS, &Argc);
+        if (ShellStatus == SHELL_BUFFER_TOO_SMALL) {
+            ShellPrintEx(-1, -1, L"%H%s%N: Too many arguments\r\n", Parser->ProgName);
+            continue;
+        }
+        if (ShellStatus != SHELL_SUCCESS) {
+            ShellPrintEx(-1, -1, L"%H%s%N: Unmatched quote\r\n", Parser->ProgName);
+            continue;
+        }
+        if (Argc == 0) {
+            continue;
+        }
+        if (Argc == 1 && (IsReplCmd(Argv[1], ExitCmdStr) || IsReplCmd(Argv[1], QuitCmdStr))) {
+            break;
+        }
+
+        // only values written by the previous command need restoring
+        if (Dirty) {
+            RestoreDefaults(Parser, Snapshot, NumParams);
+        }
+        ShellStatus = CmdLineParseArgs(Parser, Argc + 1, Argv, &NumParams, NULL);
+        Dirty = TRUE;
+        if (ShellStatus == SHELL_SUCCESS && Handler) {
+            if (Handler(Context, NumParams) == SHELL_ABORTED) {
+                break;
+            }
+        }
+    }
+    ShellStatus = SHELL_SUCCESS;
+
+Error_exit:
+    if (Line) {
+        FreePool(Line);
+        Line = NULL;
+    }
+    if (Argv) {
+        FreePool(Argv);
+        Argv = NULL;
+    }
+    if (Snapshot) {
+        FreePool(Snapshot);
+        Snapshot = NULL;
+    }
+
+    return ShellStatus;
+}
+
+/**
+ * Function: ReadConsoleLine
+ *
+ * BufferSize is in characters, supports backspace only
+ **/
+STATIC EFI_STATUS ReadConsoleLine(OUT CHAR16 *Buffer, IN UINTN BufferSize)
+{
+    EFI_STATUS Status;
+    EFI_INPUT_KEY Key;
+    UINTN EventIndex;
+    UINTN Len = 0;
+
+    while (TRUE) {
+        Status = gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &EventIndex);
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+        Status = gST->ConIn->ReadKeyStroke(gST->ConIn, &Key);
+        if (Status == EFI_NOT_READY) {
+            continue;
+        }
+        if (EFI_ERROR(Status)) {
+            return Status;
+        }
+        if ((Key.UnicodeChar == CHAR_CARRIAGE_RETURN) || (Key.UnicodeChar == CHAR_LINEFEED)) {
+            ShellPrintEx(-1, -1, L"\r\n");
+            break;
+        }
+        if (Key.UnicodeChar == CHAR_BACKSPACE) {
+            if (Len) {
+                Len--;
+                ShellPrintEx(-1, -1, L"\b \b");
+            }
+            continue;
+        }
+        if ((Key.UnicodeChar < L' ') || (Len+1 >= BufferSize)) {
+            continue;
+        }
+        Buffer[Len++] = Key.UnicodeChar;
+        ShellPrintEx(-1, -1, L"%c", Key.UnicodeChar);
+    }
+    Buffer[Len] = L'\0';
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Function: ValueSize
+ *
+ * Size of the variable a table row writes its value to
+ **/
+STATIC UINTN ValueSize(IN VALUE_TYPE ValueType, IN DATA *Data)
+{
+    switch (ValueType) {
+    case VALTYPE_NONE:
+        return Data->FlagValue ? sizeof(UINTN) : sizeof(BOOLEAN);
+    case VALTYPE_STRING:
+        return Data->MaxStrSize * sizeof(CHAR16);
+    case VALTYPE_DECIMAL:
+    case VALTYPE_HEXIDECIMAL:
+    case VALTYPE_INTEGER:
+        return sizeof(UINTN);
+    case VALTYPE_SIGNED:
+        return sizeof(INTN);
+    case VALTYPE_DEC64:
+    case VALTYPE_HEX64:
+    case VALTYPE_INT64:
+        return sizeof(UINT64);
+    case VALTYPE_ENUM:
+        return sizeof(unsigned int);
+    case VALTYPE_DECLIST:
+    case VALTYPE_HEXLIST:
+    case VALTYPE_INTLIST:
+        return sizeof(VALUE_LIST);  // restores the count, not the values
+    case VALTYPE_HEXBLOB:
+        return sizeof(VALUE_BLOB);  // restores the size, not the data
+    case VALTYPE_STRVIEW:
+        return sizeof(VALUE_STRVIEW);
+    case VALTYPE_CALLBACK:
+        return sizeof(VALUE_CALLBACK);  // restores the count
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Function: DefaultsSize
+ *
+ **/
+STATIC UINTN DefaultsSize(IN CMDLINE_PARSER *Parser)
+{
+    UINTN Size = 0;
+    UINTN i;
+
+    for (i = 0; i < Parser->TableParamCount; i++) {
+        Size += ValueSize(Parser->ParamTable[i].ValueType, &Parser->ParamTable[i].Data);
+    }
+    for (i = 0; i < Parser->TableSwCount; i++) {
+        Size += ValueSize(Parser->SwTable[i].ValueType, &Parser->SwTable[i].Data);
+    }
+    return Size;
+}
+
+/**
+ * Function: SaveDefaults
+ *
+ * Values are packed in table order, parameters then switches
+ **/
+STATIC VOID SaveDefaults(IN CMDLINE_PARSER *Parser, OUT UINT8 *Snapshot)
+{
+    UINTN Size;
+    UINTN i;
+
+    for (i = 0; i < Parser->TableParamCount; i++) {
+        Size = ValueSize(Parser->ParamTable[i].ValueType, &Parser->ParamTable[i].Data);
+        CopyMem(Snapshot, Parser->ParamTable[i].ValueRetPtr.pVoid, Size);
+        Snapshot += Size;
+    }
+    for (i = 0; i < Parser->TableSwCount; i++) {
+        Size = ValueSize(Parser->SwTable[i].ValueType, &Parser->SwTable[i].Data);
+        CopyMem(Snapshot, Parser->SwTable[i].ValueRetPtr.pVoid, Size);
+        Snapshot += Size;
+    }
+}
+
+/**
+ * Function: RestoreDefaults
+ *
+ * Restores the first NumParams parameters and the switches marked
+ * present by the last parse, the only values it can have written
+ **/
+STATIC VOID RestoreDefaults(IN CMDLINE_PARSER *Parser, IN CONST UINT8 *Snapshot, IN UINTN NumParams)
+{
+    UINTN Size;
+    UINTN i;
+
+    for (i = 0; i < Parser->TableParamCount; i++) {
+        Size = ValueSize(Parser->ParamTable[i].ValueType, &Parser->ParamTable[i].Data);
+        if (i < NumParams) {
+            CopyMem(Parser->ParamTable[i].ValueRetPtr.pVoid, Snapshot, Size);
+        }
+        Snapshot += Size;
+    }
+    for (i = 0; i < Parser->TableSwCount; i++) {
+        Size = ValueSize(Parser->SwTable[i].ValueType, &Parser->SwTable[i].Data);
+        if (SWBIT_TEST(Parser->PresentBits, i)) {
+            CopyMem(Parser->SwTable[i].ValueRetPtr.pVoid, Snapshot, Size);
+        }
+        Snapshot += Size;
+    }
+}
+
+/**
+ * Function: IsReplCmd
+ *
+ * Case-insensitive match of a REPL command, as for switch and
+ * subcommand names
+ **/
+STATIC BOOLEAN IsReplCmd(IN CONST CHAR16 *Arg, IN CONST CHAR16 *CmdStr)
+{
+    while (*Arg != L'\0' && CharToUpper(*Arg) == CharToUpper(*CmdStr)) {
+        Arg++;
+        CmdStr++;
+    }
+    return (*Arg == L'\0' && *CmdStr == L'\0') ? TRUE : FALSE;
+}
@@ -0,0 +1,73 @@
+/***********************************************************************
+
+ CmdLineTestTables.h
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Tables of the test application, shared with the host fuzzer so both
+ parse against the same switches. Defines the table variables, so is
+ included by one source file of a program only.
+
+***********************************************************************/
+
+#ifndef CMD_LINE_TEST_TABLES_H
+#define CMD_LINE_TEST_TABLES_H
+
+#include <Uefi.h>
+#include "CmdLine.h"
+
+// Parameter variables
+#define STR_MAXSIZE 20
+CHAR16  Param1[STR_MAXSIZE] = L"default string";
+UINTN   Param2  = 0;
+UINTN   Param3  = 0;
+
+// Switch variables
+typedef enum { ENUM_BLACK, ENUM_RED, ENUM_GREEN, ENUM_BLUE, ENUM_WHITE } ENUM_COLOUR;
+BOOLEAN     Flag        = FALSE;
+UINTN       Flag2       = 0;
+ENUM_COLOUR Colour      = ENUM_BLACK;
+UINTN       DecValue    = 0;
+UINTN       HexValue    = 0;
+UINTN       IntValue    = 0;
+CHAR16      StringValue[STR_MAXSIZE] = L"not initialised";
+UINTN       Addr[64];
+VALUE_LIST  AddrList    = VALUE_LIST_INIT(Addr);
+UINT8       Pattern[64];
+VALUE_BLOB  PatternBlob = VALUE_BLOB_INIT(Pattern);
+
+// Main program help
+CHAR16 ProgName[]       = L"CmdLine";
+CHAR16 ProgHelpStr[]    = L"Application to test command line parser";
+
+// Parameter table defines 3 arguments
+PARAMTABLE_START(ParamTable)
+PARAMTABLE_STR(Param1, STR_MAXSIZE, L"[str]string parameter")
+PARAMTABLE_HEX(&Param2,             L"[num1]hexidecimal parameter")
+PARAMTABLE_DEC(&Param3,             L"[num2]decimal parameter")
+PARAMTABLE_END
+
+// String definitions for enum switch
+ENUMSTR_START(EnumColourStrs)
+ENUMSTR_ENTRY(ENUM_BLACK,  L"black")
+ENUMSTR_ENTRY(ENUM_RED,    L"red")
+ENUMSTR_ENTRY(ENUM_GREEN,  L"green")
+ENUMSTR_ENTRY(ENUM_BLUE,   L"blue")
+ENUMSTR_ENTRY(ENUM_WHITE,  L"white")
+ENUMSTR_END
+
+// Switch table defines 9 switches
+SWTABLE_START(SwitchTable)
+SWTABLE_OPT_FLAG(   L"-f",  NULL,           &Flag,                      L"boolean flag")
+SWTABLE_OPT_FLGVAL( NULL,   L"-flag2",      &Flag2, 12345678,           L"flag with default value assigned")
+SWTABLE_OPT_ENUM(   L"-c",  L"-colour",     &Colour, EnumColourStrs,    L"[val]named option")
+SWTABLE_MAN_DEC(    L"-d",  L"-dec",        &DecValue,                  L"[num]decimal value")
+SWTABLE_OPT_HEX(    L"-x",  L"-hex",        &HexValue,                  L"[num]hexidecimal value")
+SWTABLE_OPT_INT(    L"-i",  NULL,           &IntValue,                  L"[num]integer value")
+SWTABLE_OPT_STR(    L"-s",  L"-string",     StringValue, STR_MAXSIZE,   L"[str]string value")
+SWTABLE_OPT_HEXLIST(L"-a",  L"-addr",       &AddrList,                  L"[addr]address list")
+SWTABLE_OPT_HEXBLOB(L"-p",  L"-pattern",    &PatternBlob,               L"[hex]pattern bytes")
+SWTABLE_END
+
+#endif // CMD_LINE_TEST_TABLES_H
@@ -0,0 +1,356 @@
+/***********************************************************************
+
+ CmdLineBench.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Host benchmark for the command line parser. Times ParseCmdLine()
+ across switch table sizes, argument counts and value types, using
+ the shell (ShellCommandLineParseEx), native, native with caller
+ arena (ParseCmdLineArena), compiled handle (CmdLineParseArgs) and
+ compiled handle with LAZY_VALUES (no values requested) engines, and
+ reports the time, number of pool allocations and bytes allocated
+ per parse.
+
+ Run "CmdLineBench [ms] [phases]" where ms is the minimum time to
+ spend on each case (default 200), "phases" adds a per phase breakdown
+ of each case using PHASE_TIMING
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/PrintLib.h>
+#include "../CmdLine/CmdLine.h"
+#include "CmdLineHost.h"
+
+#define NAME_SIZE       16
+#define STR_MAXSIZE     32
+#define DEFAULT_MIN_MS  200
+
+typedef enum { BENCH_FLAG, BENCH_DEC, BENCH_HEX, BENCH_INT, BENCH_ENUM, BENCH_STR, BENCH_MIXED } BENCH_TYPE;
+typedef enum { ENGINE_SHELL, ENGINE_NATIVE, ENGINE_ARENA, ENGINE_HANDLE, ENGINE_LAZY, ENGINE_MAX } BENCH_ENGINE;
+
+// A generated switch table together with the command line to parse
+typedef struct {
+    BENCH_TYPE Type;
+    UINTN SwCount;
+    UINTN ArgCount;             // number of switches on command line
+    SWITCH_TABLE *SwTable;
+    CHAR16 (*Names)[2][NAME_SIZE];
+    UINTN *Values;
+    CHAR16 (*Strings)[STR_MAXSIZE];
+    UINTN Argc;
+    CHAR16 **Argv;
+} BENCH_CASE;
+
+// locals functions
+STATIC BOOLEAN BuildCase(IN BENCH_TYPE Type, IN UINTN SwCount, IN UINTN ArgCount, OUT BENCH_CASE *Case);
+STATIC VOID FreeCase(IN BENCH_CASE *Case);
+STATIC VOID RunCase(IN BENCH_CASE *Case, IN BENCH_ENGINE Engine, IN UINT64 MinNs);
+STATIC SHELL_STATUS ParseOnce(IN BENCH_CASE *Case, IN BENCH_ENGINE Engine, IN VOID *Arena, IN UINTN ArenaSize, IN CMDLINE_PARSER *Parser);
+STATIC UINT64 NowNs(VOID);
+STATIC VOID PrintPhases(VOID);
+
+// globals
+STATIC CONST CHAR8 *BenchTypeName[] = { "flag", "dec", "hex", "int", "enum", "str", "mixed" };
+
+STATIC CONST CHAR8 *BenchEngineName[] = { "shell", "native", "arena", "handle", "lazy" };
+
+STATIC CONST CHAR8 *PhaseName[CMDLINE_PHASE_MAX] = { "tables", "list", "tokenize", "params", "switches", "mandatory", "help", "cleanup" };
+
+STATIC UINT16 BenchFuncOpt = 0;
+
+STATIC CHAR16 DecValueStr[]  = L"12345";
+STATIC CHAR16 HexValueStr[]  = L"BEEF";
+STATIC CHAR16 IntValueStr[]  = L"0x1234";
+STATIC CHAR16 EnumValueStr[] = L"green";
+STATIC CHAR16 StrValueStr[]  = L"bench-string";
+
+STATIC CHAR16 ProgName[]     = L"bench";
+STATIC CHAR16 ParamStrArg[]  = L"file.bin";
+STATIC CHAR16 ParamIntArg[]  = L"0x1000";
+
+// Parameter table used by every case
+CHAR16 ParamStr[STR_MAXSIZE];
+UINTN  ParamInt;
+
+PARAMTABLE_START(BenchParamTable)
+PARAMTABLE_STR(ParamStr, STR_MAXSIZE,   L"[str]string parameter")
+PARAMTABLE_INT(&ParamInt,               L"[num]integer parameter")
+PARAMTABLE_END
+
+// String definitions for enum switches
+ENUMSTR_START(BenchEnumStrs)
+ENUMSTR_ENTRY(0, L"black")
+ENUMSTR_ENTRY(1, L"red")
+ENUMSTR_ENTRY(2, L"green")
+ENUMSTR_ENTRY(3, L"blue")
+ENUMSTR_ENTRY(4, L"white")
+ENUMSTR_END
+
+//---------------------------
+// Main entry point
+//---------------------------
+
+int main(int argc, char *argv[])
+{
+    STATIC CONST UINTN SwCounts[] = { 1, 10, 30, 100, 300, 1000 };
+    STATIC CONST UINTN ArgCounts[] = { 0, 1, 8, 32 };
+    UINT64 MinNs = (UINT64)DEFAULT_MIN_MS * 1000000;
+    BENCH_CASE Case;
+    UINTN i, j;
+    BENCH_ENGINE e;
+
+    if (argc > 1) {
+        MinNs = (UINT64)strtoul(argv[1], NULL, 0) * 1000000;
+    }
+    if (argc > 2 && strcmp(argv[2], "phases") == 0) {
+        BenchFuncOpt = PHASE_TIMING;
+    }
+    gHostShellQuiet = TRUE;
+
+    printf("%-6s %-6s %8s %6s %12s %10s %12s  %s\n", "engine", "type", "switches", "args", "ns/parse", "allocs", "bytes", "status");
+
+    // table size and argument count sweep
+    for (i = 0; i < ARRAY_SIZE(SwCounts); i++) {
+        for (j = 0; j < ARRAY_SIZE(ArgCounts); j++) {
+            if (ArgCounts[j] > SwCounts[i]) {
+                continue;
+            }
+            if (!BuildCase(BENCH_MIXED, SwCounts[i], ArgCounts[j], &Case)) {
+                return 1;
+            }
+            for (e = 0; e < ENGINE_MAX; e++) {
+                RunCase(&Case, e, MinNs);
+            }
+            FreeCase(&Case);
+        }
+    }
+
+    // value types
+    for (i = BENCH_FLAG; i < BENCH_MIXED; i++) {
+        if (!BuildCase((BENCH_TYPE)i, 16, 8, &Case)) {
+            return 1;
+        }
+        for (e = 0; e < ENGINE_MAX; e++) {
+            RunCase(&Case, e, MinNs);
+        }
+        FreeCase(&Case);
+    }
+
+    return 0;
+}
+
+/**
+ * Function: BuildCase
+ *
+ **/
+STATIC BOOLEAN BuildCase(IN BENCH_TYPE Type, IN UINTN SwCount, IN UINTN ArgCount, OUT BENCH_CASE *Case)
+{
+    UINTN i;
+
+    Case->Type = Type;
+    Case->SwCount = SwCount;
+    Case->ArgCount = ArgCount;
+    Case->SwTable = calloc(SwCount+1, sizeof(SWITCH_TABLE));
+    Case->Names = calloc(SwCount, sizeof(*Case->Names));
+    Case->Values = calloc(SwCount, sizeof(UINTN));
+    Case->Strings = calloc(SwCount, sizeof(*Case->Strings));
+    Case->Argv = calloc(3 + ArgCount*2, sizeof(CHAR16 *));
+    if (!Case->SwTable || !Case->Names || !Case->Values || !Case->Strings || !Case->Argv) {
+        printf("out of memory\n");
+        FreeCase(Case);
+        return FALSE;
+    }
+
+    // switch table (terminating entry already zeroed, i.e. NO_SW)
+    for (i = 0; i < SwCount; i++) {
+        SWITCH_TABLE *Sw = &Case->SwTable[i];
+        BENCH_TYPE SwType = (Type == BENCH_MIXED) ? (BENCH_TYPE)(i % BENCH_MIXED) : Type;
+
+        UnicodeSPrint(Case->Names[i][0], sizeof(Case->Names[i][0]), L"-s%u", i);
+        UnicodeSPrint(Case->Names[i][1], sizeof(Case->Names[i][1]), L"-switch%u", i);
+        Sw->SwStr1 = Case->Names[i][0];
+        Sw->SwStr2 = Case->Names[i][1];
+        Sw->SwitchNecessity = OPT_SW;
+        Sw->ValueNecessity = MAN_VALUE;
+        Sw->ValueRetPtr.pUintn = &Case->Values[i];
+        Sw->HelpStr = L"[val]benchmark switch";
+        switch (SwType) {
+        case BENCH_FLAG:
+            Sw->ValueType = VALTYPE_NONE;
+            Sw->ValueNecessity = NO_VALUE;
+            break;
+        case BENCH_DEC:
+            Sw->ValueType = VALTYPE_DECIMAL;
+            break;
+        case BENCH_HEX:
+            Sw->ValueType = VALTYPE_HEXIDECIMAL;
+            break;
+        case BENCH_INT:
+            Sw->ValueType = VALTYPE_INTEGER;
+            break;
+        case BENCH_ENUM:
+            Sw->ValueType = VALTYPE_ENUM;
+            Sw->Data.EnumStrArray = BenchEnumStrs;
+            break;
+        default:
+            Sw->ValueType = VALTYPE_STRING;
+            Sw->Data.MaxStrSize = STR_MAXSIZE;
+            Sw->ValueRetPtr.pChar16 = Case->Strings[i];
+            break;
+        }
+    }
+
+    // command line: program name, two parameters then the switches
+    Case->Argc = 0;
+    Case->Argv[Case->Argc++] = ProgName;
+    Case->Argv[Case->Argc++] = ParamStrArg;
+    Case->Argv[Case->Argc++] = ParamIntArg;
+    for (i = 0; i < ArgCount; i++) {
+        UINTN Row = (i * SwCount) / ArgCount;
+        SWITCH_TABLE *Sw = &Case->SwTable[Row];
+        Case->Argv[Case->Argc++] = (i & 1) ? Sw->SwStr2 : Sw->SwStr1;
+        switch (Sw->ValueType) {
+        case VALTYPE_DECIMAL:       Case->Argv[Case->Argc++] = DecValueStr; break;
+        case VALTYPE_HEXIDECIMAL:   Case->Argv[Case->Argc++] = HexValueStr; break;
+        case VALTYPE_INTEGER:       Case->Argv[Case->Argc++] = IntValueStr; break;
+        case VALTYPE_ENUM:          Case->Argv[Case->Argc++] = EnumValueStr; break;
+        case VALTYPE_STRING:        Case->Argv[Case->Argc++] = StrValueStr; break;
+        default:                    break;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Function: FreeCase
+ *
+ **/
+STATIC VOID FreeCase(IN BENCH_CASE *Case)
+{
+    free(Case->SwTable);
+    free(Case->Names);
+    free(Case->Values);
+    free(Case->Strings);
+    free(Case->Argv);
+}
+
+/**
+ * Function: RunCase
+ *
+ **/
+STATIC VOID RunCase(IN BENCH_CASE *Case, IN BENCH_ENGINE Engine, IN UINT64 MinNs)
+{
+    SHELL_STATUS ShellStatus;
+    UINT64 Start, Elapsed;
+    UINTN Iterations = 1;
+    UINTN ArenaSize = 0;
+    VOID *Arena = NULL;
+    CMDLINE_PARSER *Parser = NULL;
+    UINTN n;
+
+    ShellHostSetArgs(Case->Argc, Case->Argv);
+
+    // size arena from the tables (outside of timing)
+    if (Engine == ENGINE_ARENA) {
+        ParseCmdLineArena(ProgName, 0, BenchParamTable, Case->SwTable, NULL, BenchFuncOpt, NULL, NULL, 0, &ArenaSize);
+        Arena = malloc(ArenaSize ? ArenaSize : 1);
+    }
+    // compile handle once (outside of timing)
+    if (Engine == ENGINE_HANDLE || Engine == ENGINE_LAZY) {
+        if (CmdLineCompile(ProgName, 0, BenchParamTable, Case->SwTable, NULL, BenchFuncOpt | ((Engine == ENGINE_LAZY) ? LAZY_VALUES : 0), &Parser) != SHELL_SUCCESS) {
+            printf("%-6s compile failed\n", BenchEngineName[Engine]);
+            return;
+        }
+    }
+
+    // double the iteration count until the minimum time has been spent
+    while (TRUE) {
+        gHostAllocCount = 0;
+        gHostAllocBytes = 0;
+        CmdLineGetPhaseTimes(NULL, TRUE);
+        Start = NowNs();
+        for (n = 0; n < Iterations; n++) {
+            ShellStatus = ParseOnce(Case, Engine, Arena, ArenaSize, Parser);
+        }
+        Elapsed = NowNs() - Start;
+        if (Elapsed >= MinNs) {
+            break;
+        }
+        Iterations *= 2;
+    }
+    free(Arena);
+    CmdLineFree(Parser);
+
+    printf("%-6s %-6s %8lu %6lu %12.1f %10.2f %12.1f  %s\n",
+        BenchEngineName[Engine],
+        BenchTypeName[Case->Type],
+        (unsigned long)Case->SwCount,
+        (unsigned long)Case->ArgCount,
+        (double)Elapsed / Iterations,
+        (double)gHostAllocCount / Iterations,
+        (double)gHostAllocBytes / Iterations,
+        ShellStatus == SHELL_SUCCESS ? "ok" : "FAIL");
+    if (BenchFuncOpt & PHASE_TIMING) {
+        PrintPhases();
+    }
+}
+
+/**
+ * Function: ParseOnce
+ *
+ **/
+STATIC SHELL_STATUS ParseOnce(IN BENCH_CASE *Case, IN BENCH_ENGINE Engine, IN VOID *Arena, IN UINTN ArenaSize, IN CMDLINE_PARSER *Parser)
+{
+    switch (Engine) {
+    case ENGINE_NATIVE:
+        return ParseCmdLine(ProgName, 0, BenchParamTable, Case->SwTable, NULL, BenchFuncOpt | NATIVE_PARSE, NULL);
+    case ENGINE_ARENA:
+        return ParseCmdLineArena(ProgName, 0, BenchParamTable, Case->SwTable, NULL, BenchFuncOpt, NULL, Arena, ArenaSize, NULL);
+    case ENGINE_HANDLE:
+    case ENGINE_LAZY:
+        return CmdLineParseArgs(Parser, Case->Argc, Case->Argv, NULL, NULL);
+    default:
+        return ParseCmdLine(ProgName, 0, BenchParamTable, Case->SwTable, NULL, BenchFuncOpt, NULL);
+    }
+}
+
+/**
+ * Function: NowNs
+ *
+ **/
+STATIC UINT64 NowNs(VOID)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return (UINT64)Ts.tv_sec * 1000000000 + (UINT64)Ts.tv_nsec;
+}
+
+/**
+ * Function: PrintPhases
+ *
+ * Average ns per parse of each phase of the last timed run
+ **/
+STATIC VOID PrintPhases(VOID)
+{
+    CMDLINE_PHASE_TIMES Times;
+    CMDLINE_PHASE Phase;
+
+    CmdLineGetPhaseTimes(&Times, TRUE);
+    if (!Times.ParseCount || !Times.Frequency) {
+        return;
+    }
+    printf("       ");
+    for (Phase = 0; Phase < CMDLINE_PHASE_MAX; Phase++) {
+        printf(" %s=%.1f", PhaseName[Phase], (double)Times.Ticks[Phase] * 1e9 / Times.Frequency / Times.ParseCount);
+    }
+    printf(" total=%.1f\n", (double)Times.TotalTicks * 1e9 / Times.Frequency / Times.ParseCount);
+}
@@ -0,0 +1,1056 @@
+/***********************************************************************
+
+ CmdLineCheck.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Host checks of parser behaviour that CmdLineTest can only show by
+ hand. Each command line is parsed with the native tokenizer and, where
+ it applies, the shell parser, and the status, error record and values
+ are compared with those expected. Random values are also converted by
+ the parser and by a digit at a time reference converter, which must
+ agree.
+
+ "CmdLineCheck" prints each failed check and returns 1 if any failed.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/ShellLib.h>
+#include <Library/PrintLib.h>
+#include "../CmdLine/CmdLine.h"
+#include "CmdLineHost.h"
+
+#define MAX_ARGS    16
+#define LINE_SIZE   128
+#define LIST_SIZE   4
+#define BLOB_SIZE   4
+#define BLOB_FILL   0xEE
+#define MAX_FILES   4
+#define NAME_SIZE   16
+#define VALUE_SIZE  40      // longest random value, in characters
+#define CONVERT_RUNS    1000000
+
+// Checks a condition, failures are counted and printed with the line
+#define CHECK(Cond) \
+    do { \
+        Checks++; \
+        if (!(Cond)) { \
+            Failures++; \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Cond); \
+        } \
+    } while (0)
+
+// Command line split into an argument vector
+typedef struct {
+    CHAR16 Line[LINE_SIZE];
+    CHAR16 *Argv[MAX_ARGS];
+    UINTN Argc;
+} CHECK_ARGS;
+
+// locals functions
+STATIC VOID SplitArgs(IN CONST CHAR16 *Line, OUT CHECK_ARGS *Args);
+STATIC SHELL_STATUS ParseLine(IN CONST CHAR16 *Line, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN UINT16 FuncOpt, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error);
+STATIC SHELL_STATUS DispatchLine(IN CONST CHAR16 *Line, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error);
+STATIC VOID ResetValues(VOID);
+STATIC BOOLEAN SameStr(IN CONST CHAR16 *Str1, IN CONST CHAR16 *Str2);
+STATIC VOID CheckArena(VOID);
+STATIC VOID CheckEnums(VOID);
+STATIC VOID CheckLists(VOID);
+STATIC VOID CheckBlobs(VOID);
+STATIC VOID CheckNumbers(VOID);
+STATIC VOID CheckGetters(VOID);
+STATIC VOID CheckPrefixes(VOID);
+STATIC VOID CheckCallback(VOID);
+STATIC VOID CheckConstraints(VOID);
+STATIC VOID CheckDispatch(VOID);
+STATIC VOID CheckShellErrors(VOID);
+STATIC VOID CheckConversions(VOID);
+STATIC VOID RandomValue(IN UINTN Radix, IN BOOLEAN Signed, OUT CHAR16 *Value);
+STATIC UINTN RefToNumber(IN CONST CHAR16 *String, IN UINTN Radix, IN UINT64 Limit, IN BOOLEAN Signed, OUT UINT64 *Value);
+STATIC UINTN RefHexBlob(IN CONST CHAR16 *String, OUT UINT8 *Bytes, OUT UINTN *Size);
+STATIC UINT32 Random(IN UINTN Range);
+STATIC SHELL_STATUS EFIAPI FileHandler(IN VOID *Context, IN UINTN Index, IN CONST CHAR16 *Value);
+STATIC SHELL_STATUS EFIAPI AddHandler(IN VOID *Context, IN UINTN NumParams);
+STATIC SHELL_STATUS EFIAPI RemoveHandler(IN VOID *Context, IN UINTN NumParams);
+
+// globals
+STATIC UINTN Checks = 0;
+STATIC UINTN Failures = 0;
+
+STATIC CHAR16 ProgName[]    = L"check";
+STATIC CHAR16 ProgHelpStr[] = L"Parser checks";
+
+// return variables
+STATIC UINTN Addr[LIST_SIZE];
+STATIC VALUE_LIST AddrList = VALUE_LIST_INIT(Addr);
+
+STATIC unsigned int Mode;
+STATIC UINTN Count;
+STATIC BOOLEAN Colour;
+STATIC BOOLEAN Debug;
+STATIC UINT8 Bytes[BLOB_SIZE];
+STATIC VALUE_BLOB BytesBlob = VALUE_BLOB_INIT(Bytes);
+STATIC UINT64 RandomState = 0x9E3779B97F4A7C15ULL;
+STATIC UINTN Dec, Hex, Int;
+STATIC INTN Sint;
+STATIC UINT64 Dec64, Hex64, Int64;
+STATIC BOOLEAN One;
+STATIC BOOLEAN Read;
+STATIC BOOLEAN Write;
+STATIC BOOLEAN Verify;
+STATIC UINTN First;
+STATIC CHAR16 Files[MAX_FILES][NAME_SIZE];
+STATIC VALUE_CALLBACK FileCallback = VALUE_CALLBACK_INIT(FileHandler, Files);
+STATIC BOOLEAN Verbose;
+STATIC BOOLEAN Version;
+STATIC UINTN Level;
+STATIC BOOLEAN Force;
+STATIC UINTN Item;
+STATIC UINTN HandlerCalls;
+STATIC UINTN HandlerParams;
+
+ENUMSTR_START(ModeStrs)
+ENUMSTR_ENTRY(0, L"write")
+ENUMSTR_ENTRY(1, L"Read")
+ENUMSTR_ENTRY(2, L"readback")
+ENUMSTR_ENTRY(3, L"erase")
+ENUMSTR_ENTRY(4, L"READ")
+ENUMSTR_END_EX(ENUMSTR_PREFIX)
+
+SWTABLE_START(EnumSwTable)
+SWTABLE_OPT_ENUM(   L"-m",  L"-mode",       &Mode, ModeStrs,    L"[mode]access mode")
+SWTABLE_END
+
+SWTABLE_START(ValueSwTable)
+SWTABLE_OPT_HEXLIST(L"-a",  L"-addr",       &AddrList,      L"[addr]address list")
+SWTABLE_OPT_HEXBLOB(L"-p",  L"-pattern",    &BytesBlob,     L"[hex]pattern bytes")
+SWTABLE_OPT_FLAG(   NULL,   L"-colour",     &Colour,        L"colour output")
+SWTABLE_OPT_DEC(    NULL,   L"-count",      &Count,         L"[num]repeat count")
+SWTABLE_OPT_FLAG(   L"-d",  L"-debug",      &Debug,         L"debug output")
+SWTABLE_END
+
+SWTABLE_START(NumSwTable)
+SWTABLE_OPT_DEC(    L"-d",  NULL,           &Dec,           L"[value]decimal")
+SWTABLE_OPT_HEX(    L"-x",  NULL,           &Hex,           L"[value]hex")
+SWTABLE_OPT_INT(    L"-i",  NULL,           &Int,           L"[value]integer")
+SWTABLE_OPT_SINT(   L"-s",  NULL,           &Sint,          L"[value]signed")
+SWTABLE_OPT_DEC64(  L"-d64", NULL,          &Dec64,         L"[value]64-bit decimal")
+SWTABLE_OPT_HEX64(  L"-x64", NULL,          &Hex64,         L"[value]64-bit hex")
+SWTABLE_OPT_INT64(  L"-i64", NULL,          &Int64,         L"[value]64-bit integer")
+SWTABLE_END
+
+SWTABLE_START(ConvertSwTable)
+SWTABLE_OPT_DEC(    L"-d",  NULL,           &Dec,           L"[value]decimal")
+SWTABLE_OPT_HEX(    L"-x",  NULL,           &Hex,           L"[value]hex")
+SWTABLE_OPT_INT(    L"-i",  NULL,           &Int,           L"[value]integer")
+SWTABLE_OPT_SINT(   L"-s",  NULL,           &Sint,          L"[value]signed")
+SWTABLE_OPT_DEC64(  L"-d64", NULL,          &Dec64,         L"[value]64-bit decimal")
+SWTABLE_OPT_HEX64(  L"-x64", NULL,          &Hex64,         L"[value]64-bit hex")
+SWTABLE_OPT_INT64(  L"-i64", NULL,          &Int64,         L"[value]64-bit integer")
+SWTABLE_OPT_HEXBLOB(L"-p",  NULL,           &BytesBlob,     L"[hex]bytes")
+SWTABLE_END
+
+SWTABLE_START(DigitSwTable)
+SWTABLE_OPT_FLAG(   L"-1",  L"-one",        &One,           L"once")
+SWTABLE_END
+
+SWTABLE_START(DigitSintSwTable)
+SWTABLE_OPT_FLAG(   L"-1",  L"-one",        &One,           L"once")
+SWTABLE_OPT_SINT(   L"-s",  NULL,           &Sint,          L"[value]signed")
+SWTABLE_END
+
+PARAMTABLE_START(FileParamTable)
+PARAMTABLE_DEC(&First,                      L"[first]first block")
+PARAMTABLE_CALLBACK(&FileCallback,          L"[file..]files to process")
+PARAMTABLE_END
+
+CONSTRAINTTABLE_START(Constraints)
+CONSTRAINTTABLE_ONE_OF(L"-r", L"-w")
+CONSTRAINTTABLE_REQUIRES(L"-v", L"-r")
+CONSTRAINTTABLE_END
+
+SWTABLE_START(ConstraintSwTable)
+SWTABLE_OPT_FLAG(   L"-r",  L"-read",       &Read,          L"read access")
+SWTABLE_OPT_FLAG(   L"-w",  L"-write",      &Write,         L"write access")
+SWTABLE_OPT_FLAG(   L"-v",  L"-verify",     &Verify,        L"verify reads")
+SWTABLE_END_EX(Constraints)
+
+SWTABLE_START(GlobalSwTable)
+SWTABLE_OPT_FLAG(   L"-v",  L"-verbose",    &Verbose,       L"verbose output")
+SWTABLE_OPT_FLAG(   NULL,   L"-version",    &Version,       L"print the version")
+SWTABLE_OPT_DEC(    L"-l",  L"-level",      &Level,         L"[num]log level")
+SWTABLE_END
+
+PARAMTABLE_START(ItemParamTable)
+PARAMTABLE_DEC(&Item,                       L"[item]item number")
+PARAMTABLE_END
+
+SWTABLE_START(RemoveSwTable)
+SWTABLE_OPT_FLAG(   L"-f",  L"-force",      &Force,         L"remove if in use")
+SWTABLE_END
+
+SUBCMDTABLE_START(SubCmdTable)
+SUBCMDTABLE_ENTRY(L"add",   1, ItemParamTable, NULL,            AddHandler,     L"Adds an item")
+SUBCMDTABLE_ENTRY(L"remove-every-copy-of-an-item-from-all-of-the-configured-stores", 1, ItemParamTable, RemoveSwTable, RemoveHandler, L"Removes an item")
+SUBCMDTABLE_END_EX(SUBCMD_SORTED)
+
+SUBCMDTABLE_START(UnsortedSubCmdTable)
+SUBCMDTABLE_ENTRY(L"remove",1, ItemParamTable, NULL,            RemoveHandler,  L"Removes an item")
+SUBCMDTABLE_ENTRY(L"add",   1, ItemParamTable, NULL,            AddHandler,     L"Adds an item")
+SUBCMDTABLE_END_EX(SUBCMD_SORTED)
+
+#define LONG_CMD    L"remove-every-copy-of-an-item-from-all-of-the-configured-stores"
+
+int main(int argc, char *argv[])
+{
+    gHostShellQuiet = TRUE;
+
+    CheckArena();
+    CheckEnums();
+    CheckLists();
+    CheckBlobs();
+    CheckNumbers();
+    CheckGetters();
+    CheckPrefixes();
+    CheckCallback();
+    CheckConstraints();
+    CheckDispatch();
+    CheckShellErrors();
+    CheckConversions();
+
+    printf("checks %lu, failures %lu\n", (unsigned long)Checks, (unsigned long)Failures);
+    return Failures ? 1 : 0;
+}
+
+/**
+ * Function: CheckArena
+ *
+ **/
+STATIC VOID CheckArena(VOID)
+{
+    UINTN Arena[CMDLINE_ARENA_SIZE(ARRAY_SIZE(ValueSwTable)) / sizeof(UINTN)];
+    EFI_SHELL_PARAMETERS_PROTOCOL *Parameters = gEfiShellParametersProtocol;
+    CHECK_ARGS Args;
+    UINTN Required = 0;
+    UINTN Allocs;
+
+    SplitArgs(L"-a 1,2", &Args);
+    ShellHostSetArgs(Args.Argc, Args.Argv);
+    ResetValues();
+    Allocs = gHostAllocCount;
+
+    // a size query parses nothing
+    CHECK(ParseCmdLineArena(ProgName, 0, NULL, ValueSwTable, ProgHelpStr, QUIET_ERRORS, NULL, NULL, 0, &Required) == SHELL_BUFFER_TOO_SMALL);
+    CHECK(Required != 0 && Required <= sizeof(Arena));
+    CHECK(AddrList.Count == 0);
+
+    CHECK(ParseCmdLineArena(ProgName, 0, NULL, ValueSwTable, ProgHelpStr, QUIET_ERRORS, NULL, Arena, sizeof(Arena), NULL) == SHELL_SUCCESS);
+    CHECK(AddrList.Count == 2);
+
+    // without the shell parameters protocol the size is still returned
+    gEfiShellParametersProtocol = NULL;
+    Required = 0;
+    CHECK(ParseCmdLineArena(ProgName, 0, NULL, ValueSwTable, ProgHelpStr, QUIET_ERRORS, NULL, NULL, 0, &Required) == SHELL_UNSUPPORTED);
+    CHECK(Required != 0 && Required <= sizeof(Arena));
+    CHECK(ParseCmdLineArena(ProgName, 0, NULL, ValueSwTable, ProgHelpStr, QUIET_ERRORS, NULL, Arena, sizeof(Arena), NULL) == SHELL_UNSUPPORTED);
+    gEfiShellParametersProtocol = Parameters;
+
+    CHECK(gHostAllocCount == Allocs);
+}
+
+/**
+ * Function: CheckEnums
+ *
+ * A compiled parser searches its own index of the names, the result
+ * must be the same as the linear search of a single parse
+ **/
+STATIC VOID CheckEnums(VOID)
+{
+    STATIC CONST struct {
+        CONST CHAR16 *Value;
+        SHELL_STATUS Status;
+        unsigned int Mode;
+    } Cases[] = {
+        { L"write",     SHELL_SUCCESS,              0 },
+        { L"READ",      SHELL_SUCCESS,              1 },    // first of equal names
+        { L"rEaDbAcK",  SHELL_SUCCESS,              2 },
+        { L"readb",     SHELL_SUCCESS,              2 },    // unique prefix
+        { L"w",         SHELL_SUCCESS,              0 },
+        { L"E",         SHELL_SUCCESS,              3 },
+        { L"rea",       SHELL_INVALID_PARAMETER,    0 },    // ambiguous prefix
+        { L"writer",    SHELL_INVALID_PARAMETER,    0 },
+        { L"",          SHELL_INVALID_PARAMETER,    0 },
+    };
+    CMDLINE_PARSER *Parser = NULL;
+    CMDLINE_ERROR Error;
+    CHAR16 *Argv[] = { ProgName, L"-m", NULL };
+    UINTN i;
+
+    CHECK(CmdLineCompile(ProgName, 0, NULL, EnumSwTable, ProgHelpStr, QUIET_ERRORS, &Parser) == SHELL_SUCCESS);
+    for (i = 0; Parser && i < ARRAY_SIZE(Cases); i++) {
+        Argv[2] = (CHAR16 *)Cases[i].Value;
+        Mode = 99;
+        CHECK(CmdLineParseArgs(Parser, ARRAY_SIZE(Argv), Argv, NULL, &Error) == Cases[i].Status);
+        CHECK(Mode == ((Cases[i].Status == SHELL_SUCCESS) ? Cases[i].Mode : 99));
+
+        ShellHostSetArgs(ARRAY_SIZE(Argv), Argv);
+        Mode = 99;
+        CHECK(ParseCmdLineEx(ProgName, 0, NULL, EnumSwTable, ProgHelpStr, NATIVE_PARSE | QUIET_ERRORS, NULL, &Error) == Cases[i].Status);
+        CHECK(Mode == ((Cases[i].Status == SHELL_SUCCESS) ? Cases[i].Mode : 99));
+    }
+    CmdLineFree(Parser);
+}
+
+/**
+ * Function: CheckLists
+ *
+ **/
+STATIC VOID CheckLists(VOID)
+{
+    CMDLINE_ERROR Error;
+
+    // repeated switch appends to the list
+    CHECK(ParseLine(L"-a 1,2 -a 3", 0, NULL, ValueSwTable, NATIVE_PARSE, NULL, &Error) == SHELL_SUCCESS);
+    CHECK(AddrList.Count == 3);
+    CHECK(Addr[0] == 1 && Addr[1] == 2 && Addr[2] == 3);
+
+    // one comma separated value, both parsers
+    CHECK(ParseLine(L"-a 10,20", 0, NULL, ValueSwTable, 0, NULL, &Error) == SHELL_SUCCESS);
+    CHECK(AddrList.Count == 2);
+    CHECK(Addr[0] == 0x10 && Addr[1] == 0x20);
+
+    // more values than the array holds
+    CHECK(ParseLine(L"-a 1,2,3 -a 4,5", 0, NULL, ValueSwTable, NATIVE_PARSE, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_SWITCH_LIST_FULL);
+    CHECK(Error.ArgIndex == 3);
+    CHECK(SameStr(Error.Value, L"4,5"));
+
+    // the shell parser accepts a list switch only once
+    CHECK(ParseLine(L"-a 1 -a 2", 0, NULL, ValueSwTable, 0, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_DUPLICATE_SWITCH);
+    CHECK(Error.ArgIndex == 3);
+}
+
+/**
+ * Function: CheckBlobs
+ *
+ **/
+STATIC VOID CheckBlobs(VOID)
+{
+    STATIC CONST UINT8 Expected[] = { 0x0A, 0x0B, 0xFF };
+    UINT8 Fill[BLOB_SIZE];
+    CMDLINE_ERROR Error;
+    UINT16 FuncOpt[] = { NATIVE_PARSE, 0 };
+    UINTN i;
+
+    SetMem(Fill, sizeof(Fill), BLOB_FILL);
+    for (i = 0; i < ARRAY_SIZE(FuncOpt); i++) {
+        CHECK(ParseLine(L"-p 0a0BfF", 0, NULL, ValueSwTable, FuncOpt[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(BytesBlob.Size == sizeof(Expected));
+        CHECK(CompareMem(Bytes, Expected, sizeof(Expected)) == 0);
+
+        // too long reports the bytes needed, nothing is written
+        CHECK(ParseLine(L"-p 0102030405", 0, NULL, ValueSwTable, FuncOpt[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_TOO_LONG);
+        CHECK(Error.Size == 5);
+        CHECK(Error.ArgIndex == 1);
+        CHECK(CompareMem(Bytes, Fill, sizeof(Fill)) == 0);
+
+        CHECK(ParseLine(L"-p abc", 0, NULL, ValueSwTable, FuncOpt[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_ODD_DIGITS);
+        CHECK(CompareMem(Bytes, Fill, sizeof(Fill)) == 0);
+
+        // a bad digit is found before any byte is written
+        CHECK(ParseLine(L"-p 0102zz", 0, NULL, ValueSwTable, FuncOpt[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_VALUE);
+        CHECK(Error.Size == 0);
+        CHECK(SameStr(Error.Value, L"0102zz"));
+        CHECK(CompareMem(Bytes, Fill, sizeof(Fill)) == 0);
+    }
+}
+
+/**
+ * Function: CheckNumbers
+ *
+ * Values at the limits of each integer type, one past the limit must
+ * be out of range rather than wrap
+ **/
+STATIC VOID CheckNumbers(VOID)
+{
+    STATIC CONST UINT16 Parsers[] = { 0, NATIVE_PARSE };
+    BOOLEAN Is64 = (sizeof(UINTN) == sizeof(UINT64));
+    CMDLINE_ERROR Error;
+    CHAR16 Line[LINE_SIZE];
+    UINTN i;
+
+    for (i = 0; i < ARRAY_SIZE(Parsers); i++) {
+        // UINTN types
+        UnicodeSPrint(Line, sizeof(Line), L"-d %lu -x %lx -i 0x%lx", (UINT64)MAX_UINTN, (UINT64)MAX_UINTN, (UINT64)MAX_UINTN);
+        CHECK(ParseLine(Line, 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(Dec == MAX_UINTN && Hex == MAX_UINTN && Int == MAX_UINTN);
+        CHECK(ParseLine(Is64 ? L"-d 18446744073709551616" : L"-d 4294967296", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+        CHECK(ParseLine(Is64 ? L"-x 10000000000000000" : L"-x 100000000", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+        CHECK(ParseLine(Is64 ? L"-i 0x10000000000000000" : L"-i 0x100000000", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+
+        // INTN
+        UnicodeSPrint(Line, sizeof(Line), L"-s -%lu", (UINT64)MAX_INTN + 1);
+        CHECK(ParseLine(Line, 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(Sint == MIN_INTN);
+        UnicodeSPrint(Line, sizeof(Line), L"-s -%lu", (UINT64)MAX_INTN + 2);
+        CHECK(ParseLine(Line, 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+        UnicodeSPrint(Line, sizeof(Line), L"-s %lu", (UINT64)MAX_INTN + 1);
+        CHECK(ParseLine(Line, 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+
+        // UINT64 types
+        CHECK(ParseLine(L"-d64 18446744073709551615 -x64 FFFFFFFFFFFFFFFF -i64 0xFFFFFFFFFFFFFFFF", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(Dec64 == MAX_UINT64 && Hex64 == MAX_UINT64 && Int64 == MAX_UINT64);
+        CHECK(ParseLine(L"-d64 18446744073709551616", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+        CHECK(ParseLine(L"-x64 10000000000000000", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+        CHECK(ParseLine(L"-i64 18446744073709551616", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_RANGE);
+
+        // no digits
+        CHECK(ParseLine(L"-i 0x", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_VALUE);
+        CHECK(ParseLine(L"-x64 0x", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_VALUE);
+        CHECK(ParseLine(L"-d \"\"", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_VALUE);
+
+        // "-5" is a switch unless there is a SINT row
+        CHECK(ParseLine(L"-5", 0, NULL, ValueSwTable, Parsers[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+        CHECK(Error.ArgIndex == 1);
+        CHECK(ParseLine(L"-s -5", 0, NULL, NumSwTable, Parsers[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(Sint == -5);
+        One = FALSE;
+        CHECK(ParseLine(L"-1", 0, NULL, DigitSwTable, Parsers[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(One);
+    }
+
+    // a switch name cannot start with a digit if "-1" may be a value
+    CHECK(CmdLineValidateTables(ProgName, NULL, NumSwTable, QUIET_ERRORS, NULL) == SHELL_SUCCESS);
+    CHECK(CmdLineValidateTables(ProgName, NULL, DigitSwTable, QUIET_ERRORS, NULL) == SHELL_SUCCESS);
+    CHECK(CmdLineValidateTables(ProgName, NULL, DigitSintSwTable, QUIET_ERRORS, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_TABLE && Error.Row == 0);
+}
+
+/**
+ * Function: CheckGetters
+ *
+ * A typed getter only writes variables of its own type
+ **/
+STATIC VOID CheckGetters(VOID)
+{
+    CMDLINE_PARSER *Parser = NULL;
+    CMDLINE_ERROR Error;
+    CHAR16 *Argv[] = { ProgName, L"-d", L"5", L"-d64", L"7" };
+
+    CHECK(CmdLineCompile(ProgName, 0, NULL, NumSwTable, ProgHelpStr, LAZY_VALUES | QUIET_ERRORS, &Parser) == SHELL_SUCCESS);
+    if (Parser) {
+        ResetValues();
+        CHECK(CmdLineParseArgs(Parser, ARRAY_SIZE(Argv), Argv, NULL, &Error) == SHELL_SUCCESS);
+        CHECK(CmdLineGetUint64(Parser, (UINT64 *)&Dec) == SHELL_INVALID_PARAMETER);
+        CHECK(CmdLineGetUintn(Parser, (UINTN *)&Dec64) == SHELL_INVALID_PARAMETER);
+        CHECK(Dec == 0 && Dec64 == 0);
+        CHECK(CmdLineGetUintn(Parser, &Dec) == SHELL_SUCCESS && Dec == 5);
+        CHECK(CmdLineGetUint64(Parser, &Dec64) == SHELL_SUCCESS && Dec64 == 7);
+
+        // the type is checked whether or not the switch was given
+        CHECK(CmdLineGetIntn(Parser, (INTN *)&Hex) == SHELL_INVALID_PARAMETER);
+        CHECK(CmdLineGetUintn(Parser, &Hex) == SHELL_NOT_FOUND);
+    }
+    CmdLineFree(Parser);
+}
+
+/**
+ * Function: CheckPrefixes
+ *
+ **/
+STATIC VOID CheckPrefixes(VOID)
+{
+    CMDLINE_PARSER *Parser = NULL;
+    CMDLINE_ERROR Error;
+    CHAR16 *Argv[] = { ProgName, L"-d", L"-co" };
+
+    CHECK(ParseLine(L"-colo -cou 7", 0, NULL, ValueSwTable, NATIVE_PARSE | PREFIX_SWITCHES, NULL, &Error) == SHELL_SUCCESS);
+    CHECK(Colour && Count == 7);
+
+    // the full name of a switch is never ambiguous
+    CHECK(ParseLine(L"-d", 0, NULL, ValueSwTable, NATIVE_PARSE | PREFIX_SWITCHES, NULL, &Error) == SHELL_SUCCESS);
+    CHECK(Debug);
+
+    // the first match in the table is reported
+    CHECK(ParseLine(L"-d -co", 0, NULL, ValueSwTable, NATIVE_PARSE | PREFIX_SWITCHES, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_AMBIGUOUS_SWITCH);
+    CHECK(Error.ArgIndex == 2);
+    CHECK(Error.Row == 2);
+    CHECK(SameStr(Error.Arg, L"-co"));
+
+    // a switch character alone is not a prefix of every switch
+    CHECK(ParseLine(L"-", 0, NULL, ValueSwTable, NATIVE_PARSE | PREFIX_SWITCHES, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+    CHECK(Error.ArgIndex == 1);
+
+    CHECK(ParseLine(L"-colo", 0, NULL, ValueSwTable, NATIVE_PARSE, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+
+    // a compiled parser searches its sorted names and reports the same
+    CHECK(CmdLineCompile(ProgName, 0, NULL, ValueSwTable, ProgHelpStr, PREFIX_SWITCHES | QUIET_ERRORS, &Parser) == SHELL_SUCCESS);
+    if (Parser) {
+        ResetValues();
+        CHECK(CmdLineParseArgs(Parser, 2, Argv, NULL, &Error) == SHELL_SUCCESS);
+        CHECK(Debug);
+        CHECK(CmdLineParseArgs(Parser, ARRAY_SIZE(Argv), Argv, NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_AMBIGUOUS_SWITCH);
+        CHECK(Error.Row == 2);
+    }
+    CmdLineFree(Parser);
+
+    // the shell parser cannot match prefixes
+    CHECK(ParseLine(L"-colour", 0, NULL, ValueSwTable, PREFIX_SWITCHES, NULL, &Error) == SHELL_UNSUPPORTED);
+    CHECK(Error.Code == CMDLINE_ERR_TABLE);
+    CHECK(Error.Row == CMDLINE_NO_ROW);
+}
+
+/**
+ * Function: CheckCallback
+ *
+ **/
+STATIC VOID CheckCallback(VOID)
+{
+    CMDLINE_ERROR Error;
+    UINTN NumParams;
+    UINT16 FuncOpt[] = { NATIVE_PARSE, 0 };
+    UINTN i;
+
+    for (i = 0; i < ARRAY_SIZE(FuncOpt); i++) {
+        CHECK(ParseLine(L"5 a.txt b.txt c.txt", 1, FileParamTable, NULL, FuncOpt[i], &NumParams, &Error) == SHELL_SUCCESS);
+        CHECK(NumParams == 4);
+        CHECK(First == 5);
+        CHECK(FileCallback.Count == 3);
+        CHECK(SameStr(Files[0], L"a.txt") && SameStr(Files[1], L"b.txt") && SameStr(Files[2], L"c.txt"));
+
+        CHECK(ParseLine(L"5", 1, FileParamTable, NULL, FuncOpt[i], &NumParams, &Error) == SHELL_SUCCESS);
+        CHECK(NumParams == 1);
+        CHECK(FileCallback.Count == 0);
+
+        // the handler rejects a value
+        CHECK(ParseLine(L"5 a.txt bad b.txt", 1, FileParamTable, NULL, FuncOpt[i], &NumParams, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_PARAM_VALUE);
+        CHECK(Error.ArgIndex == 3);
+        CHECK(SameStr(Error.Arg, L"bad"));
+    }
+
+    // more values than the handler keeps
+    CHECK(ParseLine(L"1 a b c d e", 1, FileParamTable, NULL, NATIVE_PARSE, &NumParams, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_PARAM_VALUE);
+    CHECK(Error.ArgIndex == 6);
+}
+
+/**
+ * Function: CheckConstraints
+ *
+ **/
+STATIC VOID CheckConstraints(VOID)
+{
+    CMDLINE_ERROR Error;
+    UINT16 FuncOpt[] = { NATIVE_PARSE, 0 };
+    UINTN i;
+
+    for (i = 0; i < ARRAY_SIZE(FuncOpt); i++) {
+        CHECK(ParseLine(L"-r -v", 0, NULL, ConstraintSwTable, FuncOpt[i], NULL, &Error) == SHELL_SUCCESS);
+        CHECK(Read && Verify && !Write);
+
+        CHECK(ParseLine(L"-r -write", 0, NULL, ConstraintSwTable, FuncOpt[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_CONFLICT);
+        CHECK(SameStr(Error.Arg, L"-r") && SameStr(Error.Value, L"-w"));
+
+        CHECK(ParseLine(L"", 0, NULL, ConstraintSwTable, FuncOpt[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_MISSING_GROUP);
+
+        CHECK(ParseLine(L"-w -v", 0, NULL, ConstraintSwTable, FuncOpt[i], NULL, &Error) == SHELL_INVALID_PARAMETER);
+        CHECK(Error.Code == CMDLINE_ERR_SWITCH_REQUIRES);
+        CHECK(SameStr(Error.Arg, L"-v") && SameStr(Error.Value, L"-r"));
+    }
+}
+
+/**
+ * Function: CheckDispatch
+ *
+ **/
+STATIC VOID CheckDispatch(VOID)
+{
+    CMDLINE_ERROR Error;
+
+    CHECK(CmdLineValidateSubCmds(ProgName, SubCmdTable, GlobalSwTable, QUIET_ERRORS, &Error) == SHELL_SUCCESS);
+    CHECK(CmdLineValidateSubCmds(ProgName, UnsortedSubCmdTable, GlobalSwTable, QUIET_ERRORS, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_TABLE);
+
+    CHECK(DispatchLine(L"ADD 7 -v", 0, &Error) == SHELL_SUCCESS);
+    CHECK(HandlerCalls == 1 && HandlerParams == 1);
+    CHECK(Item == 7 && Verbose);
+
+    // global switches may come before the command name
+    CHECK(DispatchLine(L"-l 3 -v " LONG_CMD L" 9 -f", 0, &Error) == SHELL_ABORTED);
+    CHECK(HandlerCalls == 2 && HandlerParams == 1);
+    CHECK(Item == 9 && Level == 3 && Verbose && Force);
+
+    // error indexes are those of the full command line
+    CHECK(DispatchLine(L"-v " LONG_CMD L" x", 0, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_PARAM_VALUE);
+    CHECK(Error.ArgIndex == 3);
+    CHECK(DispatchLine(L"-l 3 add 1 -z", 0, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+    CHECK(Error.ArgIndex == 5);
+
+    // only global switches come before the command name
+    CHECK(DispatchLine(L"-f " LONG_CMD L" 9", 0, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+    CHECK(Error.ArgIndex == 1);
+
+    // prefixes of global switches match on both sides of the name
+    CHECK(DispatchLine(L"-verb -lev 2 add 1", PREFIX_SWITCHES, &Error) == SHELL_SUCCESS);
+    CHECK(Item == 1 && Level == 2 && Verbose && !Version);
+    CHECK(DispatchLine(L"add 1 -verb", PREFIX_SWITCHES, &Error) == SHELL_SUCCESS);
+    CHECK(Verbose);
+    CHECK(DispatchLine(L"-verb add 1", 0, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+    CHECK(DispatchLine(L"-l 3 -ver add 1", PREFIX_SWITCHES, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_AMBIGUOUS_SWITCH);
+    CHECK(Error.ArgIndex == 3);
+    CHECK(Error.Row == CMDLINE_NO_ROW);
+    CHECK(DispatchLine(L"add 1 -ver", PREFIX_SWITCHES, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_AMBIGUOUS_SWITCH);
+    CHECK(Error.ArgIndex == 3);
+
+    CHECK(DispatchLine(L"list", 0, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_COMMAND);
+    CHECK(DispatchLine(L"-v", 0, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_MISSING_COMMAND);
+    CHECK(HandlerCalls == 4);
+}
+
+/**
+ * Function: CheckShellErrors
+ *
+ * Error records of the shell parser point at the argument given
+ **/
+STATIC VOID CheckShellErrors(VOID)
+{
+    CMDLINE_ERROR Error;
+
+    // names match whatever their case, the record names the switch
+    CHECK(ParseLine(L"-D -DEBUG", 0, NULL, ValueSwTable, 0, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_DUPLICATE_SWITCH);
+    CHECK(Error.ArgIndex == 2);
+    CHECK(SameStr(Error.Arg, L"-debug"));
+
+    CHECK(ParseLine(L"-count 1 -count zz", 0, NULL, ValueSwTable, 0, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_DUPLICATE_SWITCH);
+    CHECK(Error.ArgIndex == 3);
+
+    CHECK(ParseLine(L"-count zz", 0, NULL, ValueSwTable, 0, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_SWITCH_VALUE);
+    CHECK(Error.ArgIndex == 1);
+    CHECK(SameStr(Error.Value, L"zz"));
+
+    CHECK(ParseLine(L"-q", 0, NULL, ValueSwTable, 0, NULL, &Error) == SHELL_INVALID_PARAMETER);
+    CHECK(Error.Code == CMDLINE_ERR_UNKNOWN_SWITCH);
+    CHECK(Error.ArgIndex == 1);
+    CHECK(SameStr(Error.Arg, L"-q"));
+}
+
+/**
+ * Function: CheckConversions
+ *
+ * Random values are converted by the word at a time kernels of the
+ * parser and by the digit at a time converter below, the value, status
+ * and error of each must agree
+ **/
+STATIC VOID CheckConversions(VOID)
+{
+    // Radix 0 is decimal unless there is a '0x' prefix, 1 is a hex blob
+    STATIC CONST struct {
+        CHAR16 *Switch;
+        UINTN Radix;
+        UINT64 Limit;
+        BOOLEAN Signed;
+        VOID *Value;
+    } Rows[] = {
+        { L"-d",    10, MAX_UINTN,  FALSE,  &Dec },
+        { L"-x",    16, MAX_UINTN,  FALSE,  &Hex },
+        { L"-i",    0,  MAX_UINTN,  FALSE,  &Int },
+        { L"-s",    0,  MAX_INTN,   TRUE,   &Sint },
+        { L"-d64",  10, MAX_UINT64, FALSE,  &Dec64 },
+        { L"-x64",  16, MAX_UINT64, FALSE,  &Hex64 },
+        { L"-i64",  0,  MAX_UINT64, FALSE,  &Int64 },
+        { L"-p",    1,  0,          FALSE,  NULL },
+    };
+    CMDLINE_PARSER *Parser = NULL;
+    CMDLINE_ERROR Error;
+    CHAR16 Value[VALUE_SIZE + 8];
+    CHAR16 *Argv[] = { ProgName, NULL, Value };
+    UINT8 RefBytes[VALUE_SIZE];
+    UINT64 RefValue = 0;
+    UINT64 Got;
+    UINTN RefSize = 0;
+    UINTN RefCode;
+    UINTN Mismatches = 0;
+    UINTN Run, r;
+    SHELL_STATUS Status;
+
+    CHECK(CmdLineCompile(ProgName, 0, NULL, ConvertSwTable, ProgHelpStr, QUIET_ERRORS, &Parser) == SHELL_SUCCESS);
+    for (Run = 0; Parser && Run < CONVERT_RUNS; Run++) {
+        r = Random(ARRAY_SIZE(Rows));
+        RandomValue(Rows[r].Radix, Rows[r].Signed, Value);
+        if ((Value[0] == L'-' || Value[0] == L'/' || Value[0] == L'+') && !(Value[1] >= L'0' && Value[1] <= L'9')) {
+            // a switch, not a value
+            continue;
+        }
+        if (Rows[r].Radix == 1) {
+            RefCode = RefHexBlob(Value, RefBytes, &RefSize);
+        } else {
+            RefCode = RefToNumber(Value, Rows[r].Radix, Rows[r].Limit, Rows[r].Signed, &RefValue);
+        }
+        Argv[1] = Rows[r].Switch;
+        ResetValues();
+        Status = CmdLineParseArgs(Parser, ARRAY_SIZE(Argv), Argv, NULL, &Error);
+
+        if (Status != (RefCode == CMDLINE_ERR_NONE ? SHELL_SUCCESS : SHELL_INVALID_PARAMETER) || Error.Code != RefCode) {
+            Mismatches++;
+        } else if (RefCode != CMDLINE_ERR_NONE) {
+            // nothing is written on error
+            if (Rows[r].Radix == 1 ? (BytesBlob.Size != 0) : (Dec | Hex | Int | Sint | Dec64 | Hex64 | Int64) != 0) {
+                Mismatches++;
+            }
+        } else if (Rows[r].Radix == 1) {
+            if (BytesBlob.Size != RefSize || CompareMem(Bytes, RefBytes, RefSize) != 0) {
+                Mismatches++;
+            }
+        } else {
+            if (Rows[r].Value == &Sint) {
+                Got = (UINT64)(INT64)Sint;
+            } else if (Rows[r].Limit == MAX_UINT64) {
+                Got = *(UINT64 *)Rows[r].Value;
+            } else {
+                Got = *(UINTN *)Rows[r].Value;
+            }
+            if (Got != RefValue) {
+                Mismatches++;
+            }
+        }
+    }
+    CmdLineFree(Parser);
+    CHECK(Mismatches == 0);
+}
+
+/**
+ * Function: RandomValue
+ *
+ * Mostly well formed numbers of every length (with the prefixes, signs
+ * and leading zeros the row accepts), some with a character replaced.
+ * Half are a digit followed by a run of one other digit (0, 1 or a top
+ * digit) and are about as long as the largest value, so values either
+ * side of each limit come up often.
+ **/
+STATIC VOID RandomValue(IN UINTN Radix, IN BOOLEAN Signed, OUT CHAR16 *Value)
+{
+    STATIC CONST CHAR16 Digits[] = L"0123456789abcdefABCDEF";
+    STATIC CONST CHAR16 EdgeDigits[] = L"01789fF";
+    STATIC CONST CHAR16 Other[] = L" \txXgG,+-/:@`";
+    BOOLEAN Edge = Random(2) ? TRUE : FALSE;
+    UINTN DigitCount = (Radix == 10) ? 10 : 22;
+    CHAR16 Fill = L'0';
+    UINTN Length;
+    UINTN i = 0;
+    UINTN n;
+
+    if (Edge) {
+        // 8 to 21 digits covers 32 and 64-bit limits in either radix
+        Length = 8 + Random(14);
+        DigitCount = (Radix == 10) ? 5 : 7;
+        Fill = EdgeDigits[Random(DigitCount)];
+    } else {
+        Length = Random(VALUE_SIZE / 2 + 1);
+    }
+
+    if (Random(8) == 0) {
+        Value[i++] = L' ';
+    }
+    if (Signed && Random(2)) {
+        Value[i++] = Random(4) ? L'-' : L'+';
+    }
+    if (Radix != 10 && Random(2)) {
+        Value[i++] = L'0';
+        Value[i++] = Random(2) ? L'x' : L'X';
+    }
+    n = Random(4) ? 0 : Random(VALUE_SIZE / 2);
+    while (n-- > 0) {
+        Value[i++] = L'0';
+    }
+    if (Edge) {
+        Value[i++] = EdgeDigits[Random(DigitCount)];
+        while (--Length > 0) {
+            Value[i++] = Random(8) ? Fill : EdgeDigits[Random(DigitCount)];
+        }
+    }
+    while (!Edge && Length-- > 0) {
+        Value[i++] = Digits[Random(DigitCount)];
+    }
+    if (i && Random(8) == 0) {
+        Value[Random(i)] = Other[Random(ARRAY_SIZE(Other) - 1)];
+    }
+    Value[i] = L'\0';
+}
+
+/**
+ * Function: RefToNumber
+ *
+ * Digit at a time converter with the rules of StrToNumber(), returns
+ * the error code the parser should report
+ **/
+STATIC UINTN RefToNumber(IN CONST CHAR16 *String, IN UINTN Radix, IN UINT64 Limit, IN BOOLEAN Signed, OUT UINT64 *Value)
+{
+    BOOLEAN Negative = FALSE;
+    BOOLEAN HaveDigit = FALSE;
+    BOOLEAN Overflow = FALSE;
+    UINT64 Result = 0;
+    UINTN Digit;
+
+    while (*String == L' ' || *String == L'\t') {
+        String++;
+    }
+    if (Signed && (*String == L'-' || *String == L'+')) {
+        Negative = (*String == L'-');
+        String++;
+    }
+    if (Negative) {
+        Limit++;
+    }
+    if (Radix != 10) {
+        while (*String == L'0') {
+            HaveDigit = TRUE;
+            String++;
+        }
+        if (*String == L'x' || *String == L'X') {
+            if (!HaveDigit) {
+                return CMDLINE_ERR_SWITCH_VALUE;
+            }
+            HaveDigit = FALSE;
+            Radix = 16;
+            String++;
+        } else if (Radix == 0) {
+            Radix = 10;
+        }
+    }
+    // every character is checked before overflow is
+    for (; *String != L'\0'; String++) {
+        if (*String >= L'0' && *String <= L'9') {
+            Digit = *String - L'0';
+        } else if (Radix == 16 && *String >= L'a' && *String <= L'f') {
+            Digit = *String - L'a' + 10;
+        } else if (Radix == 16 && *String >= L'A' && *String <= L'F') {
+            Digit = *String - L'A' + 10;
+        } else {
+            return CMDLINE_ERR_SWITCH_VALUE;
+        }
+        HaveDigit = TRUE;
+        if (Result > (Limit - Digit) / Radix) {
+            Overflow = TRUE;
+        }
+        Result = (Result * Radix) + Digit;
+    }
+    if (!HaveDigit) {
+        return CMDLINE_ERR_SWITCH_VALUE;
+    }
+    if (Overflow) {
+        return CMDLINE_ERR_SWITCH_RANGE;
+    }
+    *Value = Negative ? (0 - Result) : Result;
+    return CMDLINE_ERR_NONE;
+}
+
+/**
+ * Function: RefHexBlob
+ *
+ **/
+STATIC UINTN RefHexBlob(IN CONST CHAR16 *String, OUT UINT8 *Bytes, OUT UINTN *Size)
+{
+    UINTN Length;
+    UINTN Digit;
+    UINTN i;
+
+    if (String[0] == L'0' && (String[1] == L'x' || String[1] == L'X')) {
+        String += 2;
+    }
+    Length = StrLen(String);
+    if (Length == 0) {
+        return CMDLINE_ERR_SWITCH_VALUE;
+    }
+    for (i = 0; i < Length; i++) {
+        if (String[i] >= L'0' && String[i] <= L'9') {
+            Digit = String[i] - L'0';
+        } else if (String[i] >= L'a' && String[i] <= L'f') {
+            Digit = String[i] - L'a' + 10;
+        } else if (String[i] >= L'A' && String[i] <= L'F') {
+            Digit = String[i] - L'A' + 10;
+        } else {
+            return CMDLINE_ERR_SWITCH_VALUE;
+        }
+        Bytes[i / 2] = (UINT8)((i & 1) ? (Bytes[i / 2] | Digit) : (Digit << 4));
+    }
+    if (Length & 1) {
+        return CMDLINE_ERR_SWITCH_ODD_DIGITS;
+    }
+    if (Length / 2 > BLOB_SIZE) {
+        return CMDLINE_ERR_SWITCH_TOO_LONG;
+    }
+    *Size = Length / 2;
+    return CMDLINE_ERR_NONE;
+}
+
+/**
+ * Function: Random
+ *
+ * xorshift64*, fixed seed so every run converts the same values
+ **/
+STATIC UINT32 Random(IN UINTN Range)
+{
+    RandomState ^= RandomState >> 12;
+    RandomState ^= RandomState << 25;
+    RandomState ^= RandomState >> 27;
+    return (UINT32)(((RandomState * 0x2545F4914F6CDD1DULL) >> 32) % Range);
+}
+
+/**
+ * Function: ParseLine
+ *
+ * Parses a line as the shell app's command line, errors are not printed
+ **/
+STATIC SHELL_STATUS ParseLine(IN CONST CHAR16 *Line, IN UINTN ManParamCount, IN PARAMETER_TABLE *ParamTable, IN SWITCH_TABLE *SwTable, IN UINT16 FuncOpt, OUT UINTN *NumParams, OUT CMDLINE_ERROR *Error)
+{
+    STATIC CHECK_ARGS Args;
+
+    SplitArgs(Line, &Args);
+    ShellHostSetArgs(Args.Argc, Args.Argv);
+    ResetValues();
+    SetMem(Error, sizeof(CMDLINE_ERROR), 0);
+    return ParseCmdLineEx(ProgName, ManParamCount, ParamTable, SwTable, ProgHelpStr, FuncOpt | QUIET_ERRORS, NumParams, Error);
+}
+
+/**
+ * Function: DispatchLine
+ *
+ **/
+STATIC SHELL_STATUS DispatchLine(IN CONST CHAR16 *Line, IN UINT16 FuncOpt, OUT CMDLINE_ERROR *Error)
+{
+    STATIC CHECK_ARGS Args;
+
+    SplitArgs(Line, &Args);
+    ResetValues();
+    SetMem(Error, sizeof(CMDLINE_ERROR), 0);
+    return CmdLineDispatch(ProgName, SubCmdTable, GlobalSwTable, ProgHelpStr, FuncOpt | QUIET_ERRORS, Args.Argc, Args.Argv, NULL, Error);
+}
+
+/**
+ * Function: SplitArgs
+ *
+ **/
+STATIC VOID SplitArgs(IN CONST CHAR16 *Line, OUT CHECK_ARGS *Args)
+{
+    StrCpyS(Args->Line, LINE_SIZE, Line);
+    Args->Argv[0] = ProgName;
+    if (CmdLineSplitLine(Args->Line, &Args->Argv[1], MAX_ARGS-1, &Args->Argc) != SHELL_SUCCESS) {
+        Args->Argc = 0;
+    }
+    Args->Argc++;
+}
+
+/**
+ * Function: ResetValues
+ *
+ * Return variables are cleared and the hex data buffer filled, so a
+ * value left from an earlier line or a partial write shows
+ **/
+STATIC VOID ResetValues(VOID)
+{
+    SetMem(Addr, sizeof(Addr), 0);
+    AddrList.Count = 0;
+    Dec = Hex = Int = 0;
+    Sint = 0;
+    Dec64 = Hex64 = Int64 = 0;
+    Count = 0;
+    Colour = FALSE;
+    Debug = FALSE;
+    Verbose = Version = FALSE;
+    Level = 0;
+    Force = FALSE;
+    Item = 0;
+    Read = Write = Verify = FALSE;
+    First = 0;
+    SetMem(Files, sizeof(Files), 0);
+    FileCallback.Count = 0;
+    SetMem(Bytes, sizeof(Bytes), BLOB_FILL);
+    BytesBlob.Size = 0;
+}
+
+/**
+ * Function: SameStr
+ *
+ **/
+STATIC BOOLEAN SameStr(IN CONST CHAR16 *Str1, IN CONST CHAR16 *Str2)
+{
+    return Str1 != NULL && Str2 != NULL && StrCmp(Str1, Str2) == 0;
+}
+
+/**
+ * Function: FileHandler
+ *
+ * Copies up to MAX_FILES names (Value does not outlast the call), rejects "bad" and any more names
+ **/
+STATIC SHELL_STATUS EFIAPI FileHandler(IN VOID *Context, IN UINTN Index, IN CONST CHAR16 *Value)
+{
+    CHAR16 (*Names)[NAME_SIZE] = Context;
+
+    if (Index >= MAX_FILES || StrCmp(Value, L"bad") == 0) {
+        return SHELL_INVALID_PARAMETER;
+    }
+    StrCpyS(Names[Index], NAME_SIZE, Value);
+    return SHELL_SUCCESS;
+}
+
+/**
+ * Function: AddHandler
+ *
+ **/
+STATIC SHELL_STATUS EFIAPI AddHandler(IN VOID *Context, IN UINTN NumParams)
+{
+    HandlerCalls++;
+    HandlerParams = NumParams;
+    return SHELL_SUCCESS;
+}
+
+/**
+ * Function: RemoveHandler
+ *
+ * Returns a status of its own, which the dispatch passes back
+ **/
+STATIC SHELL_STATUS EFIAPI RemoveHandler(IN VOID *Context, IN UINTN NumParams)
+{
+    HandlerCalls++;
+    HandlerParams = NumParams;
+    return SHELL_ABORTED;
+}
@@ -0,0 +1,399 @@
+/***********************************************************************
+
+ CmdLineFuzz.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Host fuzz target for the command line parser. Each input is split on
+ whitespace into an argument vector and parsed with the shell, native
+ and compiled handle engines against the tables of CmdLineTest.c
+ (CmdLineTestTables.h), so every value conversion is exercised. The
+ compiled handle also accepts long switch prefixes. The input is then
+ parsed again with its arguments repeated and with its values
+ lengthened, and is reported (and the process aborted) if the work of
+ a parse grows faster than linearly with argument count or argument
+ length. Work is counted by the parser itself (built with
+ CMDLINE_WORK_COUNT: arguments, switch names compared and value
+ characters converted or copied) and by the host stubs (shell list
+ nodes and characters visited plus pool allocations), so the check
+ covers every engine and gives the same answer on every run; parse
+ time is also measured but only checked if CMDLINE_FUZZ_TIMING is set
+ in the environment.
+
+ Built with CMDLINE_LIBFUZZER defined it is a libFuzzer target,
+ otherwise "CmdLineFuzz file..." runs each file (e.g. an AFL queue
+ entry or the seed corpus in Host/FuzzCorpus) and reports the time per
+ input character and the growth ratios. CMDLINE_FUZZ_SLACK sets how
+ many times faster than linear growth may be before it is reported
+ (default 3).
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include "../CmdLine/CmdLine.h"
+#include "../CmdLineTestTables.h"
+#include "CmdLineHost.h"
+
+#ifndef CMDLINE_WORK_COUNT
+#error CmdLineFuzz needs the parser built with CMDLINE_WORK_COUNT (see CmdLineFuzz.inf)
+#endif
+
+#define MAX_INPUT_SIZE  1024    // larger inputs are ignored
+#define MAX_ARGS        256     // arguments taken from one input
+#define SCALE_FACTOR    4       // repeat count of scaled inputs
+#define TIMING_REPEATS  5       // parse time is the minimum of this many
+#define MIN_CHECK_NS    20000   // scaled parses quicker than this are not checked
+#define MIN_CHECK_WORK  256     // scaled parses with less work are not checked
+#define DEFAULT_SLACK   3
+
+typedef enum { FUZZ_SHELL, FUZZ_NATIVE, FUZZ_HANDLE, FUZZ_ENGINE_MAX } FUZZ_ENGINE;
+
+// Argument vector built from a fuzz input
+typedef struct {
+    UINTN Argc;
+    CHAR16 **Argv;              // Argv[0] is the program name
+    CHAR16 *Chars;              // storage for the argument strings
+    UINTN Length;               // characters in arguments
+} FUZZ_INPUT;
+
+// Result of checking one input on one engine
+typedef struct {
+    UINT64 BaseWork;
+    UINT64 ArgsWork;            // arguments repeated SCALE_FACTOR times
+    UINT64 LengthWork;          // values lengthened SCALE_FACTOR times
+    UINT64 BaseNs;
+    UINT64 ArgsNs;
+    UINT64 LengthNs;
+    UINTN Length;
+} FUZZ_RESULT;
+
+// locals functions
+STATIC BOOLEAN BuildInput(IN CONST UINT8 *Data, IN UINTN Size, IN UINTN ArgRepeat, IN UINTN ValueRepeat, OUT FUZZ_INPUT *Input);
+STATIC VOID FreeInput(IN FUZZ_INPUT *Input);
+STATIC SHELL_STATUS ParseInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine);
+STATIC UINT64 WorkInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine);
+STATIC UINT64 TimeInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine);
+STATIC VOID MeasureInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine, OUT UINT64 *Work, OUT UINT64 *Ns);
+STATIC BOOLEAN CheckInput(IN CONST UINT8 *Data, IN UINTN Size, IN FUZZ_ENGINE Engine, OUT FUZZ_RESULT *Result);
+STATIC BOOLEAN IsSuperlinear(IN UINT64 Base, IN UINT64 Scaled, IN UINT64 Min);
+STATIC VOID ReportInput(IN CONST UINT8 *Data, IN UINTN Size, IN FUZZ_ENGINE Engine, IN FUZZ_RESULT *Result);
+STATIC VOID InitFuzz(VOID);
+STATIC UINT64 NowNs(VOID);
+
+// globals
+STATIC CONST CHAR8 *FuzzEngineName[] = { "shell", "native", "handle" };
+
+STATIC CMDLINE_PARSER *FuzzParser = NULL;
+STATIC UINT64 Slack = DEFAULT_SLACK;
+STATIC BOOLEAN CheckTiming = FALSE;
+
+//---------------------------
+// Entry points
+//---------------------------
+
+/**
+ * LLVMFuzzerTestOneInput()
+ *
+ **/
+int LLVMFuzzerTestOneInput(const UINT8 *Data, size_t Size)
+{
+    FUZZ_RESULT Result;
+    FUZZ_ENGINE Engine;
+
+    if (Size > MAX_INPUT_SIZE) {
+        return 0;
+    }
+    InitFuzz();
+    for (Engine = 0; Engine < FUZZ_ENGINE_MAX; Engine++) {
+        if (!CheckInput(Data, Size, Engine, &Result)) {
+            ReportInput(Data, Size, Engine, &Result);
+            abort();
+        }
+    }
+    return 0;
+}
+
+#ifndef CMDLINE_LIBFUZZER
+int main(int argc, char *argv[])
+{
+    STATIC UINT8 Data[MAX_INPUT_SIZE];
+    FUZZ_RESULT Result;
+    FUZZ_ENGINE Engine;
+    FILE *File;
+    UINTN Size;
+    int Failures = 0;
+    int i;
+
+    if (argc < 2) {
+        printf("usage: CmdLineFuzz file...\n");
+        return 1;
+    }
+    InitFuzz();
+    printf("%-6s %8s %10s %8s %8s %8s %8s  %s\n", "engine", "chars", "ns/char", "args x4", "len x4", "ns a x4", "ns l x4", "input");
+    for (i = 1; i < argc; i++) {
+        File = fopen(argv[i], "rb");
+        if (!File) {
+            printf("cannot open %s\n", argv[i]);
+            return 1;
+        }
+        Size = fread(Data, 1, sizeof(Data), File);
+        fclose(File);
+        for (Engine = 0; Engine < FUZZ_ENGINE_MAX; Engine++) {
+            if (!CheckInput(Data, Size, Engine, &Result)) {
+                ReportInput(Data, Size, Engine, &Result);
+                Failures++;
+            }
+            printf("%-6s %8lu %10.1f %8.2f %8.2f %8.2f %8.2f  %s\n",
+                FuzzEngineName[Engine],
+                (unsigned long)Result.Length,
+                (double)Result.BaseNs / (Result.Length ? Result.Length : 1),
+                (double)Result.ArgsWork / (Result.BaseWork ? Result.BaseWork : 1),
+                (double)Result.LengthWork / (Result.BaseWork ? Result.BaseWork : 1),
+                (double)Result.ArgsNs / (Result.BaseNs ? Result.BaseNs : 1),
+                (double)Result.LengthNs / (Result.BaseNs ? Result.BaseNs : 1),
+                argv[i]);
+        }
+    }
+    return Failures ? 1 : 0;
+}
+#endif
+
+/**
+ * Function: InitFuzz
+ *
+ **/
+STATIC VOID InitFuzz(VOID)
+{
+    CONST CHAR8 *SlackStr;
+
+    if (FuzzParser) {
+        return;
+    }
+    gHostShellQuiet = TRUE;
+    SlackStr = getenv("CMDLINE_FUZZ_SLACK");
+    if (SlackStr && strtoul(SlackStr, NULL, 0)) {
+        Slack = strtoul(SlackStr, NULL, 0);
+    }
+    CheckTiming = getenv("CMDLINE_FUZZ_TIMING") ? TRUE : FALSE;
+    if (CmdLineCompile(ProgName, 1, ParamTable, SwitchTable, ProgHelpStr, PREFIX_SWITCHES, &FuzzParser) != SHELL_SUCCESS) {
+        printf("compile failed\n");
+        abort();
+    }
+}
+
+/**
+ * Function: CheckInput
+ *
+ * Returns FALSE if work (or time, if checked) grows faster than linearly
+ **/
+STATIC BOOLEAN CheckInput(IN CONST UINT8 *Data, IN UINTN Size, IN FUZZ_ENGINE Engine, OUT FUZZ_RESULT *Result)
+{
+    FUZZ_INPUT Input;
+
+    ZeroMem(Result, sizeof(FUZZ_RESULT));
+    if (!BuildInput(Data, Size, 1, 1, &Input)) {
+        return TRUE;
+    }
+    Result->Length = Input.Length;
+    MeasureInput(&Input, Engine, &Result->BaseWork, &Result->BaseNs);
+    FreeInput(&Input);
+
+    if (BuildInput(Data, Size, SCALE_FACTOR, 1, &Input)) {
+        MeasureInput(&Input, Engine, &Result->ArgsWork, &Result->ArgsNs);
+        FreeInput(&Input);
+    }
+    if (BuildInput(Data, Size, 1, SCALE_FACTOR, &Input)) {
+        MeasureInput(&Input, Engine, &Result->LengthWork, &Result->LengthNs);
+        FreeInput(&Input);
+    }
+    if (IsSuperlinear(Result->BaseWork, Result->ArgsWork, MIN_CHECK_WORK) || IsSuperlinear(Result->BaseWork, Result->LengthWork, MIN_CHECK_WORK)) {
+        return FALSE;
+    }
+    if (CheckTiming && (IsSuperlinear(Result->BaseNs, Result->ArgsNs, MIN_CHECK_NS) || IsSuperlinear(Result->BaseNs, Result->LengthNs, MIN_CHECK_NS))) {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Function: IsSuperlinear
+ *
+ * The fixed cost of a parse only makes the ratio smaller, so growth
+ * beyond SCALE_FACTOR times the slack cannot be linear. Scaled parses
+ * below Min are not checked.
+ **/
+STATIC BOOLEAN IsSuperlinear(IN UINT64 Base, IN UINT64 Scaled, IN UINT64 Min)
+{
+    if (Scaled < Min) {
+        return FALSE;
+    }
+    return Scaled > Base * SCALE_FACTOR * Slack;
+}
+
+/**
+ * Function: BuildInput
+ *
+ * Splits Data on whitespace and NULs, each byte becoming one character.
+ * The argument list is repeated ArgRepeat times and each argument that
+ * is not a switch has its text repeated ValueRepeat times.
+ **/
+STATIC BOOLEAN BuildInput(IN CONST UINT8 *Data, IN UINTN Size, IN UINTN ArgRepeat, IN UINTN ValueRepeat, OUT FUZZ_INPUT *Input)
+{
+    UINTN Starts[MAX_ARGS];
+    UINTN Lengths[MAX_ARGS];
+    UINTN Count = 0;
+    UINTN i, r, v, k;
+    CHAR16 *Dst;
+
+    ZeroMem(Input, sizeof(FUZZ_INPUT));
+    for (i = 0; i < Size && Count < MAX_ARGS; ) {
+        if (Data[i] <= ' ') {
+            i++;
+            continue;
+        }
+        Starts[Count] = i;
+        while (i < Size && Data[i] > ' ') {
+            i++;
+        }
+        Lengths[Count] = i - Starts[Count];
+        Count++;
+    }
+    if (Count == 0) {
+        return FALSE;
+    }
+
+    Input->Argv = calloc(Count * ArgRepeat + 2, sizeof(CHAR16 *));
+    Input->Chars = calloc(Size * ArgRepeat * ValueRepeat + Count * ArgRepeat, sizeof(CHAR16));
+    if (!Input->Argv || !Input->Chars) {
+        FreeInput(Input);
+        return FALSE;
+    }
+    Input->Argv[Input->Argc++] = ProgName;
+    Dst = Input->Chars;
+    for (r = 0; r < ArgRepeat; r++) {
+        for (i = 0; i < Count; i++) {
+            CONST UINT8 *Arg = &Data[Starts[i]];
+            UINTN Repeat = (Arg[0] == '-') ? 1 : ValueRepeat;
+            Input->Argv[Input->Argc++] = Dst;
+            for (v = 0; v < Repeat; v++) {
+                for (k = 0; k < Lengths[i]; k++) {
+                    *Dst++ = Arg[k];
+                }
+            }
+            Input->Length += Lengths[i] * Repeat;
+            *Dst++ = L'\0';
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Function: FreeInput
+ *
+ **/
+STATIC VOID FreeInput(IN FUZZ_INPUT *Input)
+{
+    free(Input->Argv);
+    free(Input->Chars);
+    ZeroMem(Input, sizeof(FUZZ_INPUT));
+}
+
+/**
+ * Function: ParseInput
+ *
+ **/
+STATIC SHELL_STATUS ParseInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine)
+{
+    ShellHostSetArgs(Input->Argc, Input->Argv);
+    switch (Engine) {
+    case FUZZ_NATIVE:
+        return ParseCmdLine(ProgName, 1, ParamTable, SwitchTable, ProgHelpStr, NATIVE_PARSE, NULL);
+    case FUZZ_HANDLE:
+        return CmdLineParseArgs(FuzzParser, Input->Argc, Input->Argv, NULL, NULL);
+    default:
+        return ParseCmdLine(ProgName, 1, ParamTable, SwitchTable, ProgHelpStr, 0, NULL);
+    }
+}
+
+/**
+ * Function: MeasureInput
+ *
+ **/
+STATIC VOID MeasureInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine, OUT UINT64 *Work, OUT UINT64 *Ns)
+{
+    *Work = WorkInput(Input, Engine);
+    *Ns = TimeInput(Input, Engine);
+}
+
+/**
+ * Function: WorkInput
+ *
+ * Work counted by the parser and the host stubs during one parse
+ **/
+STATIC UINT64 WorkInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine)
+{
+    gCmdLineWork = 0;
+    gHostShellWork = 0;
+    gHostAllocCount = 0;
+    ParseInput(Input, Engine);
+    return (UINT64)gCmdLineWork + gHostShellWork + gHostAllocCount;
+}
+
+/**
+ * Function: TimeInput
+ *
+ **/
+STATIC UINT64 TimeInput(IN FUZZ_INPUT *Input, IN FUZZ_ENGINE Engine)
+{
+    UINT64 Start, Elapsed;
+    UINT64 Best = MAX_UINT64;
+    UINTN n;
+
+    for (n = 0; n < TIMING_REPEATS; n++) {
+        Start = NowNs();
+        ParseInput(Input, Engine);
+        Elapsed = NowNs() - Start;
+        if (Elapsed < Best) {
+            Best = Elapsed;
+        }
+    }
+    return Best;
+}
+
+/**
+ * Function: ReportInput
+ *
+ **/
+STATIC VOID ReportInput(IN CONST UINT8 *Data, IN UINTN Size, IN FUZZ_ENGINE Engine, IN FUZZ_RESULT *Result)
+{
+    UINTN i;
+
+    printf("superlinear parse (%s): base %lu work %lu ns, args x%u %lu work %lu ns, length x%u %lu work %lu ns, input '",
+        FuzzEngineName[Engine],
+        (unsigned long)Result->BaseWork, (unsigned long)Result->BaseNs,
+        SCALE_FACTOR, (unsigned long)Result->ArgsWork, (unsigned long)Result->ArgsNs,
+        SCALE_FACTOR, (unsigned long)Result->LengthWork, (unsigned long)Result->LengthNs);
+    for (i = 0; i < Size; i++) {
+        printf((Data[i] >= ' ' && Data[i] < 0x7F) ? "%c" : "\\x%02x", Data[i]);
+    }
+    printf("'\n");
+}
+
+/**
+ * Function: NowNs
+ *
+ **/
+STATIC UINT64 NowNs(VOID)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return (UINT64)Ts.tv_sec * 1000000000 + (UINT64)Ts.tv_nsec;
+}
@@ -0,0 +1,50 @@
+/***********************************************************************
+
+ CmdLineHost.h
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Hooks exported by the host stub libraries (ShellLibHost and
+ MemoryAllocationLibHost) so host applications can drive and measure
+ the command line parser outside of the UEFI shell.
+
+***********************************************************************/
+
+#ifndef CMD_LINE_HOST_H
+#define CMD_LINE_HOST_H
+
+#include <Uefi.h>
+
+//-------------------------------------
+// MemoryAllocationLibHost
+//-------------------------------------
+
+// Running totals of pool allocations, reset by caller as required
+extern UINTN gHostAllocCount;   // number of successful allocations
+extern UINTN gHostAllocBytes;   // total bytes requested
+extern UINTN gHostFreeCount;    // number of FreePool() calls
+
+//-------------------------------------
+// ShellLibHost
+//-------------------------------------
+
+// When TRUE ShellPrintEx() formats its output as normal but does not
+// write it to stdout (allows error paths to be timed quietly)
+extern BOOLEAN gHostShellQuiet;
+
+// Running total of list nodes visited and characters scanned by the
+// stub ShellLib, a measure of shell parser work that does not depend on
+// timing. Reset by caller as required.
+extern UINTN gHostShellWork;
+
+/**
+  ShellHostSetArgs - Sets the argument vector returned via the stub
+                     shell parameters protocol
+
+  Argc          Number of entries in Argv (including program name)
+  Argv          Ptr to array of CHAR16 argument strings
+**/
+extern VOID ShellHostSetArgs(IN UINTN Argc, IN CHAR16 **Argv);
+
+#endif // CMD_LINE_HOST_H
@@ -0,0 +1,369 @@
+/***********************************************************************
+
+ CmdLineStress.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Host stress test for concurrent parsing. One parser is compiled and
+ a set of command lines is parsed with CmdLineParseArgs() to give the
+ expected values. A thread per online CPU then parses the same lines
+ over and over with CmdLineParseResult() and CmdLineResultGetValue(),
+ each into its own result and variables, and compares every value
+ with those expected. The table variables must be left untouched.
+
+ "CmdLineStress [iterations]" runs each thread for the given number of
+ passes over the lines (default 20000) and returns 1 on any mismatch.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include "../CmdLine/CmdLine.h"
+#include "CmdLineHost.h"
+
+#define DEFAULT_ITERATIONS  20000
+#define MAX_THREADS         256
+#define MAX_ARGS            32
+#define LINE_SIZE           128
+#define FNV_BASIS           14695981039346656037ull
+#define FNV_PRIME           1099511628211ull
+
+// Variables a parse fills in, the table has its own and each thread
+// has one set
+#define STR_MAXSIZE 20
+#define LIST_SIZE   8
+#define BLOB_SIZE   8
+typedef struct {
+    CHAR16 Name[STR_MAXSIZE];
+    UINTN Addr;
+    BOOLEAN Flag;
+    UINTN Flag2;
+    unsigned int Colour;
+    UINTN DecValue;
+    UINTN HexValue;
+    CHAR16 StringValue[STR_MAXSIZE];
+    UINTN List[LIST_SIZE];
+    VALUE_LIST AddrList;
+    UINT8 Pattern[BLOB_SIZE];
+    VALUE_BLOB PatternBlob;
+    VALUE_STRVIEW Label;
+} STRESS_VALUES;
+
+// Command line split into an argument vector
+typedef struct {
+    CHAR16 Line[LINE_SIZE];
+    CHAR16 *Argv[MAX_ARGS];
+    UINTN Argc;
+    UINT64 Digest;              // expected values
+} STRESS_CASE;
+
+typedef struct {
+    pthread_t Thread;
+    CMDLINE_RESULT *Result;
+    UINTN Iterations;
+    UINTN Mismatches;
+    UINTN FirstCase;            // case of first mismatch
+} STRESS_THREAD;
+
+// locals functions
+STATIC VOID InitValues(OUT STRESS_VALUES *Values, IN UINT8 Fill);
+STATIC UINT64 Digest(IN UINT64 Hash, IN CONST VOID *Data, IN UINTN Size);
+STATIC UINT64 DigestValues(IN STRESS_VALUES *Values, IN SHELL_STATUS ShellStatus, IN CMDLINE_ERROR *Error, IN UINTN NumParams);
+STATIC UINT64 ParseCase(IN CMDLINE_RESULT *Result, IN STRESS_CASE *Case);
+STATIC VOID *StressThread(IN VOID *Context);
+STATIC UINT64 NowNs(VOID);
+
+// globals
+STATIC CMDLINE_PARSER *StressParser = NULL;
+STATIC STRESS_VALUES TableValues = {   // written by CmdLineParseArgs() only
+    .AddrList = VALUE_LIST_INIT(TableValues.List),
+    .PatternBlob = VALUE_BLOB_INIT(TableValues.Pattern),
+    .Label = VALUE_STRVIEW_INIT
+};
+
+STATIC CONST CHAR16 *Lines[] = {
+    L"0x10 -d 5",
+    L"abc -f -flag2 -d 1 -c blue",
+    L"abc 1f -dec 42 -x ff -s hello -l view",
+    L"x -d 3 -a 1,2 -a 3 -p 0a0b0c",
+    L"x -a 10 -d 3 -a 20,30 ff -a 40",
+    L"x -col green -d 9 -str pre",
+    L"\"quoted arg\" -d 7 -s \"two words\" -label \"a view\"",
+    L"x -b -d 1",
+    L"x -d 1 -h",
+    L"-d",
+    L"x -d 1 -d 2",
+    L"x -q -d 1",
+    L"x 1 z -d 1",
+    L"-d 1",
+    L"x -d zz",
+    L"x -d 1 -p abc",
+    L"x -d 99999999999999999999999",
+    L"x -d 1 -he 10",
+};
+#define CASE_COUNT  (sizeof(Lines) / sizeof(Lines[0]))
+
+STATIC STRESS_CASE Cases[CASE_COUNT];
+
+STATIC CHAR16 ProgName[]    = L"stress";
+STATIC CHAR16 ProgHelpStr[] = L"Concurrent parse stress test";
+
+PARAMTABLE_START(ParamTable)
+PARAMTABLE_STR(TableValues.Name, STR_MAXSIZE,   L"[name]string parameter")
+PARAMTABLE_HEX(&TableValues.Addr,               L"[addr]hexidecimal parameter")
+PARAMTABLE_END
+
+ENUMSTR_START(EnumColourStrs)
+ENUMSTR_ENTRY(0, L"black")
+ENUMSTR_ENTRY(1, L"red")
+ENUMSTR_ENTRY(2, L"green")
+ENUMSTR_ENTRY(3, L"blue")
+ENUMSTR_END
+
+SWTABLE_START(SwitchTable)
+SWTABLE_OPT_FLAG(   L"-f",  NULL,           &TableValues.Flag,                      L"boolean flag")
+SWTABLE_OPT_FLGVAL( NULL,   L"-flag2",      &TableValues.Flag2, 12345678,           L"flag with default value assigned")
+SWTABLE_OPT_ENUM(   L"-c",  L"-colour",     &TableValues.Colour, EnumColourStrs,    L"[val]named option")
+SWTABLE_MAN_DEC(    L"-d",  L"-dec",        &TableValues.DecValue,                  L"[num]decimal value")
+SWTABLE_OPT_HEX(    L"-x",  L"-hex",        &TableValues.HexValue,                  L"[num]hexidecimal value")
+SWTABLE_OPT_STR(    L"-s",  L"-string",     TableValues.StringValue, STR_MAXSIZE,   L"[str]string value")
+SWTABLE_OPT_HEXLIST(L"-a",  L"-addr",       &TableValues.AddrList,                  L"[addr]address list")
+SWTABLE_OPT_HEXBLOB(L"-p",  L"-pattern",    &TableValues.PatternBlob,               L"[hex]pattern bytes")
+SWTABLE_OPT_STRVIEW(L"-l",  L"-label",      &TableValues.Label,                     L"[str]label")
+SWTABLE_END
+
+int main(int argc, char *argv[])
+{
+    STATIC STRESS_THREAD Threads[MAX_THREADS];
+    STRESS_VALUES Sentinel;
+    CMDLINE_ERROR Error;
+    SHELL_STATUS ShellStatus;
+    UINTN NumParams;
+    UINTN ThreadCount;
+    UINTN Iterations = DEFAULT_ITERATIONS;
+    UINTN Mismatches = 0;
+    UINT64 StartNs, ElapsedNs;
+    long Cpus;
+    UINTN i;
+
+    if (argc > 1 && strtoul(argv[1], NULL, 0)) {
+        Iterations = strtoul(argv[1], NULL, 0);
+    }
+    gHostShellQuiet = TRUE;
+    if (CmdLineCompile(ProgName, 1, ParamTable, SwitchTable, ProgHelpStr, PREFIX_SWITCHES | FORCE_BREAK, &StressParser) != SHELL_SUCCESS) {
+        printf("compile failed\n");
+        return 1;
+    }
+
+    // expected values, from the table variables
+    for (i = 0; i < CASE_COUNT; i++) {
+        StrCpyS(Cases[i].Line, LINE_SIZE, Lines[i]);
+        Cases[i].Argv[0] = ProgName;
+        if (CmdLineSplitLine(Cases[i].Line, &Cases[i].Argv[1], MAX_ARGS-1, &Cases[i].Argc) != SHELL_SUCCESS) {
+            printf("cannot split line %lu\n", (unsigned long)i);
+            return 1;
+        }
+        Cases[i].Argc++;
+        InitValues(&TableValues, 0);
+        ShellStatus = CmdLineParseArgs(StressParser, Cases[i].Argc, Cases[i].Argv, &NumParams, &Error);
+        Cases[i].Digest = DigestValues(&TableValues, ShellStatus, &Error, NumParams);
+    }
+
+    // fill the table variables so any write by the threads shows
+    InitValues(&TableValues, 0xA5);
+    CopyMem(&Sentinel, &TableValues, sizeof(STRESS_VALUES));
+
+    Cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    ThreadCount = (Cpus < 1) ? 1 : ((Cpus > MAX_THREADS) ? MAX_THREADS : (UINTN)Cpus);
+    for (i = 0; i < ThreadCount; i++) {
+        Threads[i].Iterations = Iterations;
+        if (CmdLineResultCreate(StressParser, &Threads[i].Result) != SHELL_SUCCESS) {
+            printf("cannot create result\n");
+            return 1;
+        }
+    }
+    StartNs = NowNs();
+    for (i = 0; i < ThreadCount; i++) {
+        if (pthread_create(&Threads[i].Thread, NULL, StressThread, &Threads[i]) != 0) {
+            printf("cannot create thread\n");
+            return 1;
+        }
+    }
+    for (i = 0; i < ThreadCount; i++) {
+        pthread_join(Threads[i].Thread, NULL);
+        if (Threads[i].Mismatches) {
+            printf("thread %lu: %lu mismatches, first in case %lu\n", (unsigned long)i,
+                (unsigned long)Threads[i].Mismatches, (unsigned long)Threads[i].FirstCase);
+        }
+        Mismatches += Threads[i].Mismatches;
+        CmdLineResultFree(Threads[i].Result);
+    }
+    ElapsedNs = NowNs() - StartNs;
+
+    if (CompareMem(&Sentinel, &TableValues, sizeof(STRESS_VALUES)) != 0) {
+        printf("table variables written\n");
+        Mismatches++;
+    }
+    printf("threads %lu, parses %lu, mismatches %lu, %.1f ns/parse\n",
+        (unsigned long)ThreadCount,
+        (unsigned long)(ThreadCount * Iterations * CASE_COUNT),
+        (unsigned long)Mismatches,
+        (double)ElapsedNs * ThreadCount / ((double)Iterations * CASE_COUNT));
+    CmdLineFree(StressParser);
+
+    return Mismatches ? 1 : 0;
+}
+
+/**
+ * Function: StressThread
+ *
+ **/
+STATIC VOID *StressThread(IN VOID *Context)
+{
+    STRESS_THREAD *Thread = Context;
+    UINTN Iter;
+    UINTN i;
+
+    for (Iter = 0; Iter < Thread->Iterations; Iter++) {
+        for (i = 0; i < CASE_COUNT; i++) {
+            if (ParseCase(Thread->Result, &Cases[i]) != Cases[i].Digest) {
+                if (!Thread->Mismatches) {
+                    Thread->FirstCase = i;
+                }
+                Thread->Mismatches++;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Function: ParseCase
+ *
+ * Parses a case into a result and returns the digest of its values
+ **/
+STATIC UINT64 ParseCase(IN CMDLINE_RESULT *Result, IN STRESS_CASE *Case)
+{
+    STRESS_VALUES Values;
+    CMDLINE_ERROR Error;
+    SHELL_STATUS ShellStatus;
+    UINTN NumParams;
+
+    // return variables as in the table identify the entries
+    struct {
+        VOID *Entry;
+        VOID *Value;
+    } Gets[] = {
+        { TableValues.Name,         Values.Name },
+        { &TableValues.Addr,        &Values.Addr },
+        { &TableValues.Flag,        &Values.Flag },
+        { &TableValues.Flag2,       &Values.Flag2 },
+        { &TableValues.Colour,      &Values.Colour },
+        { &TableValues.DecValue,    &Values.DecValue },
+        { &TableValues.HexValue,    &Values.HexValue },
+        { TableValues.StringValue,  Values.StringValue },
+        { &TableValues.AddrList,    &Values.AddrList },
+        { &TableValues.PatternBlob, &Values.PatternBlob },
+        { &TableValues.Label,       &Values.Label },
+    };
+    UINTN i;
+
+    InitValues(&Values, 0);
+    ShellStatus = CmdLineParseResult(Result, Case->Argc, Case->Argv, &NumParams, &Error);
+    if (ShellStatus == SHELL_SUCCESS) {
+        for (i = 0; i < sizeof(Gets) / sizeof(Gets[0]); i++) {
+            ShellStatus = CmdLineResultGetValue(Result, Gets[i].Entry, Gets[i].Value, &Error);
+            if (ShellStatus == SHELL_NOT_FOUND) {
+                ShellStatus = SHELL_SUCCESS;
+            }
+            if (ShellStatus != SHELL_SUCCESS) {
+                break;
+            }
+        }
+    }
+    return DigestValues(&Values, ShellStatus, &Error, NumParams);
+}
+
+/**
+ * Function: InitValues
+ *
+ * Sets the defaults, or fills with Fill if not 0
+ **/
+STATIC VOID InitValues(OUT STRESS_VALUES *Values, IN UINT8 Fill)
+{
+    SetMem(Values, sizeof(STRESS_VALUES), Fill);
+    Values->AddrList.Values = Values->List;
+    Values->AddrList.MaxCount = LIST_SIZE;
+    Values->PatternBlob.Buffer = Values->Pattern;
+    Values->PatternBlob.MaxSize = BLOB_SIZE;
+}
+
+/**
+ * Function: DigestValues
+ *
+ * Values are only compared if the parse succeeded, otherwise the
+ * status and error are
+ **/
+STATIC UINT64 DigestValues(IN STRESS_VALUES *Values, IN SHELL_STATUS ShellStatus, IN CMDLINE_ERROR *Error, IN UINTN NumParams)
+{
+    UINT64 Hash = FNV_BASIS;
+
+    Hash = Digest(Hash, &ShellStatus, sizeof(ShellStatus));
+    if (ShellStatus != SHELL_SUCCESS) {
+        Hash = Digest(Hash, &Error->Code, sizeof(Error->Code));
+        Hash = Digest(Hash, &Error->ArgIndex, sizeof(Error->ArgIndex));
+        Hash = Digest(Hash, &Error->Row, sizeof(Error->Row));
+        return Hash;
+    }
+    Hash = Digest(Hash, &NumParams, sizeof(NumParams));
+    Hash = Digest(Hash, Values->Name, StrSize(Values->Name));
+    Hash = Digest(Hash, &Values->Addr, sizeof(Values->Addr));
+    Hash = Digest(Hash, &Values->Flag, sizeof(Values->Flag));
+    Hash = Digest(Hash, &Values->Flag2, sizeof(Values->Flag2));
+    Hash = Digest(Hash, &Values->Colour, sizeof(Values->Colour));
+    Hash = Digest(Hash, &Values->DecValue, sizeof(Values->DecValue));
+    Hash = Digest(Hash, &Values->HexValue, sizeof(Values->HexValue));
+    Hash = Digest(Hash, Values->StringValue, StrSize(Values->StringValue));
+    Hash = Digest(Hash, &Values->AddrList.Count, sizeof(Values->AddrList.Count));
+    Hash = Digest(Hash, Values->List, Values->AddrList.Count * sizeof(UINTN));
+    Hash = Digest(Hash, &Values->PatternBlob.Size, sizeof(Values->PatternBlob.Size));
+    Hash = Digest(Hash, Values->Pattern, Values->PatternBlob.Size);
+    Hash = Digest(Hash, &Values->Label, sizeof(Values->Label));
+    return Hash;
+}
+
+/**
+ * Function: Digest
+ *
+ * FNV-1a of Data continuing from Hash
+ **/
+STATIC UINT64 Digest(IN UINT64 Hash, IN CONST VOID *Data, IN UINTN Size)
+{
+    CONST UINT8 *Bytes = Data;
+    UINTN i;
+
+    for (i = 0; i < Size; i++) {
+        Hash = (Hash ^ Bytes[i]) * FNV_PRIME;
+    }
+    return Hash;
+}
+
+/**
+ * Function: NowNs
+ *
+ **/
+STATIC UINT64 NowNs(VOID)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return (UINT64)Ts.tv_sec * 1000000000 + (UINT64)Ts.tv_nsec;
+}
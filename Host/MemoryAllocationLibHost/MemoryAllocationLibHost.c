@@ -0,0 +1,86 @@
+/***********************************************************************
+
+ MemoryAllocationLibHost.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Host implementation of the pool functions of MemoryAllocationLib that
+ keeps a count of allocations so their cost can be reported.
+
+***********************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <Uefi.h>
+#include <Library/MemoryAllocationLib.h>
+#include "../CmdLineHost.h"
+
+// globals
+UINTN gHostAllocCount = 0;
+UINTN gHostAllocBytes = 0;
+UINTN gHostFreeCount = 0;
+
+/**
+ * AllocatePool()
+ *
+ **/
+VOID *EFIAPI AllocatePool(IN UINTN AllocationSize)
+{
+    VOID *Buffer = malloc(AllocationSize ? AllocationSize : 1);
+    if (Buffer) {
+        gHostAllocCount++;
+        gHostAllocBytes += AllocationSize;
+    }
+    return Buffer;
+}
+
+/**
+ * AllocateZeroPool()
+ *
+ **/
+VOID *EFIAPI AllocateZeroPool(IN UINTN AllocationSize)
+{
+    VOID *Buffer = AllocatePool(AllocationSize);
+    if (Buffer) {
+        memset(Buffer, 0, AllocationSize);
+    }
+    return Buffer;
+}
+
+/**
+ * AllocateCopyPool()
+ *
+ **/
+VOID *EFIAPI AllocateCopyPool(IN UINTN AllocationSize, IN CONST VOID *Buffer)
+{
+    VOID *Memory = AllocatePool(AllocationSize);
+    if (Memory) {
+        memcpy(Memory, Buffer, AllocationSize);
+    }
+    return Memory;
+}
+
+/**
+ * ReallocatePool()
+ *
+ **/
+VOID *EFIAPI ReallocatePool(IN UINTN OldSize, IN UINTN NewSize, IN VOID *OldBuffer OPTIONAL)
+{
+    VOID *NewBuffer = AllocateZeroPool(NewSize);
+    if (NewBuffer && OldBuffer) {
+        memcpy(NewBuffer, OldBuffer, OldSize < NewSize ? OldSize : NewSize);
+        FreePool(OldBuffer);
+    }
+    return NewBuffer;
+}
+
+/**
+ * FreePool()
+ *
+ **/
+VOID EFIAPI FreePool(IN VOID *Buffer)
+{
+    gHostFreeCount++;
+    free(Buffer);
+}
@@ -0,0 +1,412 @@
+/***********************************************************************
+
+ ShellLibHost.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Minimal host implementation of the ShellLib functions used by the
+ command line parser. The command line list is built the same way as
+ ShellPkg's UefiShellLib (one pool allocated node plus string copies
+ per argument, linear list walks for each lookup) so that timings and
+ allocation counts taken on the host are representative of firmware.
+
+***********************************************************************/
+
+#include <stdio.h>
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PrintLib.h>
+#include <Library/ShellLib.h>
+#include "../CmdLineHost.h"
+
+// size of ShellPrintEx() format buffers (default of PcdShellPrintBufferSize)
+#define PRINT_BUFFER_SIZE   16000
+
+// list node, same layout as ShellPkg
+typedef struct {
+    LIST_ENTRY Link;
+    CHAR16 *Name;
+    CHAR16 *Value;
+    UINTN OriginalPosition;
+    SHELL_PARAM_TYPE Type;
+} SHELL_PARAM_PACKAGE;
+
+// locals functions
+STATIC INTN StringNoCaseCompare(IN CONST CHAR16 *Buffer1, IN CONST CHAR16 *Buffer2);
+STATIC BOOLEAN InternalIsOnCheckList(IN CONST CHAR16 *Name, IN CONST SHELL_PARAM_ITEM *CheckList, OUT SHELL_PARAM_TYPE *Type);
+STATIC BOOLEAN InternalIsFlag(IN CONST CHAR16 *Name, IN BOOLEAN AlwaysAllowNumbers);
+STATIC VOID StripColourCodes(IN CONST CHAR16 *Format, OUT CHAR16 *Buffer, IN UINTN BufferSize);
+
+// globals
+BOOLEAN gHostShellQuiet = FALSE;
+UINTN gHostShellWork = 0;
+
+STATIC EFI_SHELL_PARAMETERS_PROTOCOL mHostShellParameters = {0};
+EFI_SHELL_PARAMETERS_PROTOCOL *gEfiShellParametersProtocol = &mHostShellParameters;
+
+/**
+ * ShellHostSetArgs()
+ *
+ **/
+VOID ShellHostSetArgs(IN UINTN Argc, IN CHAR16 **Argv)
+{
+    mHostShellParameters.Argc = Argc;
+    mHostShellParameters.Argv = Argv;
+}
+
+/**
+ * ShellCommandLineParseEx()
+ *
+ **/
+EFI_STATUS EFIAPI ShellCommandLineParseEx(IN CONST SHELL_PARAM_ITEM *CheckList, OUT LIST_ENTRY **CheckPackage, OUT CHAR16 **ProblemParam OPTIONAL, IN BOOLEAN AutoPageBreak, IN BOOLEAN AlwaysAllowNumbers)
+{
+    SHELL_PARAM_PACKAGE *CurrentItemPackage = NULL;
+    SHELL_PARAM_TYPE CurrentItemType;
+    UINTN GetItemValue = 0;
+    UINTN ValueCount = 0;
+    UINTN LoopCounter;
+    CHAR16 **Argv = gEfiShellParametersProtocol->Argv;
+    UINTN Argc = gEfiShellParametersProtocol->Argc;
+
+    *CheckPackage = AllocateZeroPool(sizeof(LIST_ENTRY));
+    if (*CheckPackage == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    InitializeListHead(*CheckPackage);
+
+    for (LoopCounter = 0; LoopCounter < Argc; LoopCounter++) {
+        gHostShellWork += StrLen(Argv[LoopCounter] ? Argv[LoopCounter] : L"") + 1;
+        if (Argv[LoopCounter] == NULL) {
+            continue;
+        }
+        if (InternalIsOnCheckList(Argv[LoopCounter], CheckList, &CurrentItemType)) {
+            // leftover value switch that did not get its value
+            if (GetItemValue != 0) {
+                GetItemValue = 0;
+                InsertTailList(*CheckPackage, &CurrentItemPackage->Link);
+            }
+            CurrentItemPackage = AllocateZeroPool(sizeof(SHELL_PARAM_PACKAGE));
+            if (CurrentItemPackage == NULL) {
+                ShellCommandLineFreeVarList(*CheckPackage);
+                *CheckPackage = NULL;
+                return EFI_OUT_OF_RESOURCES;
+            }
+            CurrentItemPackage->Name = AllocateCopyPool(StrSize(Argv[LoopCounter]), Argv[LoopCounter]);
+            CurrentItemPackage->Type = CurrentItemType;
+            CurrentItemPackage->OriginalPosition = (UINTN)(-1);
+            if (CurrentItemType == TypeValue) {
+                GetItemValue = 1;
+            } else {
+                InsertTailList(*CheckPackage, &CurrentItemPackage->Link);
+                CurrentItemPackage = NULL;
+            }
+        } else if (GetItemValue != 0 && CurrentItemPackage != NULL && !InternalIsFlag(Argv[LoopCounter], AlwaysAllowNumbers)) {
+            // value for previous switch
+            CurrentItemPackage->Value = AllocateCopyPool(StrSize(Argv[LoopCounter]), Argv[LoopCounter]);
+            GetItemValue = 0;
+            InsertTailList(*CheckPackage, &CurrentItemPackage->Link);
+            CurrentItemPackage = NULL;
+        } else if (!InternalIsFlag(Argv[LoopCounter], AlwaysAllowNumbers)) {
+            // positional parameter
+            CurrentItemPackage = AllocateZeroPool(sizeof(SHELL_PARAM_PACKAGE));
+            if (CurrentItemPackage == NULL) {
+                ShellCommandLineFreeVarList(*CheckPackage);
+                *CheckPackage = NULL;
+                return EFI_OUT_OF_RESOURCES;
+            }
+            CurrentItemPackage->Value = AllocateCopyPool(StrSize(Argv[LoopCounter]), Argv[LoopCounter]);
+            CurrentItemPackage->OriginalPosition = ValueCount++;
+            InsertTailList(*CheckPackage, &CurrentItemPackage->Link);
+            CurrentItemPackage = NULL;
+        } else {
+            // unknown switch
+            if (ProblemParam) {
+                *ProblemParam = AllocateCopyPool(StrSize(Argv[LoopCounter]), Argv[LoopCounter]);
+            }
+            if (CurrentItemPackage) {
+                FreePool(CurrentItemPackage->Name);
+                FreePool(CurrentItemPackage);
+            }
+            ShellCommandLineFreeVarList(*CheckPackage);
+            *CheckPackage = NULL;
+            return EFI_VOLUME_CORRUPTED;
+        }
+    }
+    if (GetItemValue != 0) {
+        InsertTailList(*CheckPackage, &CurrentItemPackage->Link);
+    }
+    return EFI_SUCCESS;
+}
+
+/**
+ * ShellCommandLineFreeVarList()
+ *
+ **/
+VOID EFIAPI ShellCommandLineFreeVarList(IN LIST_ENTRY *CheckPackage)
+{
+    LIST_ENTRY *Node;
+
+    if (CheckPackage == NULL) {
+        return;
+    }
+    for (Node = GetFirstNode(CheckPackage); !IsListEmpty(CheckPackage); Node = GetFirstNode(CheckPackage)) {
+        SHELL_PARAM_PACKAGE *Item = (SHELL_PARAM_PACKAGE *)Node;
+        RemoveEntryList(Node);
+        if (Item->Name) {
+            FreePool(Item->Name);
+        }
+        if (Item->Value) {
+            FreePool(Item->Value);
+        }
+        FreePool(Item);
+    }
+    FreePool(CheckPackage);
+}
+
+/**
+ * ShellCommandLineGetFlag()
+ *
+ **/
+BOOLEAN EFIAPI ShellCommandLineGetFlag(IN CONST LIST_ENTRY *CONST CheckPackage, IN CONST CHAR16 *CONST KeyString)
+{
+    LIST_ENTRY *Node;
+
+    if (CheckPackage == NULL || KeyString == NULL) {
+        return FALSE;
+    }
+    for (Node = GetFirstNode(CheckPackage); !IsNull(CheckPackage, Node); Node = GetNextNode(CheckPackage, Node)) {
+        SHELL_PARAM_PACKAGE *Item = (SHELL_PARAM_PACKAGE *)Node;
+        gHostShellWork++;
+        if (Item->Name && StringNoCaseCompare(KeyString, Item->Name) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * ShellCommandLineGetValue()
+ *
+ **/
+CONST CHAR16 *EFIAPI ShellCommandLineGetValue(IN CONST LIST_ENTRY *CheckPackage, IN CHAR16 *KeyString)
+{
+    LIST_ENTRY *Node;
+
+    if (CheckPackage == NULL || KeyString == NULL) {
+        return NULL;
+    }
+    for (Node = GetFirstNode(CheckPackage); !IsNull(CheckPackage, Node); Node = GetNextNode(CheckPackage, Node)) {
+        SHELL_PARAM_PACKAGE *Item = (SHELL_PARAM_PACKAGE *)Node;
+        gHostShellWork++;
+        if (Item->Name && StringNoCaseCompare(KeyString, Item->Name) == 0) {
+            return Item->Value;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * ShellCommandLineGetRawValue()
+ *
+ **/
+CONST CHAR16 *EFIAPI ShellCommandLineGetRawValue(IN CONST LIST_ENTRY *CONST CheckPackage, IN UINTN Position)
+{
+    LIST_ENTRY *Node;
+
+    if (CheckPackage == NULL) {
+        return NULL;
+    }
+    for (Node = GetFirstNode(CheckPackage); !IsNull(CheckPackage, Node); Node = GetNextNode(CheckPackage, Node)) {
+        SHELL_PARAM_PACKAGE *Item = (SHELL_PARAM_PACKAGE *)Node;
+        gHostShellWork++;
+        if (Item->Name == NULL && Item->OriginalPosition == Position) {
+            return Item->Value;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * ShellCommandLineGetCount()
+ *
+ **/
+UINTN EFIAPI ShellCommandLineGetCount(IN CONST LIST_ENTRY *CheckPackage)
+{
+    LIST_ENTRY *Node;
+    UINTN Count = 0;
+
+    if (CheckPackage == NULL) {
+        return 0;
+    }
+    for (Node = GetFirstNode(CheckPackage); !IsNull(CheckPackage, Node); Node = GetNextNode(CheckPackage, Node)) {
+        gHostShellWork++;
+        if (((SHELL_PARAM_PACKAGE *)Node)->Name == NULL) {
+            Count++;
+        }
+    }
+    return Count;
+}
+
+/**
+ * ShellCommandLineCheckDuplicate()
+ *
+ **/
+EFI_STATUS EFIAPI ShellCommandLineCheckDuplicate(IN CONST LIST_ENTRY *CheckPackage, OUT CHAR16 **Param)
+{
+    LIST_ENTRY *Node1;
+    LIST_ENTRY *Node2;
+
+    for (Node1 = GetFirstNode(CheckPackage); !IsNull(CheckPackage, Node1); Node1 = GetNextNode(CheckPackage, Node1)) {
+        CHAR16 *Name1 = ((SHELL_PARAM_PACKAGE *)Node1)->Name;
+        if (Name1 == NULL) {
+            continue;
+        }
+        for (Node2 = GetNextNode(CheckPackage, Node1); !IsNull(CheckPackage, Node2); Node2 = GetNextNode(CheckPackage, Node2)) {
+            CHAR16 *Name2 = ((SHELL_PARAM_PACKAGE *)Node2)->Name;
+            gHostShellWork++;
+            if (Name2 && StrCmp(Name1, Name2) == 0) {
+                *Param = AllocateCopyPool(StrSize(Name1), Name1);
+                return EFI_VOLUME_CORRUPTED;
+            }
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+/**
+ * ShellPrintEx()
+ *
+ **/
+EFI_STATUS EFIAPI ShellPrintEx(IN INT32 Col OPTIONAL, IN INT32 Row OPTIONAL, IN CONST CHAR16 *Format, ...)
+{
+    VA_LIST Marker;
+    CHAR16 *PostReplaceFormat;
+    CHAR16 *ResultBuffer;
+    UINTN i;
+
+    // UefiShellLib allocates both working buffers on every call
+    PostReplaceFormat = AllocateZeroPool(PRINT_BUFFER_SIZE);
+    ResultBuffer = AllocateZeroPool(PRINT_BUFFER_SIZE);
+    if (!PostReplaceFormat || !ResultBuffer) {
+        if (PostReplaceFormat) {
+            FreePool(PostReplaceFormat);
+        }
+        if (ResultBuffer) {
+            FreePool(ResultBuffer);
+        }
+        return EFI_OUT_OF_RESOURCES;
+    }
+    StripColourCodes(Format, PostReplaceFormat, PRINT_BUFFER_SIZE / sizeof(CHAR16));
+    VA_START(Marker, Format);
+    UnicodeVSPrint(ResultBuffer, PRINT_BUFFER_SIZE, PostReplaceFormat, Marker);
+    VA_END(Marker);
+    if (!gHostShellQuiet) {
+        for (i = 0; ResultBuffer[i]; i++) {
+            putchar(ResultBuffer[i] < 0x80 ? (int)ResultBuffer[i] : '?');
+        }
+    }
+    FreePool(PostReplaceFormat);
+    FreePool(ResultBuffer);
+    return EFI_SUCCESS;
+}
+
+/**
+ * ShellWriteFile()
+ *
+ * All handles are written to stdout
+ **/
+EFI_STATUS EFIAPI ShellWriteFile(IN SHELL_FILE_HANDLE FileHandle, IN OUT UINTN *BufferSize, IN VOID *Buffer)
+{
+    CHAR16 *Str = Buffer;
+    UINTN i;
+
+    if (!gHostShellQuiet) {
+        for (i = 0; i < *BufferSize / sizeof(CHAR16); i++) {
+            putchar(Str[i] < 0x80 ? (int)Str[i] : '?');
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+/**
+ * ShellSetPageBreakMode()
+ *
+ **/
+VOID EFIAPI ShellSetPageBreakMode(IN BOOLEAN CurrentState)
+{
+}
+
+/**
+ * ShellGetExecutionBreakFlag()
+ *
+ **/
+BOOLEAN EFIAPI ShellGetExecutionBreakFlag(VOID)
+{
+    return FALSE;
+}
+
+/**
+ * Function: StringNoCaseCompare
+ *
+ **/
+STATIC INTN StringNoCaseCompare(IN CONST CHAR16 *Buffer1, IN CONST CHAR16 *Buffer2)
+{
+    while (*Buffer1 != L'\0' && CharToUpper(*Buffer1) == CharToUpper(*Buffer2)) {
+        gHostShellWork++;
+        Buffer1++;
+        Buffer2++;
+    }
+    return CharToUpper(*Buffer1) - CharToUpper(*Buffer2);
+}
+
+/**
+ * Function: InternalIsOnCheckList
+ *
+ **/
+STATIC BOOLEAN InternalIsOnCheckList(IN CONST CHAR16 *Name, IN CONST SHELL_PARAM_ITEM *CheckList, OUT SHELL_PARAM_TYPE *Type)
+{
+    for (; CheckList->Name != NULL; CheckList++) {
+        gHostShellWork++;
+        if (StringNoCaseCompare(Name, CheckList->Name) == 0) {
+            *Type = CheckList->Type;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Function: InternalIsFlag
+ *
+ **/
+STATIC BOOLEAN InternalIsFlag(IN CONST CHAR16 *Name, IN BOOLEAN AlwaysAllowNumbers)
+{
+    if (AlwaysAllowNumbers && Name[0] != L'\0' && Name[1] >= L'0' && Name[1] <= L'9') {
+        return FALSE;
+    }
+    if (Name[0] == L'/' || Name[0] == L'-' || Name[0] == L'+') {
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Function: StripColourCodes
+ *
+ **/
+STATIC VOID StripColourCodes(IN CONST CHAR16 *Format, OUT CHAR16 *Buffer, IN UINTN BufferSize)
+{
+    UINTN j = 0;
+
+    while (*Format != L'\0' && j < BufferSize-1) {
+        if (Format[0] == L'%' && (Format[1] == L'N' || Format[1] == L'E' || Format[1] == L'H' || Format[1] == L'B' || Format[1] == L'V')) {
+            Format += 2;
+            continue;
+        }
+        Buffer[j++] = *Format++;
+    }
+    Buffer[j] = L'\0';
+}
@@ -0,0 +1,90 @@
+/***********************************************************************
+
+ TimerLibHost.c
+
+ Author: David Petrovic
+ GitHub: https://github.com/davepet1234/CmdLine
+
+ Host implementation of TimerLib, the performance counter is the
+ monotonic clock in nanoseconds.
+
+***********************************************************************/
+
+#include <time.h>
+#include <Uefi.h>
+#include <Library/TimerLib.h>
+
+#define NS_PER_SECOND   1000000000ULL
+
+// locals functions
+STATIC VOID DelayNs(IN UINT64 Ns);
+
+
+/**
+ * MicroSecondDelay()
+ *
+ **/
+UINTN EFIAPI MicroSecondDelay(IN UINTN MicroSeconds)
+{
+    DelayNs((UINT64)MicroSeconds * 1000);
+    return MicroSeconds;
+}
+
+/**
+ * NanoSecondDelay()
+ *
+ **/
+UINTN EFIAPI NanoSecondDelay(IN UINTN NanoSeconds)
+{
+    DelayNs(NanoSeconds);
+    return NanoSeconds;
+}
+
+/**
+ * GetPerformanceCounter()
+ *
+ **/
+UINT64 EFIAPI GetPerformanceCounter(VOID)
+{
+    struct timespec Ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &Ts);
+    return (UINT64)Ts.tv_sec * NS_PER_SECOND + (UINT64)Ts.tv_nsec;
+}
+
+/**
+ * GetPerformanceCounterProperties()
+ *
+ **/
+UINT64 EFIAPI GetPerformanceCounterProperties(OUT UINT64 *StartValue OPTIONAL, OUT UINT64 *EndValue OPTIONAL)
+{
+    if (StartValue) {
+        *StartValue = 0;
+    }
+    if (EndValue) {
+        *EndValue = MAX_UINT64;
+    }
+    return NS_PER_SECOND;
+}
+
+/**
+ * GetTimeInNanoSecond()
+ *
+ **/
+UINT64 EFIAPI GetTimeInNanoSecond(IN UINT64 Ticks)
+{
+    return Ticks;
+}
+
+/**
+ * Function: DelayNs
+ *
+ **/
+STATIC VOID DelayNs(IN UINT64 Ns)
+{
+    struct timespec Ts;
+
+    Ts.tv_sec = (time_t)(Ns / NS_PER_SECOND);
+    Ts.tv_nsec = (long)(Ns % NS_PER_SECOND);
+    nanosleep(&Ts, NULL);
+}